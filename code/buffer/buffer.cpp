@@ -1,11 +1,26 @@
 #include "buffer.h"
 
-Buffer::Buffer(int initBuffSize) : buffer_(initBuffSize), readPos_(0), writePos_(0) {}
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>  // SSE2 / AVX2
+#define BUFFER_SIMD_X86
+#endif
+
+const size_t Buffer::npos;   // 类内初始化的静态常量，被引用时(如取地址)仍需要定义
+
+Buffer::Buffer(int initBuffSize) : buffer_(nullptr), capacity_(0), readPos_(0), writePos_(0) {
+    if(initBuffSize > 0) {
+        buffer_ = BufferPool::Allocate(initBuffSize, &capacity_);
+    }
+}
+
+Buffer::~Buffer() {
+    BufferPool::Free(buffer_, capacity_);
+}
 
 /* read部分 */
 // Pos是可变的，因此返回参数不能加const
 size_t Buffer::WritableBytes() const {      // 可读长度
-    return buffer_.size() - writePos_;
+    return capacity_ - writePos_;
 }     
 size_t Buffer::ReadableBytes() const {      // 可写长度
     return writePos_ - readPos_;
@@ -27,8 +42,16 @@ void Buffer::RetrieveUntil(const char* end) {  // 将readPos_移到指定位置
     Retrieve(end - Peek());
 }
 void Buffer::RetrieveAll() {                // 重置缓冲区
-    // 现代C++方法,'\0'是char，'0'是int
-    std::fill(buffer_.begin(), buffer_.end(), '\0');
+    // 只重置读写位置，O(1)；可读区域之外的内容不会被读到，不需要清零
+    readPos_ = 0;
+    writePos_ = 0;
+}
+// 空闲连接不占用缓冲区内存：存储还给BufferPool，别的连接可以接着用
+void Buffer::Release() {
+    assert(ReadableBytes() == 0);
+    BufferPool::Free(buffer_, capacity_);
+    buffer_ = nullptr;
+    capacity_ = 0;
     readPos_ = 0;
     writePos_ = 0;
 }
@@ -88,6 +111,11 @@ ssize_t Buffer::ReadFd(int fd, int* saveErrno) {
     };
     */
     struct iovec iov[2];
+    // 空Buffer先借一块最小的，一般的请求一次就读进去，不用再从栈上拷贝
+    const bool borrowed = (capacity_ == 0);
+    if(borrowed) {
+        buffer_ = BufferPool::Allocate(BufferPool::MIN_CLASS, &capacity_);
+    }
     const size_t writeSize = WritableBytes();
     // 第一个buff定为原始可读区域
     iov[0].iov_base = BeginPtr_() + writePos_;
@@ -98,6 +126,9 @@ ssize_t Buffer::ReadFd(int fd, int* saveErrno) {
     // 分散读（会自动写入，后续只需要改变指针即可）
     // len是本次readv调用实际从fd中读取的字节总数，=min(iov总长度, fd)
     const ssize_t len = readv(fd, iov, 2);
+    if(len <= 0 && borrowed) {
+        Release();      // 没读到数据(EAGAIN、对端关闭)，刚借的块马上还回去
+    }
     if(len < 0) {
         *saveErrno = errno;
     } 
@@ -105,7 +136,7 @@ ssize_t Buffer::ReadFd(int fd, int* saveErrno) {
         HasWritten(static_cast<size_t>(len));
     }
     else {
-        writePos_ = buffer_.size();
+        writePos_ = capacity_;
         // Append前，readv已自动将fd内容写入buff中，后续需要手动将buff中的东西再放入buffer_中
         Append(buff, len - writeSize);
     }
@@ -124,17 +155,145 @@ ssize_t Buffer::WriteFd(int fd, int* saveErrno) {
     return len;
 }
 
+/* 分隔符查找
+找"\r\n"：同时比较p[i]=='\r'和p[i+1]=='\n'(错开一个字节再load一次)，两个掩码相与，
+最低位的1就是第一个CRLF。一次处理16(SSE2)/32(AVX2)字节，剩下不足一组的用逐字节查找
+*/
+namespace {
+
+const char* ScanCRLFScalar(const char* p, const char* end) {
+    while(end - p >= 2) {
+        // memchr本身就是glibc用SIMD实现的
+        const char* r = static_cast<const char*>(memchr(p, '\r', end - p - 1));
+        if(r == nullptr) {
+            return nullptr;
+        }
+        if(r[1] == '\n') {
+            return r;
+        }
+        p = r + 1;
+    }
+    return nullptr;
+}
+
+#ifdef BUFFER_SIMD_X86
+__attribute__((target("sse2")))
+const char* ScanCRLFSse2(const char* p, const char* end) {
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i lf = _mm_set1_epi8('\n');
+    // 需要多读一个字节(p+1)，因此至少要有17个字节
+    while(end - p >= 17) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 1));
+        int mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, cr), _mm_cmpeq_epi8(b, lf)));
+        if(mask) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 16;
+    }
+    return ScanCRLFScalar(p, end);
+}
+
+__attribute__((target("avx2")))
+const char* ScanCRLFAvx2(const char* p, const char* end) {
+    const __m256i cr = _mm256_set1_epi8('\r');
+    const __m256i lf = _mm256_set1_epi8('\n');
+    while(end - p >= 33) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 1));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(a, cr), _mm256_cmpeq_epi8(b, lf))));
+        if(mask) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 32;
+    }
+    return ScanCRLFSse2(p, end);
+}
+#endif
+
+typedef const char* (*ScanCRLFFunc)(const char*, const char*);
+
+// 运行时根据CPU支持的指令集选择实现，只在第一次调用时判断
+ScanCRLFFunc SelectScanCRLF() {
+#ifdef BUFFER_SIMD_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2")) {
+        return ScanCRLFAvx2;
+    }
+    if(__builtin_cpu_supports("sse2")) {
+        return ScanCRLFSse2;
+    }
+#endif
+    return ScanCRLFScalar;
+}
+
+}
+
+const char* Buffer::ScanCRLF(const char* begin, const char* end) {
+    static const ScanCRLFFunc scan = SelectScanCRLF();
+    assert(begin <= end);
+    return scan(begin, end);
+}
+
+// 单字符查找直接用memchr，glibc已经按CPU选好了SIMD实现
+const char* Buffer::ScanChar(const char* begin, const char* end, char ch) {
+    assert(begin <= end);
+    return static_cast<const char*>(memchr(begin, ch, end - begin));
+}
+
+size_t Buffer::FindCRLF(size_t offset) const {
+    if(offset >= ReadableBytes()) {
+        return npos;
+    }
+    const char* r = ScanCRLF(Peek() + offset, BeginWriteConst());
+    return r ? r - Peek() : npos;
+}
+
+// 依次找每个CRLF，看后面紧跟的是不是另一个CRLF
+size_t Buffer::FindCRLFCRLF(size_t offset) const {
+    const char* end = BeginWriteConst();
+    const char* p = Peek() + std::min(offset, ReadableBytes());
+    while(const char* r = ScanCRLF(p, end)) {
+        if(end - r >= 4 && r[2] == '\r' && r[3] == '\n') {
+            return r - Peek();
+        }
+        p = r + 2;
+    }
+    return npos;
+}
+
+size_t Buffer::Find(char ch, size_t offset) const {
+    if(offset >= ReadableBytes()) {
+        return npos;
+    }
+    const char* r = ScanChar(Peek() + offset, BeginWriteConst(), ch);
+    return r ? r - Peek() : npos;
+}
+
 /* 内部辅助函数 */
 char* Buffer::BeginPtr_() {
-    // 先解引用迭代器，再取地址
-    return &*buffer_.begin();
+    return buffer_;
 }
 const char* Buffer::BeginPtr_() const {
-    return &*buffer_.begin();
+    return buffer_;
 }
 void Buffer::MakeSpace_(size_t len) {
     if(WritableBytes() + PrependableBytes() < len) {  // 需要扩容（要考虑到prepandable的长度）
-        buffer_.resize(writePos_ + len + 1);
+        // 换一块更大的：只拷贝可读部分，旧块还给BufferPool
+        // 至少翻倍，连续追加时摊还O(1)；第一次借按实际需要，一般的请求、响应头4K就够
+        size_t readSize = ReadableBytes();
+        size_t want = std::max(readSize + len, capacity_ * 2);
+        size_t newCapacity = 0;
+        char* newBuffer = BufferPool::Allocate(want, &newCapacity);
+        if(readSize > 0) {
+            std::copy(BeginPtr_() + readPos_, BeginPtr_() + writePos_, newBuffer);
+        }
+        BufferPool::Free(buffer_, capacity_);
+        buffer_ = newBuffer;
+        capacity_ = newCapacity;
+        readPos_ = 0;
+        writePos_ = readSize;
     }
     else {
         size_t readSize = ReadableBytes();
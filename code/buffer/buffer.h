@@ -11,11 +11,13 @@
 #include <vector>
 #include <atomic>
 #include <assert.h>
+#include "bufferpool.h"
 
 class Buffer{
 public:
+    // 存储从BufferPool借(按4K/16K/64K分级)；initBuffSize为0时不分配，第一次写入时才借
     Buffer(int initBuffSize = 1024);
-    ~Buffer() = default;
+    ~Buffer();
 
     // 容量查询
     size_t WritableBytes() const;       // 可写空间大小
@@ -26,7 +28,8 @@ public:
     const char* Peek() const;            // 获取可读数据起始指针
     void Retrieve(size_t len);           // 标记已读取len字节
     void RetrieveUntil(const char* end); // 标记读取到指定位置
-    void RetrieveAll();                  // 重置缓冲区（清空数据）
+    void RetrieveAll();                  // 重置缓冲区（清空数据，只重置读写位置）
+    void Release();                      // 没有可读数据时把存储还给BufferPool，下次写入时再借
     std::string RetrieveAllToStr();      // 提取所有数据并转为string
 
     // 数据写入操作 
@@ -42,9 +45,22 @@ public:
     void Append(const Buffer& buff);           // 追加另一个Buffer的数据
 
     // I/O 操作 
-    ssize_t ReadFd(int fd, int* Errno);  // 从fd读取数据到Buffer
+    ssize_t ReadFd(int fd, int* Errno);  // 从fd读取数据到Buffer；空Buffer读不到数据时不占用存储
     ssize_t WriteFd(int fd, int* Errno); // 将Buffer数据写入fd
 
+    // 分隔符查找(SSE2/AVX2，运行时按CPU选择，非x86退化为逐字节)
+    // offset、返回值都是相对Peek()的偏移，找不到返回npos
+    // 数据分多次到达时，把上次的查找位置作为offset传入，避免从头再扫一遍
+    // (分隔符可能跨两次数据，续查时offset要回退"分隔符长度-1"个字节)
+    static const size_t npos = static_cast<size_t>(-1);
+    size_t FindCRLF(size_t offset = 0) const;       // "\r\n"
+    size_t FindCRLFCRLF(size_t offset = 0) const;   // "\r\n\r\n"，即请求头结束
+    size_t Find(char ch, size_t offset = 0) const;  // 单个字符，如':'
+
+    // 在任意区间[begin, end)中查找，找不到返回nullptr
+    static const char* ScanCRLF(const char* begin, const char* end);
+    static const char* ScanChar(const char* begin, const char* end, char ch);
+
 private:
     // 内部辅助函数 
     char* BeginPtr_();                  // 缓冲区起始地址
@@ -53,7 +69,8 @@ private:
 
     // 成员变量 
     // 模板参数中，必须使用完全限定名称（即需要std::）; char不是模板参数，而size_t是模板参数
-    std::vector<char> buffer_;          // 底层存储
+    char* buffer_;                      // 底层存储，从BufferPool借
+    size_t capacity_;
     std::atomic<std::size_t> readPos_;  // 读指针（原子操作）
     std::atomic<std::size_t> writePos_; // 写指针（原子操作）
     
@@ -0,0 +1,153 @@
+#include "bufferpool.h"
+#include <assert.h>
+#include <atomic>
+#include <mutex>
+#include <new>
+
+namespace {
+
+struct FreeBlock {
+    FreeBlock* next;
+};
+
+// 全局仓库：每级一个加锁的空闲链表，线程之间交换块用
+struct Depot {
+    std::mutex mtx[BufferPool::CLASS_COUNT];
+    FreeBlock* lists[BufferPool::CLASS_COUNT] = {};
+    size_t counts[BufferPool::CLASS_COUNT] = {};
+};
+
+// 线程退出时本地缓存要还给仓库，仓库不能先析构，因此不释放
+Depot& GetDepot() {
+    static Depot* depot = new Depot;
+    return *depot;
+}
+
+std::atomic<size_t> bytesInUse(0);
+
+size_t ClassSize(int cls) {
+    return BufferPool::MIN_CLASS << (2 * cls);
+}
+
+// 能放下size字节的最小一级，超过MAX_CLASS返回-1
+int ClassOf(size_t size) {
+    for(int cls = 0; cls < BufferPool::CLASS_COUNT; cls++) {
+        if(size <= ClassSize(cls)) {
+            return cls;
+        }
+    }
+    return -1;
+}
+
+size_t LocalMax(int cls) {
+    return BufferPool::LOCAL_MAX_BYTES / ClassSize(cls);
+}
+
+// 把链表头部的n块交给仓库，仓库满了直接释放
+void PushDepot(int cls, FreeBlock*& list, size_t& count, size_t n) {
+    Depot& depot = GetDepot();
+    const size_t depotMax = BufferPool::DEPOT_MAX_BYTES / ClassSize(cls);
+    std::lock_guard<std::mutex> locker(depot.mtx[cls]);
+    while(n > 0 && list) {
+        FreeBlock* b = list;
+        list = b->next;
+        count--;
+        n--;
+        if(depot.counts[cls] >= depotMax) {
+            ::operator delete(b);
+            continue;
+        }
+        b->next = depot.lists[cls];
+        depot.lists[cls] = b;
+        depot.counts[cls]++;
+    }
+}
+
+struct LocalCache {
+    FreeBlock* lists[BufferPool::CLASS_COUNT] = {};
+    size_t counts[BufferPool::CLASS_COUNT] = {};
+
+    ~LocalCache() {
+        for(int cls = 0; cls < BufferPool::CLASS_COUNT; cls++) {
+            PushDepot(cls, lists[cls], counts[cls], counts[cls]);
+        }
+    }
+
+    // 本地为空时从仓库取一批(本地上限的一半)
+    void Refill(int cls) {
+        Depot& depot = GetDepot();
+        const size_t batch = LocalMax(cls) / 2;
+        std::lock_guard<std::mutex> locker(depot.mtx[cls]);
+        while(counts[cls] < batch && depot.lists[cls]) {
+            FreeBlock* b = depot.lists[cls];
+            depot.lists[cls] = b->next;
+            depot.counts[cls]--;
+            b->next = lists[cls];
+            lists[cls] = b;
+            counts[cls]++;
+        }
+    }
+};
+
+thread_local LocalCache cache;
+
+} // namespace
+
+const size_t BufferPool::MIN_CLASS;
+const size_t BufferPool::MAX_CLASS;
+const size_t BufferPool::LOCAL_MAX_BYTES;
+const size_t BufferPool::DEPOT_MAX_BYTES;
+
+char* BufferPool::Allocate(size_t size, size_t* capacity) {
+    assert(capacity);
+    int cls = ClassOf(size);
+    if(cls < 0) {
+        *capacity = (size + MIN_CLASS - 1) / MIN_CLASS * MIN_CLASS;
+        bytesInUse.fetch_add(*capacity, std::memory_order_relaxed);
+        return static_cast<char*>(::operator new(*capacity));
+    }
+    *capacity = ClassSize(cls);
+    bytesInUse.fetch_add(*capacity, std::memory_order_relaxed);
+    if(!cache.lists[cls]) {
+        cache.Refill(cls);
+    }
+    if(FreeBlock* b = cache.lists[cls]) {
+        cache.lists[cls] = b->next;
+        cache.counts[cls]--;
+        return reinterpret_cast<char*>(b);
+    }
+    return static_cast<char*>(::operator new(*capacity));
+}
+
+void BufferPool::Free(char* p, size_t capacity) {
+    if(!p) {
+        return;
+    }
+    bytesInUse.fetch_sub(capacity, std::memory_order_relaxed);
+    int cls = ClassOf(capacity);
+    if(cls < 0) {
+        ::operator delete(p);
+        return;
+    }
+    assert(capacity == ClassSize(cls));
+    FreeBlock* b = reinterpret_cast<FreeBlock*>(p);
+    b->next = cache.lists[cls];
+    cache.lists[cls] = b;
+    if(++cache.counts[cls] > LocalMax(cls)) {
+        PushDepot(cls, cache.lists[cls], cache.counts[cls], LocalMax(cls) / 2);
+    }
+}
+
+size_t BufferPool::BytesInUse() {
+    return bytesInUse.load(std::memory_order_relaxed);
+}
+
+size_t BufferPool::CachedBytes() {
+    size_t bytes = 0;
+    Depot& depot = GetDepot();
+    for(int cls = 0; cls < CLASS_COUNT; cls++) {
+        std::lock_guard<std::mutex> locker(depot.mtx[cls]);
+        bytes += (cache.counts[cls] + depot.counts[cls]) * ClassSize(cls);
+    }
+    return bytes;
+}
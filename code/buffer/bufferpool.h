@@ -0,0 +1,32 @@
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#include <stddef.h>
+
+/*
+BufferPool：Buffer底层存储的分级内存池，所有Buffer共用
+1、按4K、16K、64K三级分配，超过64K直接operator new，不缓存
+2、每个线程一份本地空闲链表，分配和归还不加锁；本地某级超过LOCAL_MAX_BYTES时把一半交给全局仓库，
+   本地为空时先从仓库取一批。线程池模式下同一个连接的读和写可能在不同线程上，块会在线程之间流动
+3、连接只在有数据时借用(读到数据、生成响应)，响应发完、没有未处理的请求时归还，空闲的长连接不占缓冲区
+   缓存有上限(本地每级1MB、仓库每级4MB)，突发流量借出的块超出上限的部分直接释放，池子不会一直占着峰值内存
+4、BytesInUse()：所有Buffer借出的字节数(包括超过64K直接分配的)，用于统计和测试
+*/
+class BufferPool {
+public:
+    // 分配至少size字节，*capacity为实际容量：所在级的大小，超过MAX_CLASS时按4K取整
+    static char* Allocate(size_t size, size_t* capacity);
+    // 归还，capacity必须是Allocate给出的容量；可以在任何线程归还
+    static void Free(char* p, size_t capacity);
+
+    static size_t BytesInUse();
+    static size_t CachedBytes();    // 当前线程和全局仓库缓存的字节数
+
+    static const int CLASS_COUNT = 3;
+    static const size_t MIN_CLASS = 4096;           // 4K、16K、64K，每级4倍
+    static const size_t MAX_CLASS = 65536;
+    static const size_t LOCAL_MAX_BYTES = 1 << 20;  // 每个线程每级最多缓存的字节数
+    static const size_t DEPOT_MAX_BYTES = 4 << 20;  // 全局仓库每级最多缓存的字节数
+};
+
+#endif
@@ -0,0 +1,148 @@
+#include "chainbuffer.h"
+#include <errno.h>
+#include <string.h>
+#include <algorithm>
+
+const size_t ChainBuffer::BLOCK_BYTES;
+const int ChainBuffer::WRITE_IOV;
+
+ChainBuffer::ChainBuffer() : head_(0), readable_(0) {}
+
+ChainBuffer::~ChainBuffer() {
+    RetrieveAll();
+}
+
+int ChainBuffer::PeekIov(struct iovec* iov, int max) const {
+    int cnt = 0;
+    for(size_t i = head_; i < segs_.size() && cnt < max; i++) {
+        if(segs_[i].begin == segs_[i].end) {
+            continue;
+        }
+        iov[cnt].iov_base = segs_[i].begin;
+        iov[cnt].iov_len = segs_[i].end - segs_[i].begin;
+        cnt++;
+    }
+    return cnt;
+}
+
+void ChainBuffer::Retrieve(size_t len) {
+    assert(len <= readable_);
+    readable_ -= len;
+    while(head_ < segs_.size()) {
+        Segment& seg = segs_[head_];
+        size_t n = std::min(len, static_cast<size_t>(seg.end - seg.begin));
+        seg.begin += n;
+        len -= n;
+        if(seg.begin != seg.end) {
+            break;
+        }
+        BufferPool::Free(seg.block, BLOCK_BYTES);
+        head_++;
+    }
+    if(head_ == segs_.size()) {
+        segs_.clear();
+        head_ = 0;
+    } else if(head_ >= 32 && head_ * 2 >= segs_.size()) {
+        // 读完的段占了一半以上时挪走，段数组不会一直变长
+        segs_.erase(segs_.begin(), segs_.begin() + head_);
+        head_ = 0;
+    }
+}
+
+void ChainBuffer::RetrieveAll() {
+    for(size_t i = head_; i < segs_.size(); i++) {
+        BufferPool::Free(segs_[i].block, BLOCK_BYTES);
+    }
+    segs_.clear();
+    head_ = 0;
+    readable_ = 0;
+}
+
+void ChainBuffer::Release() {
+    RetrieveAll();
+    std::vector<Segment>().swap(segs_);
+}
+
+std::string ChainBuffer::RetrieveAllToStr() {
+    std::string str;
+    str.reserve(readable_);
+    for(size_t i = head_; i < segs_.size(); i++) {
+        str.append(segs_[i].begin, segs_[i].end);
+    }
+    RetrieveAll();
+    return str;
+}
+
+size_t ChainBuffer::TailRoom_() const {
+    if(head_ == segs_.size() || !segs_.back().block) {
+        return 0;
+    }
+    return segs_.back().block + BLOCK_BYTES - segs_.back().end;
+}
+
+void ChainBuffer::PushBlock_() {
+    size_t capacity = 0;
+    char* block = BufferPool::Allocate(BLOCK_BYTES, &capacity);
+    assert(capacity == BLOCK_BYTES);
+    segs_.push_back({block, block, block});
+}
+
+void ChainBuffer::Append(const char* str, size_t len) {
+    assert(str || len == 0);
+    while(len > 0) {
+        size_t room = TailRoom_();
+        if(room == 0) {
+            PushBlock_();
+            room = BLOCK_BYTES;
+        }
+        size_t n = std::min(room, len);
+        memcpy(segs_.back().end, str, n);
+        HasWritten(n);
+        str += n;
+        len -= n;
+    }
+}
+
+void ChainBuffer::Append(const std::string& str) {
+    Append(str.data(), str.size());
+}
+
+void ChainBuffer::AppendRef(const void* data, size_t len) {
+    if(len == 0) {
+        return;
+    }
+    assert(data);
+    // iov_base是void*，这里只是去掉const，不会写入按引用追加的段
+    char* p = const_cast<char*>(static_cast<const char*>(data));
+    segs_.push_back({nullptr, p, p + len});
+    readable_ += len;
+}
+
+char* ChainBuffer::BeginWrite(size_t* len) {
+    if(TailRoom_() == 0) {
+        PushBlock_();
+    }
+    *len = TailRoom_();
+    return segs_.back().end;
+}
+
+void ChainBuffer::HasWritten(size_t len) {
+    assert(len <= TailRoom_());
+    if(len > 0) {
+        segs_.back().end += len;
+        readable_ += len;
+    }
+}
+
+// 一次writev发出前WRITE_IOV段，发出多少就释放多少
+ssize_t ChainBuffer::WriteFd(int fd, int* saveErrno) {
+    struct iovec iov[WRITE_IOV];
+    int cnt = PeekIov(iov, WRITE_IOV);
+    ssize_t len = writev(fd, iov, cnt);
+    if(len < 0) {
+        *saveErrno = errno;
+    } else {
+        Retrieve(len);
+    }
+    return len;
+}
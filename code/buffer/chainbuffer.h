@@ -0,0 +1,69 @@
+#ifndef CHAIN_BUFFER_H
+#define CHAIN_BUFFER_H
+
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <sys/uio.h>    // writev、struct iovec
+#include <assert.h>
+#include "bufferpool.h"
+
+/*
+ChainBuffer：由多段组成的缓冲区，用于分散读写
+1、自有的段是从BufferPool借的固定大小的块(BLOCK_BYTES)，写满了接一块新的，扩容不搬移已有数据，
+   读完的块马上还回池里；空的ChainBuffer不占任何块
+2、AppendRef()按引用追加外部内存(内存映射的文件、缓存的响应)，不拷贝；调用方保证发送完之前内存有效
+3、PeekIov()把可读部分导出为iovec数组，直接交给writev/sendmsg，一次系统调用发出所有段
+与Buffer不同，可读数据不保证连续，不能用于需要按连续内存解析的场合(请求解析仍用Buffer)，只用于发送
+*/
+class ChainBuffer {
+public:
+    ChainBuffer();
+    ~ChainBuffer();
+
+    size_t ReadableBytes() const {
+        return readable_;
+    }
+    int IovCount() const {              // 可读部分的段数
+        return static_cast<int>(segs_.size() - head_);
+    }
+    // 把可读部分导出到iov，最多max段，返回段数
+    int PeekIov(struct iovec* iov, int max) const;
+    void Retrieve(size_t len);          // 已发送len字节，读完的块还给BufferPool
+    void RetrieveAll();
+    void Release();                     // 清空并释放段数组本身，空闲连接不占内存
+    std::string RetrieveAllToStr();
+
+    // 拷贝追加：先填尾块剩余空间，不够再借新块
+    void Append(const char* str, size_t len);
+    void Append(const std::string& str);
+    // 按引用追加，不拷贝
+    void AppendRef(const void* data, size_t len);
+    // 尾部可写区域(不够时借一块新的)，*len为可写字节数；写入后用HasWritten确认
+    char* BeginWrite(size_t* len);
+    void HasWritten(size_t len);
+
+    ssize_t WriteFd(int fd, int* Errno);
+
+    static const size_t BLOCK_BYTES = BufferPool::MIN_CLASS;
+    static const int WRITE_IOV = 64;        // WriteFd一次writev最多的段数
+
+private:
+    struct Segment {
+        char* block;        // 自有的块，按引用追加的段为nullptr
+        char* begin;        // 可读区间[begin, end)
+        char* end;
+    };
+
+    ChainBuffer(const ChainBuffer&) = delete;
+    ChainBuffer& operator=(const ChainBuffer&) = delete;
+
+    size_t TailRoom_() const;           // 尾块剩余可写字节数，尾段不是自有块时为0
+    void PushBlock_();                  // 借一块新的接到尾部
+
+    std::vector<Segment> segs_;
+    size_t head_;                       // 第一个还没读完的段
+    size_t readable_;
+};
+
+#endif
@@ -0,0 +1,82 @@
+#include "coro.h"
+
+#ifdef CORO_ENABLED
+
+#include <new>
+
+namespace {
+
+const int CLASS_COUNT = 7;      // 64 ~ 4096
+
+struct FreeBlock {
+    FreeBlock* next;
+};
+
+// 线程退出时把缓存的块还给系统
+struct FrameCache {
+    FreeBlock* lists[CLASS_COUNT] = {};
+    size_t counts[CLASS_COUNT] = {};
+
+    ~FrameCache() {
+        for(int i = 0; i < CLASS_COUNT; i++) {
+            while(lists[i]) {
+                FreeBlock* b = lists[i];
+                lists[i] = b->next;
+                ::operator delete(b);
+            }
+        }
+    }
+};
+
+thread_local FrameCache cache;
+
+int ClassOf(size_t size) {
+    int cls = 0;
+    size_t block = FramePool::MIN_BLOCK;
+    while(block < size) {
+        block <<= 1;
+        cls++;
+    }
+    return cls;
+}
+
+} // namespace
+
+void* FramePool::Allocate(size_t size) {
+    if(size > MAX_BLOCK) {
+        return ::operator new(size);
+    }
+    int cls = ClassOf(size);
+    if(FreeBlock* b = cache.lists[cls]) {
+        cache.lists[cls] = b->next;
+        cache.counts[cls]--;
+        return b;
+    }
+    return ::operator new(MIN_BLOCK << cls);
+}
+
+void FramePool::Free(void* p, size_t size) {
+    if(size > MAX_BLOCK) {
+        ::operator delete(p);
+        return;
+    }
+    int cls = ClassOf(size);
+    if(cache.counts[cls] >= MAX_CACHED) {
+        ::operator delete(p);
+        return;
+    }
+    FreeBlock* b = static_cast<FreeBlock*>(p);
+    b->next = cache.lists[cls];
+    cache.lists[cls] = b;
+    cache.counts[cls]++;
+}
+
+size_t FramePool::CachedBlocks() {
+    size_t n = 0;
+    for(int i = 0; i < CLASS_COUNT; i++) {
+        n += cache.counts[i];
+    }
+    return n;
+}
+
+#endif // CORO_ENABLED
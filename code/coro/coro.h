@@ -0,0 +1,189 @@
+#ifndef CORO_H
+#define CORO_H
+
+/*
+协程支持需要C++20(-std=c++20)；用C++17编译时这个模块是空的，CORO_ENABLED不定义，
+服务器照常使用回调方式处理连接
+*/
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#define CORO_ENABLED 1
+#endif
+
+#ifdef CORO_ENABLED
+
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <utility>
+
+/*
+FramePool：协程帧的分配器
+1、按64、128...4096字节分级，每级一个线程内的空闲链表，不加锁
+2、连接的协程都在所属Reactor线程内创建和销毁，帧基本上都能重复使用，不走malloc
+3、超过4096字节的帧直接用operator new
+*/
+class FramePool {
+public:
+    static void* Allocate(size_t size);
+    static void Free(void* p, size_t size);
+    // 当前线程缓存的空闲块数(用于测试)
+    static size_t CachedBlocks();
+
+    static const size_t MIN_BLOCK = 64;
+    static const size_t MAX_BLOCK = 4096;
+    static const size_t MAX_CACHED = 1024;     // 每级最多缓存的空闲块
+};
+
+// 所有协程的promise共用：帧从FramePool分配；不使用异常，协程内抛出异常直接终止
+struct PromiseBase {
+    static void* operator new(size_t size) {
+        return FramePool::Allocate(size);
+    }
+    static void operator delete(void* p, size_t size) {
+        FramePool::Free(p, size);
+    }
+    void unhandled_exception() {
+        std::terminate();
+    }
+};
+
+template<class T> class Co;
+
+namespace detail {
+
+// 协程结束时恢复等待它的协程(对称转移，不增加调用栈深度)
+struct FinalAwaiter {
+    bool await_ready() noexcept {
+        return false;
+    }
+    template<class P>
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept {
+        std::coroutine_handle<> cont = h.promise().continuation;
+        return cont ? cont : std::noop_coroutine();
+    }
+    void await_resume() noexcept {}
+};
+
+template<class T>
+struct CoPromise : PromiseBase {
+    std::coroutine_handle<> continuation;
+    T value{};
+
+    Co<T> get_return_object();
+    std::suspend_always initial_suspend() noexcept {
+        return {};
+    }
+    FinalAwaiter final_suspend() noexcept {
+        return {};
+    }
+    void return_value(T v) {
+        value = std::move(v);
+    }
+    T Result() {
+        return std::move(value);
+    }
+};
+
+template<>
+struct CoPromise<void> : PromiseBase {
+    std::coroutine_handle<> continuation;
+
+    Co<void> get_return_object();
+    std::suspend_always initial_suspend() noexcept {
+        return {};
+    }
+    FinalAwaiter final_suspend() noexcept {
+        return {};
+    }
+    void return_void() {}
+    void Result() {}
+};
+
+} // namespace detail
+
+/*
+Co<T>：惰性启动的协程，co_await它时才开始执行，执行完恢复co_await它的协程
+只能移动；对象析构时销毁协程帧
+*/
+template<class T = void>
+class Co {
+public:
+    typedef detail::CoPromise<T> promise_type;
+    typedef std::coroutine_handle<promise_type> Handle;
+
+    explicit Co(Handle h) : h_(h) {}
+    Co(Co&& other) noexcept : h_(std::exchange(other.h_, nullptr)) {}
+    Co& operator=(Co&& other) noexcept {
+        if(this != &other) {
+            if(h_) {
+                h_.destroy();
+            }
+            h_ = std::exchange(other.h_, nullptr);
+        }
+        return *this;
+    }
+    Co(const Co&) = delete;
+    Co& operator=(const Co&) = delete;
+
+    ~Co() {
+        if(h_) {
+            h_.destroy();
+        }
+    }
+
+    bool await_ready() const noexcept {
+        return false;
+    }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> cont) noexcept {
+        h_.promise().continuation = cont;
+        return h_;
+    }
+    T await_resume() {
+        return h_.promise().Result();
+    }
+
+private:
+    Handle h_;
+};
+
+template<class T>
+inline Co<T> detail::CoPromise<T>::get_return_object() {
+    return Co<T>(std::coroutine_handle<CoPromise<T>>::from_promise(*this));
+}
+
+inline Co<void> detail::CoPromise<void>::get_return_object() {
+    return Co<void>(std::coroutine_handle<CoPromise<void>>::from_promise(*this));
+}
+
+namespace detail {
+
+// 独立运行的顶层协程：立即开始执行，结束时自己销毁帧
+struct Detached {
+    struct promise_type : PromiseBase {
+        Detached get_return_object() {
+            return {};
+        }
+        std::suspend_never initial_suspend() noexcept {
+            return {};
+        }
+        std::suspend_never final_suspend() noexcept {
+            return {};
+        }
+        void return_void() {}
+    };
+};
+
+inline Detached RunDetached(Co<void> co) {
+    co_await std::move(co);
+}
+
+} // namespace detail
+
+// 启动一个顶层协程：执行到第一次挂起就返回，之后由IoContext恢复
+inline void Spawn(Co<void> co) {
+    detail::RunDetached(std::move(co));
+}
+
+#endif // CORO_ENABLED
+
+#endif
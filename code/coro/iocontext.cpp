@@ -0,0 +1,99 @@
+#include "iocontext.h"
+
+#ifdef CORO_ENABLED
+
+IoContext::IoContext(Epoller* epoller, Timer* timer, uint32_t connEvent) :
+    epoller_(epoller), timer_(timer), connEvent_(connEvent), nextSleepId_(SLEEP_ID_BASE) {
+    assert(epoller_ && timer_);
+}
+
+IoContext::~IoContext() {
+    // 还挂起的协程不会再被恢复，由拥有者在析构前CancelAll()+RunReady()
+    assert(waiters_.empty() && sleepers_.empty());
+}
+
+void IoContext::WaitFd_(int fd, uint64_t token, uint32_t events, std::coroutine_handle<> h, uint32_t* result) {
+    assert(waiters_.count(fd) == 0);
+    waiters_[fd] = Waiter{h, result};
+    // EPOLLONESHOT：每次等待重新注册一次
+    if(!epoller_->ModFd(fd, connEvent_ | events, token)) {
+        // fd已经失效，下一轮直接以0恢复
+        Cancel(fd);
+    }
+}
+
+bool IoContext::Dispatch(int fd, uint32_t events) {
+    auto it = waiters_.find(fd);
+    if(it == waiters_.end()) {
+        return false;
+    }
+    Waiter w = it->second;
+    waiters_.erase(it);
+    *w.result = events;
+    w.handle.resume();
+    return true;
+}
+
+void IoContext::Cancel(int fd) {
+    auto it = waiters_.find(fd);
+    if(it == waiters_.end()) {
+        return;
+    }
+    *it->second.result = 0;
+    ready_.push_back(it->second);
+    waiters_.erase(it);
+}
+
+void IoContext::Sleep_(int ms, std::coroutine_handle<> h, uint32_t* result) {
+    int id;
+    if(!freeSleepIds_.empty()) {
+        id = freeSleepIds_.back();
+        freeSleepIds_.pop_back();
+    } else {
+        id = nextSleepId_++;
+    }
+    sleepers_[id] = Waiter{h, result};
+    timer_->add(id, ms, [this, id] { Wake_(id); });
+}
+
+void IoContext::Wake_(int sleepId) {
+    auto it = sleepers_.find(sleepId);
+    if(it == sleepers_.end()) {
+        return;
+    }
+    *it->second.result = 1;
+    ready_.push_back(it->second);
+    sleepers_.erase(it);
+    freeSleepIds_.push_back(sleepId);
+}
+
+void IoContext::CancelAll() {
+    for(auto& item : waiters_) {
+        *item.second.result = 0;
+        ready_.push_back(item.second);
+    }
+    waiters_.clear();
+    for(auto& item : sleepers_) {
+        timer_->cancel(item.first);
+        *item.second.result = 0;
+        ready_.push_back(item.second);
+        freeSleepIds_.push_back(item.first);
+    }
+    sleepers_.clear();
+}
+
+size_t IoContext::RunReady() {
+    size_t n = 0;
+    // 恢复的协程可能又加入就绪队列，换出来再执行
+    while(!ready_.empty()) {
+        running_.swap(ready_);
+        for(auto& w : running_) {
+            w.handle.resume();
+        }
+        n += running_.size();
+        running_.clear();
+    }
+    return n;
+}
+
+#endif // CORO_ENABLED
@@ -0,0 +1,118 @@
+#ifndef IOCONTEXT_H
+#define IOCONTEXT_H
+
+#include "coro.h"
+
+#ifdef CORO_ENABLED
+
+#include <unordered_map>
+#include <vector>
+#include <sys/epoll.h>
+#include "../server/epoller.h"
+#include "../timer/timer.h"
+
+/*
+IoContext：把Epoller的就绪事件和定时器转换成协程可以co_await的对象，每个Reactor一个，只在Reactor线程内使用
+1、co_await Readable(fd)/Writable(fd)：用ModFd重新注册(EPOLLONESHOT)后挂起，Reactor收到事件后调用Dispatch恢复
+   返回就绪的事件，0表示被Cancel(连接超时或Reactor退出)
+   token是重新注册时放进epoll_data的值，要和Reactor注册这个fd时用的一致(Reactor用连接的Slab句柄，HttpConn::Token())，不指定时为fd
+2、co_await SleepFor(ms)：在定时器上挂一个任务，超时后恢复；返回false表示被取消
+3、定时器回调只把协程放进就绪队列，由RunReady()统一恢复，协程不会在定时器的tick()中途执行
+同一个fd同一时刻只能有一个协程在等待
+*/
+class IoContext {
+public:
+    // connEvent：连接fd的基本事件(EPOLLONESHOT | EPOLLRDHUP [| EPOLLET])
+    IoContext(Epoller* epoller, Timer* timer, uint32_t connEvent);
+    ~IoContext();
+
+    struct IoAwaiter {
+        IoContext* ctx;
+        int fd;
+        uint64_t token;
+        uint32_t events;
+        uint32_t result;
+
+        bool await_ready() const noexcept {
+            return false;
+        }
+        void await_suspend(std::coroutine_handle<> h) {
+            ctx->WaitFd_(fd, token, events, h, &result);
+        }
+        uint32_t await_resume() const noexcept {
+            return result;
+        }
+    };
+
+    struct SleepAwaiter {
+        IoContext* ctx;
+        int ms;
+        uint32_t result;
+
+        bool await_ready() const noexcept {
+            return ms <= 0;
+        }
+        void await_suspend(std::coroutine_handle<> h) {
+            ctx->Sleep_(ms, h, &result);
+        }
+        bool await_resume() const noexcept {
+            return ms <= 0 || result != 0;
+        }
+    };
+
+    IoAwaiter Readable(int fd) {
+        return IoAwaiter{this, fd, static_cast<uint64_t>(fd), EPOLLIN, 0};
+    }
+    IoAwaiter Readable(int fd, uint64_t token) {
+        return IoAwaiter{this, fd, token, EPOLLIN, 0};
+    }
+    IoAwaiter Writable(int fd) {
+        return IoAwaiter{this, fd, static_cast<uint64_t>(fd), EPOLLOUT, 0};
+    }
+    IoAwaiter Writable(int fd, uint64_t token) {
+        return IoAwaiter{this, fd, token, EPOLLOUT, 0};
+    }
+    SleepAwaiter SleepFor(int ms) {
+        return SleepAwaiter{this, ms, 0};
+    }
+
+    // fd有事件：恢复等待它的协程，没有协程在等时返回false
+    bool Dispatch(int fd, uint32_t events);
+    // 取消fd上的等待，协程在RunReady时以结果0恢复
+    void Cancel(int fd);
+    // 取消所有等待和睡眠(Reactor退出时调用)
+    void CancelAll();
+    // 恢复就绪队列中的协程，返回恢复的个数
+    size_t RunReady();
+
+    bool HasWaiter(int fd) const {
+        return waiters_.count(fd) > 0;
+    }
+
+private:
+    struct Waiter {
+        std::coroutine_handle<> handle;
+        uint32_t* result;
+    };
+
+    void WaitFd_(int fd, uint64_t token, uint32_t events, std::coroutine_handle<> h, uint32_t* result);
+    void Sleep_(int ms, std::coroutine_handle<> h, uint32_t* result);
+    void Wake_(int sleepId);
+
+    // 睡眠任务在定时器中的id：从SLEEP_ID_BASE开始，不和连接fd冲突，用完的id回收
+    static const int SLEEP_ID_BASE = 65536;
+
+    Epoller* epoller_;
+    Timer* timer_;
+    uint32_t connEvent_;
+    std::unordered_map<int, Waiter> waiters_;       // fd -> 等待的协程
+    std::unordered_map<int, Waiter> sleepers_;      // 睡眠id -> 协程
+    std::vector<int> freeSleepIds_;
+    int nextSleepId_;
+    std::vector<Waiter> ready_;                     // 等待RunReady恢复
+    std::vector<Waiter> running_;                   // RunReady正在恢复的一批，和ready_交换，不重新分配
+};
+
+#endif // CORO_ENABLED
+
+#endif
@@ -0,0 +1,77 @@
+#define LOG_MODULE Log::HTTP
+#include "bodysink.h"
+
+#include <cstdlib>      // mkstemp
+
+size_t BodySink::memLimit = 64 * 1024;
+size_t BodySink::maxSize = 64 * 1024 * 1024;
+std::string BodySink::tmpDir = "/tmp";
+const size_t BodySink::KEEP_CAPACITY;
+
+BodySink::BodySink() : fd_(-1), size_(0) {}
+
+BodySink::~BodySink() {
+    Reset();
+}
+
+void BodySink::Reset() {
+    // 小的容量保留给连接复用；大请求体留下的内存还回去，空闲连接不占着它
+    if(mem_.capacity() > KEEP_CAPACITY) {
+        std::string().swap(mem_);
+    } else {
+        mem_.clear();
+    }
+    if(fd_ >= 0) {
+        close(fd_);
+        fd_ = -1;
+    }
+    size_ = 0;
+}
+
+bool BodySink::Append(const char* data, size_t len) {
+    if(fd_ < 0 && size_ + len > memLimit && !Spill_()) {
+        return false;
+    }
+    if(fd_ < 0) {
+        mem_.append(data, len);
+    } else if(!WriteAll_(data, len)) {
+        return false;
+    }
+    size_ += len;
+    return true;
+}
+
+bool BodySink::Spill_() {
+    // O_TMPFILE：创建没有名字的文件，进程退出或close后自动回收
+    fd_ = open(tmpDir.data(), O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+    if(fd_ < 0) {
+        std::string name = tmpDir + "/webserver-body-XXXXXX";
+        fd_ = mkstemp(&name[0]);
+        if(fd_ < 0) {
+            LOG_ERROR("BodySink create temp file in %s error: %d", tmpDir.data(), errno);
+            return false;
+        }
+        unlink(name.data());
+    }
+    if(!WriteAll_(mem_.data(), mem_.size())) {
+        return false;
+    }
+    std::string().swap(mem_);
+    return true;
+}
+
+bool BodySink::WriteAll_(const char* data, size_t len) {
+    while(len > 0) {
+        ssize_t n = ::write(fd_, data, len);
+        if(n < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            LOG_ERROR("BodySink write error: %d", errno);
+            return false;
+        }
+        data += n;
+        len -= n;
+    }
+    return true;
+}
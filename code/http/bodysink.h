@@ -0,0 +1,61 @@
+#ifndef BODY_SINK_H
+#define BODY_SINK_H
+
+#include <string>
+#include <errno.h>
+#include <fcntl.h>      // open、O_TMPFILE
+#include <unistd.h>     // write、close
+
+#include "../log/log.h"
+
+/*
+BodySink：请求体的存放位置
+1、请求体不超过memLimit时放在内存中
+2、超过后把已有内容连同后续数据写入临时文件(O_TMPFILE，不支持时mkstemp后立即unlink)，
+   读缓冲区和内存都不需要容纳整个请求体，文件在Reset()/析构时随close自动删除
+3、请求体总大小的上限maxSize由HttpRequest检查，超过则返回413
+*/
+class BodySink {
+public:
+    BodySink();
+    ~BodySink();
+
+    void Reset();                               // 清空内容，关闭临时文件
+    bool Append(const char* data, size_t len);  // 写文件失败时返回false
+
+    size_t Size() const {
+        return size_;
+    }
+    bool InMemory() const {
+        return fd_ < 0;
+    }
+    // InMemory()时的内容
+    std::string& Data() {
+        return mem_;
+    }
+    const std::string& Data() const {
+        return mem_;
+    }
+    // !InMemory()时的临时文件，读取用pread
+    int Fd() const {
+        return fd_;
+    }
+
+    static size_t memLimit;         // 超过该大小写入临时文件
+    static size_t maxSize;          // 请求体大小上限
+    static std::string tmpDir;      // 临时文件所在目录
+    static const size_t KEEP_CAPACITY = 4096;   // Reset()时不超过这个容量的内存保留
+
+private:
+    BodySink(const BodySink&) = delete;
+    BodySink& operator=(const BodySink&) = delete;
+
+    bool Spill_();                  // 创建临时文件并写入内存中的内容
+    bool WriteAll_(const char* data, size_t len);
+
+    std::string mem_;
+    int fd_;
+    size_t size_;
+};
+
+#endif
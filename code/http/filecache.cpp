@@ -0,0 +1,297 @@
+#define LOG_MODULE Log::HTTP
+#include "filecache.h"
+
+#include <chrono>
+#include <poll.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+
+const int FileCache::REVALIDATE_MS;
+
+FileCache::FileCache() : isOpen_(false), maxShardBytes_(0), maxFileSize_(0),
+    epoch_(0), hits_(0), misses_(0), evicts_(0), inotifyFd_(-1), stopFd_(-1), taskPool_(nullptr) {}
+
+FileCache::~FileCache() {
+    if(watchThread_ && watchThread_->joinable()) {
+        uint64_t one = 1;
+        ::write(stopFd_, &one, sizeof(one));
+        watchThread_->join();
+    }
+    if(inotifyFd_ >= 0) {
+        close(inotifyFd_);
+    }
+    if(stopFd_ >= 0) {
+        close(stopFd_);
+    }
+}
+
+// 单例模式
+FileCache* FileCache::Instance() {
+    static FileCache cache;
+    return &cache;
+}
+
+void FileCache::Init(const std::string& srcDir, size_t maxBytes, size_t maxFileSize, int shardNum) {
+    assert(shardNum > 0);
+    if(isOpen_ || maxBytes == 0) {
+        return;
+    }
+    srcDir_ = srcDir;
+    // 去掉末尾的'/'，缓存的key(请求路径)都以'/'开头
+    while(!srcDir_.empty() && srcDir_.back() == '/') {
+        srcDir_.pop_back();
+    }
+    maxShardBytes_ = maxBytes / shardNum;
+    maxFileSize_ = std::min(maxFileSize, maxShardBytes_);
+    for(int i = 0; i < shardNum; i++) {
+        shards_.emplace_back(new Shard());
+    }
+    if(!InitWatch_()) {
+        LOG_WARN("FileCache inotify unavailable, revalidate by mtime every %dms", REVALIDATE_MS);
+    }
+    isOpen_ = true;
+    LOG_INFO("FileCache init, maxBytes:%zu, maxFileSize:%zu, shards:%d", maxBytes, maxFileSize_, shardNum);
+}
+
+FileCache::Shard& FileCache::GetShard_(const std::string& path) {
+    return *shards_[std::hash<std::string>()(path) % shards_.size()];
+}
+
+size_t FileCache::EntryBytes_(const Entry& e) {
+    return e.body.size() + e.headerKeepAlive.size() + e.headerClose.size() +
+           e.notModifiedKeepAlive.size() + e.notModifiedClose.size() + e.etag.size();
+}
+
+// 获取当前毫秒时间，仅用于mtime复查
+static int64_t NowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+FileCache::EntryPtr FileCache::Get(const std::string& path) {
+    if(!isOpen_) {
+        return nullptr;
+    }
+    Shard& shard = GetShard_(path);
+    std::lock_guard<std::mutex> locker(shard.mtx);
+    auto it = shard.map.find(path);
+    if(it == shard.map.end()) {
+        misses_++;
+        return nullptr;
+    }
+    if(inotifyFd_ < 0 && Stale_(path, it->second)) {
+        EraseLocked_(shard, it);
+        misses_++;
+        return nullptr;
+    }
+    // 移到LRU表头
+    shard.lru.splice(shard.lru.begin(), shard.lru, it->second.lru);
+    hits_++;
+    return it->second.entry;
+}
+
+// 变体key中源文件路径之后的部分用'\n'分隔，请求路径里不会出现'\n'
+static const char VARIANT_SEP = '\n';
+
+std::string FileCache::VariantKey(const std::string& path, const struct stat& st, const std::string& encoding) {
+    char buf[80];
+    snprintf(buf, sizeof(buf), "%c%lx.%lx-%lx-%lx%c", VARIANT_SEP,
+             static_cast<unsigned long>(st.st_mtim.tv_sec), static_cast<unsigned long>(st.st_mtim.tv_nsec),
+             static_cast<unsigned long>(st.st_size), static_cast<unsigned long>(st.st_ino), VARIANT_SEP);
+    return path + buf + encoding;
+}
+
+bool FileCache::SameVersion(const struct stat& st, const Entry& entry) {
+    return st.st_mtim.tv_sec == entry.mtime && st.st_mtim.tv_nsec == entry.mtimeNsec &&
+           st.st_size == entry.size && st.st_ino == entry.ino;
+}
+
+// key对应的源文件路径
+static std::string SourcePath(const std::string& key) {
+    return key.substr(0, key.find(VARIANT_SEP));
+}
+
+// 只缓存规范的路径，"//"、"/./"、"/../"之类的路径inotify对不上，不缓存
+static bool IsCanonical(const std::string& path) {
+    return !path.empty() && path[0] == '/' &&
+           path.find("//") == std::string::npos &&
+           path.find("/.") == std::string::npos;
+}
+
+void FileCache::Put(const std::string& path, EntryPtr entry, uint64_t epoch) {
+    assert(entry);
+    if(!isOpen_ || entry->body.size() > maxFileSize_ || !IsCanonical(SourcePath(path))) {
+        return;
+    }
+    size_t bytes = EntryBytes_(*entry);
+    Shard& shard = GetShard_(path);
+    std::lock_guard<std::mutex> locker(shard.mtx);
+    // 在读文件期间有文件发生了变化，读到的内容可能已经过期
+    if(epoch != Epoch()) {
+        return;
+    }
+    auto it = shard.map.find(path);
+    if(it != shard.map.end()) {
+        EraseLocked_(shard, it);
+    }
+    shard.lru.push_front(path);
+    shard.map[path] = {entry, shard.lru.begin(), NowMs()};
+    shard.bytes += bytes;
+    // 超出上限，从LRU表尾淘汰
+    while(shard.bytes > maxShardBytes_ && shard.map.size() > 1) {
+        EraseLocked_(shard, shard.map.find(shard.lru.back()));
+        evicts_++;
+    }
+}
+
+void FileCache::EraseLocked_(Shard& shard, std::unordered_map<std::string, Slot>::iterator it) {
+    shard.bytes -= EntryBytes_(*it->second.entry);
+    shard.lru.erase(it->second.lru);
+    shard.map.erase(it);
+}
+
+void FileCache::Erase(const std::string& path) {
+    if(!isOpen_) {
+        return;
+    }
+    epoch_.fetch_add(1, std::memory_order_acq_rel);
+    Shard& shard = GetShard_(path);
+    std::lock_guard<std::mutex> locker(shard.mtx);
+    auto it = shard.map.find(path);
+    if(it != shard.map.end()) {
+        EraseLocked_(shard, it);
+        LOG_DEBUG("FileCache erase %s", path.c_str());
+    }
+}
+
+void FileCache::Clear() {
+    epoch_.fetch_add(1, std::memory_order_acq_rel);
+    for(auto& shard : shards_) {
+        std::lock_guard<std::mutex> locker(shard->mtx);
+        shard->map.clear();
+        shard->lru.clear();
+        shard->bytes = 0;
+    }
+}
+
+// inotify不可用时的兜底：每REVALIDATE_MS最多stat一次，mtime(纳秒)、大小或inode变了就视为过期
+bool FileCache::Stale_(const std::string& path, Slot& slot) {
+    int64_t now = NowMs();
+    if(now - slot.checkedMs < REVALIDATE_MS) {
+        return false;
+    }
+    slot.checkedMs = now;
+    struct stat st;
+    if(stat((srcDir_ + SourcePath(path)).data(), &st) < 0) {
+        return true;
+    }
+    return !SameVersion(st, *slot.entry);
+}
+
+void FileCache::SetTaskPool(ThreadPool* pool) {
+    std::lock_guard<std::mutex> locker(taskMtx_);
+    taskPool_ = pool;
+}
+
+bool FileCache::Submit(const std::string& key, std::function<void()> task) {
+    std::lock_guard<std::mutex> locker(taskMtx_);
+    if(!taskPool_ || !pending_.insert(key).second) {
+        return false;
+    }
+    taskPool_->AddTask([this, key, task = std::move(task)] {
+        task();
+        std::lock_guard<std::mutex> locker(taskMtx_);
+        pending_.erase(key);
+    });
+    return true;
+}
+
+/* inotify监听
+inotify不会递归监听子目录，因此需要对每个子目录单独添加watch，新建的子目录也要补上
+*/
+bool FileCache::InitWatch_() {
+    inotifyFd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(inotifyFd_ < 0) {
+        return false;
+    }
+    stopFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(stopFd_ < 0) {
+        close(inotifyFd_);
+        inotifyFd_ = -1;
+        return false;
+    }
+    AddWatch_("");
+    watchThread_.reset(new std::thread(&FileCache::WatchThread_, this));
+    return true;
+}
+
+// dir为相对srcDir_的目录，""代表根目录，其余以'/'开头
+void FileCache::AddWatch_(const std::string& dir) {
+    std::string full = srcDir_ + dir;
+    int wd = inotify_add_watch(inotifyFd_, full.data(),
+                               IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_CREATE |
+                               IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR);
+    if(wd < 0) {
+        LOG_WARN("FileCache watch %s error", full.data());
+        return;
+    }
+    wdDir_[wd] = dir;
+    DIR* dp = opendir(full.data());
+    if(!dp) {
+        return;
+    }
+    while(struct dirent* ent = readdir(dp)) {
+        if(ent->d_type == DT_DIR && ent->d_name[0] != '.') {
+            AddWatch_(dir + "/" + ent->d_name);
+        }
+    }
+    closedir(dp);
+}
+
+void FileCache::WatchThread_() {
+    // inotify_event后面跟着变长的文件名，按inotify_event对齐
+    alignas(struct inotify_event) char buf[4096];
+    struct pollfd fds[2] = {{inotifyFd_, POLLIN, 0}, {stopFd_, POLLIN, 0}};
+    while(true) {
+        if(poll(fds, 2, -1) < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if(fds[1].revents & POLLIN) {
+            break;
+        }
+        ssize_t len;
+        while((len = read(inotifyFd_, buf, sizeof(buf))) > 0) {
+            for(char* p = buf; p < buf + len; ) {
+                struct inotify_event* ev = reinterpret_cast<struct inotify_event*>(p);
+                p += sizeof(struct inotify_event) + ev->len;
+                if(ev->mask & IN_Q_OVERFLOW) {      // 事件丢失，只能全部清空
+                    Clear();
+                    continue;
+                }
+                if(ev->mask & IN_IGNORED) {         // 目录被删除，watch自动移除
+                    wdDir_.erase(ev->wd);
+                    continue;
+                }
+                auto it = wdDir_.find(ev->wd);
+                if(it == wdDir_.end() || ev->len == 0) {
+                    continue;
+                }
+                std::string path = it->second + "/" + ev->name;
+                if(ev->mask & IN_ISDIR) {
+                    // 目录被移动/删除，下面的文件路径全变了，直接清空；新目录要补上watch
+                    if(ev->mask & (IN_CREATE | IN_MOVED_TO)) {
+                        AddWatch_(path);
+                    }
+                    Clear();
+                } else {
+                    Erase(path);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,137 @@
+#ifndef FILE_CACHE_H
+#define FILE_CACHE_H
+
+#include <string>
+#include <list>
+#include <mutex>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "../log/log.h"
+#include "../pool/threadpool.h"
+
+/*
+FileCache：静态文件缓存(单例)
+1、按路径缓存文件内容、ETag，以及预先生成好的200/304状态行+响应头(keep-alive和close两个版本)
+2、命中时直接拷贝响应头、iov指向缓存的文件内容，不需要stat/open/mmap/munmap
+3、分成多个分片，每个分片一把锁 + LRU，总大小有上限
+4、后台线程通过inotify监听资源目录，文件变化时删除对应缓存；inotify不可用时按mtime定期复查
+5、同一文件的其他表示(如压缩后的内容)用VariantKey()作为key缓存，由Submit()交给线程池在后台生成
+*/
+class FileCache {
+public:
+    struct Entry {
+        std::string body;               // 文件内容
+        std::string headerKeepAlive;    // 状态行 + 响应头 + 空行
+        std::string headerClose;
+        std::string notModifiedKeepAlive;   // 304的状态行 + 响应头 + 空行
+        std::string notModifiedClose;
+        std::string etag;
+        time_t mtime;                   // 源文件的mtime和大小，用于过期检查
+        long mtimeNsec;                 // mtime的纳秒部分：同一秒内的修改也能区分
+        ino_t ino;                      // 源文件的inode：rename替换的文件mtime和大小可能不变
+        off_t size;
+    };
+    typedef std::shared_ptr<const Entry> EntryPtr;
+
+    static FileCache* Instance();
+
+    // srcDir：资源目录  maxBytes：缓存总大小上限  maxFileSize：超过该大小的文件不缓存
+    void Init(const std::string& srcDir, size_t maxBytes,
+              size_t maxFileSize = 1024 * 1024, int shardNum = 16);
+    bool IsOpen() const {
+        return isOpen_;
+    }
+
+    EntryPtr Get(const std::string& path);
+    // epoch为查找缓存前Epoch()的值；期间有文件变化(epoch改变)则放弃插入，避免缓存旧内容
+    void Put(const std::string& path, EntryPtr entry, uint64_t epoch);
+    void Erase(const std::string& path);
+    void Clear();
+
+    // 变体的key：源文件路径 + mtime(纳秒) + 大小 + inode + 编码。文件修改后旧变体不会再被命中，由LRU淘汰
+    static std::string VariantKey(const std::string& path, const struct stat& st, const std::string& encoding);
+    // st与缓存项记录的源文件是同一个版本：mtime精确到纳秒、大小、inode都相同
+    static bool SameVersion(const struct stat& st, const Entry& entry);
+
+    // 后台任务(如压缩)使用的线程池，传nullptr表示停止提交
+    void SetTaskPool(ThreadPool* pool);
+    // 提交后台任务：同一key同时只会有一个任务在排队/执行；没有线程池或已在执行时返回false
+    bool Submit(const std::string& key, std::function<void()> task);
+
+    uint64_t Epoch() const {
+        return epoch_.load(std::memory_order_acquire);
+    }
+    size_t MaxFileSize() const {
+        return maxFileSize_;
+    }
+
+    // 统计
+    size_t HitCount() const {
+        return hits_;
+    }
+    size_t MissCount() const {
+        return misses_;
+    }
+    size_t EvictCount() const {
+        return evicts_;
+    }
+
+private:
+    FileCache();
+    ~FileCache();
+
+    struct Slot {
+        EntryPtr entry;
+        std::list<std::string>::iterator lru;   // 在LRU链表中的位置
+        int64_t checkedMs;                      // 上次复查mtime的时间(仅inotify不可用时使用)
+    };
+    struct Shard {
+        std::mutex mtx;
+        std::unordered_map<std::string, Slot> map;
+        std::list<std::string> lru;             // 表头最近使用
+        size_t bytes = 0;
+    };
+
+    Shard& GetShard_(const std::string& path);
+    static size_t EntryBytes_(const Entry& e);
+    void EraseLocked_(Shard& shard, std::unordered_map<std::string, Slot>::iterator it);
+    bool Stale_(const std::string& path, Slot& slot);
+
+    bool InitWatch_();
+    void AddWatch_(const std::string& dir);
+    void WatchThread_();
+
+    static const int REVALIDATE_MS = 1000;
+
+    bool isOpen_;
+    std::string srcDir_;
+    size_t maxShardBytes_;
+    size_t maxFileSize_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+
+    std::atomic<uint64_t> epoch_;       // 每次失效加一
+    std::atomic<size_t> hits_;
+    std::atomic<size_t> misses_;
+    std::atomic<size_t> evicts_;
+
+    // inotify
+    int inotifyFd_;
+    int stopFd_;                                // eventfd，析构时唤醒监听线程
+    std::unordered_map<int, std::string> wdDir_; // watch描述符到相对目录的映射
+    std::unique_ptr<std::thread> watchThread_;
+
+    // 后台任务
+    std::mutex taskMtx_;
+    ThreadPool* taskPool_;
+    std::unordered_set<std::string> pending_;   // 正在排队/执行的任务key
+};
+
+#endif
@@ -1,14 +1,26 @@
+#define LOG_MODULE Log::HTTP
 #include "httpconn.h"
 
 // 静态成员变量需要在头文件中声明，在源文件中定义(分配存储空间)
 const char* HttpConn::srcDir;
 std::atomic<int> HttpConn::userCount;
 bool HttpConn::isET;
+int HttpConn::pipelineDepth = 8;
+const int HttpConn::LINGER_MS;
+const size_t HttpConn::MAX_LINGER_BYTES;
 
-HttpConn::HttpConn() {
+HttpConn::HttpConn() : readBuff_(0) {
     fd_ = -1;
+    token_ = 0;
     addr_ = {0};
     isClose_ = true;
+    isKeepAlive_ = false;
+    busy_ = closePending_ = false;
+    needsLinger_ = lingering_ = false;
+    discarded_ = 0;
+    fileOffset_ = 0;
+    fileRemain_ = 0;
+    respCnt_ = 0;
 };
 
 HttpConn::~HttpConn() {
@@ -31,19 +43,31 @@ struct in_addr {
 大端序：高位在前，低位在后； 小端序：高位在后，低位在前
 网络字节序：互连网通信的字节序，一定是大端序； 主机字节序：电脑的字节序
 */
-void HttpConn::init(int fd, const sockaddr_in& addr) {
+void HttpConn::init(int fd, const sockaddr_in& addr, uint64_t token) {
     assert(fd > 0);
     userCount++;
     fd_ = fd;
+    token_ = token;
     addr_ = addr;
     writeBuff_.RetrieveAll();
     readBuff_.RetrieveAll();
+    request_.Init();        // 清掉上一个连接残留的解析进度
+    fileRemain_ = 0;
+    isKeepAlive_ = false;
+    busy_ = closePending_ = false;
+    needsLinger_ = lingering_ = false;
+    discarded_ = 0;
     isClose_ = false;
     LOG_INFO("Client[%d](%s:%d) in, UserCount:%d", fd_, GetIP(), GetPort(), (int)userCount);
 }
 
 void HttpConn::Close() {
-    response_.UnmapFile();     // 关闭内存映射
+    writeBuff_.Release();   // 先于内存映射释放，里面有按引用追加的文件内容
+    std::vector<struct iovec>().swap(iov_);
+    ReleaseResponses_();    // 关闭内存映射
+    fileRemain_ = 0;
+    readBuff_.RetrieveAll();
+    readBuff_.Release();
     if(isClose_ == false) {
         isClose_ = true;
         userCount--;
@@ -52,6 +76,43 @@ void HttpConn::Close() {
     } 
 }
 
+void HttpConn::ReleaseResponses_() {
+    for(int i = 0; i < respCnt_; i++) {
+        responses_[i]->UnmapFile();
+    }
+    respCnt_ = 0;
+}
+
+/*
+连接空闲时缓冲区不占内存：上一批响应已经发完，writeBuff_一定可以释放；
+readBuff_里还有半个请求，或者有等待验证的请求(解析结果引用着readBuff_)时保留
+*/
+void HttpConn::ReleaseBuffers_() {
+    writeBuff_.Release();
+    std::vector<struct iovec>().swap(iov_);
+    if(readBuff_.ReadableBytes() == 0 && !request_.NeedsVerify()) {
+        readBuff_.Release();
+    }
+}
+
+// 响应已经发完：关闭写方向，之后读到的数据都丢弃
+void HttpConn::StartLinger() {
+    assert(needsLinger_ && ToWriteBytes() == 0);
+    shutdown(fd_, SHUT_WR);
+    lingering_ = true;
+    discarded_ = 0;
+    request_.Init();
+    Discard();          // 出错的请求后面已经读进来的数据
+    ReleaseResponses_();
+    ReleaseBuffers_();
+}
+
+bool HttpConn::Discard() {
+    discarded_ += readBuff_.ReadableBytes();
+    readBuff_.RetrieveAll();
+    return discarded_ <= MAX_LINGER_BYTES;
+}
+
 int HttpConn::GetFd() const {
     return fd_;
 }
@@ -77,76 +138,193 @@ ssize_t HttpConn::read(int* saveErrno) {
     do {
         // readv是不能保证一次读完的，因此这里要用到循环
         len = readBuff_.ReadFd(fd_, saveErrno);
-        if(len < 0) {
+        // 读到EOF(0)也要停下，否则ET模式下会一直读下去
+        if(len <= 0) {
             break;
         }
     } while(isET);
     return len;
 }
 
+#ifdef CORO_ENABLED
+// 读到新数据返回true；对端关闭、出错或等待被取消返回false。没有数据时挂起，等Reactor通知可读
+Co<bool> HttpConn::ReadAsync(IoContext& io) {
+    while(true) {
+        size_t before = readBuff_.ReadableBytes();
+        int readErrno = 0;
+        ssize_t len = read(&readErrno);
+        if(readBuff_.ReadableBytes() > before) {
+            co_return true;
+        }
+        if(len == 0 || (len < 0 && readErrno != EAGAIN)) {
+            co_return false;
+        }
+        if(co_await io.Readable(fd_, Token()) == 0) {
+            co_return false;
+        }
+    }
+}
+
+// 把本批响应全部发完返回true；内核发送缓冲区满时挂起，等Reactor通知可写
+Co<bool> HttpConn::WriteAllAsync(IoContext& io) {
+    while(ToWriteBytes() > 0) {
+        int writeErrno = 0;
+        ssize_t len = write(&writeErrno);
+        if(len < 0) {
+            if(writeErrno != EAGAIN) {
+                co_return false;
+            }
+            if(co_await io.Writable(fd_, Token()) == 0) {
+                co_return false;
+            }
+        }
+    }
+    co_return true;
+}
+#endif
+
 /*分散写*/
 ssize_t HttpConn::write(int* saveErrno) {
     ssize_t len = -1;
     do {
-        // len代表write每次写入的长度; 前面虽然定义了两个iov，但看响应报文大小调整使用几个
-        len = writev(fd_, iov_, iovCnt_);
-        if(len < 0) {
-            *saveErrno = errno;
-            break;
-        }
-
-        if(iov_[0].iov_len + iov_[1].iov_len == 0) {
-            break;      // 传输结束
+        if(writeBuff_.ReadableBytes() > 0) {
+            // 一次writev发出所有响应头和按引用追加的文件内容，发完的块马上还回池里
+            len = writeBuff_.WriteFd(fd_, saveErrno);
+            if(len < 0) {
+                break;
+            }
         }
-        else if (static_cast<size_t>(len) > iov_[0].iov_len) {
-            // 移动iov_[1].iov_base代表下次从这里开始写
-            iov_[1].iov_base = (uint*)iov_[1].iov_base + (len - iov_[0].iov_len);
-            iov_[1].iov_len -= (len - iov_[0].iov_len);  
-            if(iov_[0].iov_len) {
-                writeBuff_.RetrieveAll();
-                iov_[0].iov_len = 0;
+        else if(fileRemain_ > 0) {
+            // 零拷贝：文件内容由内核直接从页缓存发往socket，部分写时下次从fileOffset_继续
+            off_t offset = fileOffset_;
+            len = sendfile(fd_, responses_[respCnt_ - 1]->FileFd(), &offset, fileRemain_);
+            if(len < 0) {
+                *saveErrno = errno;
+                break;
             }
-        } else {
-            iov_[0].iov_base = (uint*)iov_[0].iov_base + len;
-            iov_[0].iov_len -= len; 
-            writeBuff_.Retrieve(len);
+            if(len == 0) {      // 文件在发送过程中被截断，无法再发完
+                *saveErrno = EIO;
+                break;
+            }
+            Written(len);
+        }
+        if(ToWriteBytes() == 0) {
+            break;      // 传输结束
         }
     } while(isET || ToWriteBytes() > 10240);
+    return len;
 }
 
-bool HttpConn::process() {
-    request_.Init();
-    if(readBuff_.ReadableBytes() <= 0) {
+void HttpConn::Feed(const char* data, size_t len) {
+    readBuff_.Append(data, len);
+}
+
+const struct iovec* HttpConn::WriteIov(int* cnt) {
+    iov_.resize(std::min(writeBuff_.IovCount(), IOV_MAX));
+    *cnt = writeBuff_.PeekIov(iov_.data(), static_cast<int>(iov_.size()));
+    return iov_.data();
+}
+
+// 写缓冲区一次导出不完(超过IOV_MAX段)时先不发文件，文件内容必须排在所有响应头之后
+bool HttpConn::PendingFile(int* fd, off_t* offset, size_t* len) const {
+    if(fileRemain_ == 0 || writeBuff_.IovCount() > IOV_MAX) {
         return false;
     }
-    // 将请求报文写入readBuff_中
-    else if(request_.parse(readBuff_)) {    
-        LOG_DEBUG("request path is : %s", request_.path().c_str());
-        response_.Init(srcDir, request_.path(), request_.IsKeepAlive(), 200);
-    } else {
-        response_.Init(srcDir, request_.path(), false, 400);
+    *fd = responses_[respCnt_ - 1]->FileFd();
+    *offset = fileOffset_;
+    *len = fileRemain_;
+    return true;
+}
+
+// 先发writeBuff_，再发文件：len字节先从writeBuff_中扣除(读完的块还回池里)，剩下的是文件内容
+void HttpConn::Written(size_t len) {
+    size_t n = std::min(len, writeBuff_.ReadableBytes());
+    writeBuff_.Retrieve(n);
+    len -= n;
+    assert(len <= fileRemain_);
+    fileOffset_ += len;
+    fileRemain_ -= len;
+}
+
+/* 依次处理readBuff_中的完整请求，直到：
+1、没有完整的请求了(剩下的半个请求保留解析进度)
+2、达到pipelineDepth
+3、响应之后要关闭连接，或者响应要用sendfile(sendfile只能放在最后)
+4、allowSlow为false时遇到需要查数据库验证的请求(HasSlowRequest())，先停下，
+   之前的响应照常返回；这个请求保留解析结果，下次process(true)时验证并生成响应
+*/
+bool HttpConn::process(bool allowSlow) {
+    assert(ToWriteBytes() == 0);
+    // 上一批已经发完
+    writeBuff_.RetrieveAll();
+    ReleaseResponses_();
+    fileOffset_ = 0;
+    fileRemain_ = 0;
+
+    int depth = std::max(1, std::min(pipelineDepth, static_cast<int>(MAX_PIPELINE_DEPTH)));
+    while(respCnt_ < depth && (request_.NeedsVerify() || readBuff_.ReadableBytes() > 0)) {
+        // 解析readBuff_中的请求报文；请求不完整时保留解析进度，等待下次数据到来
+        // 上次停在验证之前的请求已经解析完，不再解析
+        HttpRequest::HTTP_CODE ret = request_.NeedsVerify() ? HttpRequest::GET_REQUSET : request_.parse(readBuff_);
+        if(ret == HttpRequest::NO_REQUEST) {
+            break;
+        }
+        if(request_.NeedsVerify()) {
+            if(!allowSlow) {
+                break;
+            }
+            request_.Verify();
+        }
+        if(static_cast<int>(responses_.size()) <= respCnt_) {
+            responses_.emplace_back(new HttpResponse());
+        }
+        HttpResponse& response = *responses_[respCnt_];
+        if(ret == HttpRequest::GET_REQUSET) {
+            LOG_DEBUG("request path is : %s", request_.path().c_str());
+            isKeepAlive_ = request_.IsKeepAlive();
+            response.Init(srcDir, request_.path(), isKeepAlive_, 200);
+            if(request_.method() == "GET") {
+                response.SetRange(request_.GetHeader("Range"), request_.GetHeader("If-Range"));
+                response.SetConditional(request_.GetHeader("If-None-Match"),
+                                        request_.GetHeader("If-Modified-Since"));
+                response.SetAcceptEncoding(request_.AcceptEncoding("gzip"), request_.AcceptEncoding("deflate"));
+            }
+        } else {
+            // 出错后请求边界已经不可靠，响应之后关闭连接；剩下的请求体还在路上，延迟关闭
+            isKeepAlive_ = false;
+            needsLinger_ = true;
+            int code = 400;
+            if(ret == HttpRequest::TOO_LARGE_REQUEST) {
+                code = 413;
+            } else if(ret == HttpRequest::INTERNAL_ERROR) {
+                code = 500;
+            }
+            response.Init(srcDir, request_.path(), false, code);
+        }
+        /*
+        给出对应的响应：响应头写进writeBuff_，紧接着追加响应体
+        如果请求的文件​有效​​，File()返回该文件的内存映射(或缓存)。
+        如果请求的文件​无效​​（如 404），File()返回的是错误页面（如 404.html）的内存映射。
+        响应体按引用追加，不拷贝，响应发完之前映射和缓存项都由response持有
+        */
+        response.MakeResponse(writeBuff_);
+        respCnt_++;
+        if(response.FileFd() >= 0) {
+            // 大文件：writeBuff_只有响应头，文件内容在write()中用sendfile发送
+            fileOffset_ = response.FileOffset();
+            fileRemain_ = response.FileLen();
+        }
+        else if(response.FileLen() > 0 && response.File()) {
+            writeBuff_.AppendRef(response.File(), response.FileLen());
+        }
+        if(!isKeepAlive_ || response.FileFd() >= 0) {
+            break;
+        }
     }
-    // 给出对应的响应
-    response_.MakeResponse(writeBuff_);
-
-    
-    // const_cast：用于移除或添加 const修饰符
-    iov_[0].iov_base = const_cast<char*>(writeBuff_.Peek());
-    iov_[0].iov_len = writeBuff_.ReadableBytes();
-    iovCnt_ = 1;
-
-    /*
-    如果请求的文件​有效​​，File()返回该文件的内存映射。
-    如果请求的文件​无效​​（如 404），File()返回的是错误页面（如 404.html）的内存映射。
-    先通过 mmap将文件映射到内存（File()），
-    再用 iov_[1]指向该区域，
-    最后通过 writev将响应头和文件内容一并发送​​
-    */
-    if(response_.FileLen() > 0 && response_.File()) {
-        iov_[1].iov_base = response_.File();
-        iov_[1].iov_len = response_.FileLen();
-        iovCnt_ = 2;
+    if(respCnt_ == 0) {
+        ReleaseBuffers_();
+        return false;
     }
-    LOG_DEBUG("filesize:%d, %d  to %d", response_.FileLen() , iovCnt_, ToWriteBytes());
+    LOG_DEBUG("responses:%d, iov:%d, to write %zu", respCnt_, writeBuff_.IovCount(), ToWriteBytes());
     return true;
-}
\ No newline at end of file
+}
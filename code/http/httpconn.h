@@ -4,20 +4,28 @@
 #include <sys/types.h>      // 定义基本系统数据类型-size_t、ssize_t、pid_t
 #include <sys/uio.h>        // readv、writev
 #include <arpa/inet.h>      // 互联网地址操作函数
+#include <sys/socket.h>     // shutdown
 #include <stdlib.h>         // 通用工具函数—atoi()：字符串转为整数
 #include <errno.h>
+#include <memory>
+#include <vector>
+#include <sys/sendfile.h>   // sendfile
+#include <limits.h>         // IOV_MAX
 
 #include "../buffer/buffer.h"
-#include "../pool/sqlconnpool.h"
+#include "../buffer/chainbuffer.h"
 #include "../log/log.h"
 #include "httprequest.h"
 #include "httpresponse.h"
+#include "../coro/iocontext.h"
 
 /*httpconn实现功能
 1、读取请求
 2、解析请求
 3、生成响应
 4、发送响应
+流水线(pipelining)：一次process()处理读缓冲区中所有完整的请求(最多pipelineDepth个)，
+各响应按请求顺序排进写缓冲区(ChainBuffer)：响应头拷贝，文件内容按引用追加，一次writev发出
 */
 
 class HttpConn {
@@ -25,51 +33,138 @@ public:
     HttpConn();
     ~HttpConn();
 
-    void init(int sockFd, const sockaddr_in& addr);
+    // token：注册到Epoller、提交给线程池和定时器时用来找回连接的句柄(SubReactor的连接Slab分配)
+    void init(int sockFd, const sockaddr_in& addr, uint64_t token);
     void Close();                   // 关闭连接
 
 
     sockaddr_in GetAddr() const;    // 获取客户端地址结构体
     int GetFd() const;              // 获取文件描述符
+    // 注册到Epoller时带的token：连接的Slab句柄，就绪事件直接找回连接，不用按fd查表；
+    // 连接关闭后句柄失效，晚到的事件和定时器回调不会落到复用同一个fd的新连接上
+    uint64_t Token() const {
+        return token_;
+    }
     int GetPort() const;            // 获取客户端端口号
     const char* GetIP() const;      // 获取客户端IP
 
 
     ssize_t read(int* saveErrno);
     ssize_t write(int* saveErrno);
-    bool process();                 // 处理HTTP请求并生成响应
+#ifdef CORO_ENABLED
+    // 协程方式：co_await conn.ReadAsync(io)读到数据，co_await conn.WriteAllAsync(io)发完本批响应
+    Co<bool> ReadAsync(IoContext& io);
+    Co<bool> WriteAllAsync(IoContext& io);
+#endif
+    /*
+    不经过read()/write()的I/O(io_uring)：内核收到的数据用Feed()放进读缓冲区；
+    发送时先发WriteIov()，再发PendingFile()的文件内容，发出len字节后调用Written(len)
+    write()也用Written()记录进度，两种方式的发送状态是同一份
+    */
+    void Feed(const char* data, size_t len);
+    const struct iovec* WriteIov(int* cnt);
+    bool PendingFile(int* fd, off_t* offset, size_t* len) const;
+    void Written(size_t len);
+
+    // 处理HTTP请求并生成响应，没有可以返回的响应时返回false
+    // allowSlow为false时不做数据库验证，停在需要验证的请求之前
+    bool process(bool allowSlow = true);
+    // 有一个解析完、等待数据库验证的请求(process(false)停下的原因)
+    bool HasSlowRequest() const {
+        return request_.NeedsVerify();
+    }
 
 
+    // 本批最后一个响应之后是否保持连接
     bool IsKeepAlive() const {
-        return request_.IsKeepAlive();
+        return isKeepAlive_;
+    }
+    // 计算待写入的总字节数(包括还没sendfile的文件内容)
+    size_t ToWriteBytes() const {
+        return writeBuff_.ReadableBytes() + fileRemain_;
+    }
+
+
+    /*
+    线程池模式的调度状态，只在所属Reactor线程读写：
+    读写任务在排队或执行期间连接是busy的，这期间超时只做标记(MarkClose)，
+    任务结束、连接交回Reactor线程时再关闭，工作线程用着的连接不会被关闭或重用
+    */
+    bool IsBusy() const {
+        return busy_;
+    }
+    void SetBusy(bool busy) {
+        busy_ = busy;
     }
-    // 计算待写入的总字节数
-    int ToWriteBytes() {
-        return iov_[0].iov_len + iov_[1].iov_len;
+    void MarkClose() {
+        closePending_ = true;
     }
+    bool ClosePending() const {
+        return closePending_;
+    }
+
+
+    /*
+    延迟关闭(lingering close)：出错的响应(400、413等)之后连接要关闭，但客户端可能还在上传请求体，
+    这时直接close，接收队列里没读的数据会让内核发RST，客户端可能还没读到响应就被重置。
+    所以先shutdown写方向(客户端读到响应和EOF)，再读出并丢弃客户端发来的数据，
+    直到对端关闭、丢弃的数据超过MAX_LINGER_BYTES或者LINGER_MS内没有新数据，再关闭
+    */
+    bool NeedsLinger() const {      // 本批响应发完后应当延迟关闭
+        return needsLinger_;
+    }
+    void StartLinger();
+    bool Lingering() const {
+        return lingering_;
+    }
+    // 丢弃读缓冲区中的数据，超过MAX_LINGER_BYTES时返回false，应当关闭连接
+    bool Discard();
 
 
     static bool isET;       // 是否使用ET(边缘触发)模式
     static const char* srcDir;
     static std::atomic<int> userCount;      // 原子计数器，记录当前活跃的用户连接数
+    static int pipelineDepth;               // 一次最多处理的请求数，1表示不做流水线
+    static const int MAX_PIPELINE_DEPTH = 16;
+    static const int LINGER_MS = 2000;                      // 延迟关闭时等待新数据的时间
+    static const size_t MAX_LINGER_BYTES = 1024 * 1024;     // 延迟关闭时最多丢弃的字节数
 
 
 private:
     int fd_;
+    uint64_t token_;
     struct sockaddr_in addr_;      // 客户端地址信息
     
 
+    void ReleaseResponses_();    // 释放上一批响应占用的映射/缓存项
+    void ReleaseBuffers_();      // 空闲时释放读写缓冲区的内存
+
     bool isClose_;
-    int iovCnt_;
-    struct iovec iov_[2];       // 响应报文内容较多，因此使用分散写
+    bool isKeepAlive_;
+    bool busy_;
+    bool closePending_;
+    bool needsLinger_;
+    bool lingering_;
+    size_t discarded_;      // 延迟关闭以来丢弃的字节数
+    // WriteIov()导出的writeBuff_，sendmsg完成前不能变；只有io_uring模式用到
+    std::vector<struct iovec> iov_;
+
+    // sendfile发送大文件：先发完writeBuff_，再从fileOffset_开始发fileRemain_字节
+    // 只有一批中的最后一个响应会用sendfile
+    off_t fileOffset_;
+    size_t fileRemain_;
 
 
-    Buffer readBuff_;   // 读缓冲区——HTTP请求
-    Buffer writeBuff_;  // 写缓冲区——HTTP响应
+    // 读写缓冲区只在有数据时占用内存：构造时不分配，连接空闲(响应发完、没有未处理的请求)时释放
+    Buffer readBuff_;           // 读缓冲区——HTTP请求，解析需要连续内存
+    // 写缓冲区——HTTP响应：分散写，响应头在自有块中，文件内容和缓存的响应头按引用追加
+    ChainBuffer writeBuff_;
 
 
     HttpRequest request_;
-    HttpResponse response_;
+    // 本批的响应，按需创建；用指针保存，扩容时已映射的响应不会被拷贝
+    std::vector<std::unique_ptr<HttpResponse>> responses_;
+    int respCnt_;
 };
 
 #endif
\ No newline at end of file
@@ -1,3 +1,4 @@
+#define LOG_MODULE Log::HTTP
 #include "httprequest.h"
 
 // 默认HTTP页面集合，用于路径补全
@@ -6,23 +7,89 @@ const std::unordered_set<std::string> HttpRequest::DEFAULT_HTML {
     "/register", "/login",
 };
 // /register和/login需要区分注册和登记的业务逻辑，其余只需要补全路径
+// 解析请求行时path_已经补全了.html，这里按补全后的路径匹配
 const std::unordered_map<std::string, int> HttpRequest::DEFAULT_HTML_TAG {
-    {"/register", 0}, {"/login", 1},
+    {"/register.html", 0}, {"/login.html", 1},
 };
 
 void HttpRequest::Init() {
-    method_ = path_ = version_ = body_ = "";
+    path_.clear();      // clear()保留容量，下一个请求赋值时不再分配
+    body_.Reset();
+    // head_只在请求体分多次读取时使用，可能有几十KB，不保留容量；平时是空串，swap不分配
+    std::string().swap(head_);
     state_ = REQUEST_LINE;
-    header_.clear();
-    post_.clear();
+    lineStart_ = scanned_ = headEnd_ = contentLen_ = 0;
+    base_ = nullptr;
+    chunked_ = streaming_ = false;
+    bodyRemain_ = chunkRemain_ = 0;
+    chunkState_ = CHUNK_SIZE;
+    method_ = version_ = {0, 0};
+    headerCnt_ = 0;
+    // clear()会保留桶数组；只有POST请求用过，释放掉，空闲连接不占这部分内存
+    if(!post_.empty()) {
+        std::unordered_map<std::string, std::string>().swap(post_);
+    }
+    verifyTag_ = -1;
+}
+
+// 不区分大小写比较，HTTP请求头名称大小写不敏感
+static bool EqualsNoCase(std::string_view a, std::string_view b) {
+    if(a.size() != b.size()) {
+        return false;
+    }
+    for(size_t i = 0; i < a.size(); i++) {
+        if(tolower(static_cast<unsigned char>(a[i])) != tolower(static_cast<unsigned char>(b[i]))) {
+            return false;
+        }
+    }
+    return true;
 }
 
 bool HttpRequest::IsKeepAlive() const {
-    if(header_.count("Connection") == 1) {
-        // 1、要求显示表达HTTP版本为1.1  2、Connection模式必须是keep-alive
-        return header_.find("Connection")->second == "keep-alive" && version_ == "1.1";
+    std::string_view conn = GetHeader("Connection");
+    // 1、要求显示表达HTTP版本为1.1  2、Connection模式必须是keep-alive
+    return EqualsNoCase(conn, "keep-alive") && version() == "1.1";
+}
+
+static std::string_view TrimSpace(std::string_view s) {
+    while(!s.empty() && (s.front() == ' ' || s.front() == '\t')) {
+        s.remove_prefix(1);
     }
-    return false;
+    while(!s.empty() && (s.back() == ' ' || s.back() == '\t')) {
+        s.remove_suffix(1);
+    }
+    return s;
+}
+
+/* Accept-Encoding: gzip, deflate;q=0.5, *;q=0
+逗号分隔，每项可带q值，q=0表示不接受；未列出的编码看"*"
+*/
+bool HttpRequest::AcceptEncoding(std::string_view coding) const {
+    std::string_view list = GetHeader("Accept-Encoding");
+    int star = 0;   // "*"：0-未出现  1-接受  -1-拒绝
+    while(!list.empty()) {
+        size_t comma = list.find(',');
+        std::string_view item = list.substr(0, comma);
+        list = (comma == std::string_view::npos) ? std::string_view() : list.substr(comma + 1);
+
+        size_t semi = item.find(';');
+        std::string_view name = TrimSpace(item.substr(0, semi));
+        bool accept = true;
+        if(semi != std::string_view::npos) {
+            std::string_view param = TrimSpace(item.substr(semi + 1));
+            if(param.size() > 2 && (param[0] == 'q' || param[0] == 'Q') && param[1] == '=') {
+                // q值只由0和'.'组成即为0
+                accept = param.find_first_not_of("0.", 2) != std::string_view::npos;
+            }
+        }
+        if(EqualsNoCase(name, coding)) {
+            return accept;
+        }
+        if(name == "*") {
+            star = accept ? 1 : -1;
+        }
+    }
+    return star == 1;
 }
 
 /* 一个POST方法的请求报文
@@ -33,56 +100,80 @@ Content-Type: application/x-www-form-urlencoded
 Content-Length: 123
 
 username=test%20user&password=123%40abc           // 请求体
+
+解析过程中不Retrieve，只记录偏移(相对Peek())，因此数据分多次到达也能从上次的位置继续；
+整个请求到齐后才一次性Retrieve
 */
-bool HttpRequest::parse(Buffer& buff) {
-    // 请求报文中，每一行以CRLF-回车换行符为结尾
-    const char CRLF[] = "\r\n";
+HttpRequest::HTTP_CODE HttpRequest::parse(Buffer& buff) {
+    if(state_ == FINISH) {      // 上一个请求已经处理完了
+        Init();
+    }
     if(buff.ReadableBytes() <= 0) {
-        return false;
+        return NO_REQUEST;
     }
-    // 逐行解析报文
-    while(buff.ReadableBytes() && state_ != FINISH) {
-        // 提取一行报文
-        /*search()：在[buff.Peak, buff.BeginWriteConst)中查找子序列[CRLF, CRLF+2)的第一次出现位置*/
-        /*C风格中，char数组末尾以\0为结尾，因此CRLF在buff中表示为\r\n\0，因此lineEnd='\r'*/
-        const char* lineEnd = std::search(buff.Peek(), buff.BeginWriteConst(), CRLF, CRLF + 2);
-        // 未找到CRLF，跳出循环，等待下次数据到来
-        if(lineEnd == buff.BeginWrite()) {
-            break;
+    // 请求体分多次读取时，请求头已经不在缓冲区里了
+    if(!streaming_) {
+        base_ = buff.Peek();
+    }
+    // 逐行解析请求行和请求头
+    while(state_ == REQUEST_LINE || state_ == HEADERS) {
+        // '\r'可能是上次数据的最后一个字节，因此回退一个字节再找
+        size_t from = std::max(lineStart_, scanned_ > 0 ? scanned_ - 1 : 0);
+        size_t pos = buff.FindCRLF(from);
+        if(pos == Buffer::npos) {
+            scanned_ = buff.ReadableBytes();
+            if(scanned_ > MAX_HEAD_SIZE) {
+                LOG_WARN("Request head too large");
+                state_ = FINISH;
+                return BAD_REQUSET;
+            }
+            return NO_REQUEST;      // 未找到CRLF，等待下次数据到来
         }
-
-        std::string line(buff.Peek(), lineEnd);
-
+        const char* lineBegin = base_ + lineStart_;
+        const char* lineEnd = base_ + pos;
+        bool ok = true;
         switch(state_)
         {
         /*
-            有限状态机，从请求行开始，每处理完后会自动转入到下一个状态    
+            有限状态机，从请求行开始，每处理完后会自动转入到下一个状态
         */
         case REQUEST_LINE:
-            if(!ParseRequestLine_(line)) {   // 解析失败
-                return false;
+            ok = ParseRequestLine_(lineBegin, lineEnd, lineStart_);
+            if(ok) {
+                ParsePath_();
             }
-            // 若解析成功，ParseRequsetLine_()将状态转换为HEADERS
-            ParsePath_();
             break;
         case HEADERS:
-            ParseHeader_(line);
-            // 只有CRLF或无数据(代表ParseHeader_()部分也不会跳转到BODY部分)
-            if(buff.ReadableBytes() <= 2) {
-                state_ = FINISH;
-            }
-            break;
-        case BODY:
-            ParseBody_(line);
+            ok = ParseHeader_(lineBegin, lineEnd, lineStart_);
             break;
         default:
             break;
         }
-        buff.RetrieveUntil(lineEnd + 2);
+        if(!ok) {
+            state_ = FINISH;
+            return BAD_REQUSET;
+        }
+        lineStart_ = scanned_ = lineEnd + 2 - base_;
+        // 每行都完整、但行数多的请求头同样受MAX_HEAD_SIZE限制
+        if(lineStart_ > MAX_HEAD_SIZE) {
+            LOG_WARN("Request head too large");
+            state_ = FINISH;
+            return BAD_REQUSET;
+        }
     }
-    // LOG是C风格函数，无法识别string，只能用c_str()将其转换为const char*
-    LOG_ERROR("[%s], [%s], [%s]", method_.c_str(), path_.c_str(), version_.c_str());
-    return true;
+    if(state_ == BODY) {
+        HTTP_CODE ret = ParseBody_(buff);
+        if(ret == NO_REQUEST) {
+            return NO_REQUEST;      // 请求体还没收完
+        }
+        state_ = FINISH;
+        if(ret != GET_REQUSET) {
+            return ret;
+        }
+    }
+    LOG_DEBUG("[%.*s], [%s], [%.*s]", (int)method_.len, base_ + method_.off, path_.c_str(),
+              (int)version_.len, base_ + version_.off);
+    return GET_REQUSET;
 }
 
 /*
@@ -105,42 +196,201 @@ void HttpRequest::ParsePath_() {
     }
 }
 
-bool HttpRequest::ParseRequestLine_(const std::string& line) {
-    // 编译正则表达式模式
-    std::regex patten("^([^ ]*) ([^ ]*) HTTP/([^ ]*)$");
-    // 存储正则表达式匹配结果
-    std::smatch subMatch;
-    if(std::regex_match(line, subMatch, patten)) {
-        method_ = subMatch[1];
-        path_ = subMatch[2];
-        version_ = subMatch[3];
-        state_ = HEADERS;
-        return true;
+// 请求行：METHOD SP PATH SP HTTP/VERSION，等价于原来的正则 ^([^ ]*) ([^ ]*) HTTP/([^ ]*)$
+bool HttpRequest::ParseRequestLine_(const char* begin, const char* end, size_t off) {
+    const char* sp1 = Buffer::ScanChar(begin, end, ' ');
+    if(sp1 == nullptr || sp1 == begin) {
+        LOG_ERROR("RequestLine Error");
+        return false;
     }
-    else {
+    const char* sp2 = Buffer::ScanChar(sp1 + 1, end, ' ');
+    // 路径不能为空，版本部分必须以HTTP/开头且不能再有空格
+    if(sp2 == nullptr || sp2 == sp1 + 1 || end - sp2 <= 6 ||
+       memcmp(sp2 + 1, "HTTP/", 5) != 0 || Buffer::ScanChar(sp2 + 1, end, ' ')) {
         LOG_ERROR("RequestLine Error");
         return false;
     }
+    method_ = {static_cast<uint32_t>(off), static_cast<uint32_t>(sp1 - begin)};
+    path_.assign(sp1 + 1, sp2);
+    version_ = {static_cast<uint32_t>(off + (sp2 + 6 - begin)), static_cast<uint32_t>(end - (sp2 + 6))};
+    state_ = HEADERS;
+    return true;
+}
+
+// 请求头：KEY: VALUE，等价于原来的正则 ^([^:]*): ?(.*)$；遇到空行代表请求头结束
+bool HttpRequest::ParseHeader_(const char* begin, const char* end, size_t off) {
+    if(begin == end) {
+        headEnd_ = off + 2;
+        // 请求体长度：Transfer-Encoding: chunked，或者Content-Length，都没有则没有请求体
+        std::string_view te = GetHeader("Transfer-Encoding");
+        std::string_view len = GetHeader("Content-Length");
+        if(!te.empty()) {
+            // 只支持chunked；同时带Content-Length的请求可能是请求走私，直接拒绝
+            if(!EqualsNoCase(te, "chunked") || !len.empty()) {
+                LOG_ERROR("Transfer-Encoding Error");
+                return false;
+            }
+            chunked_ = true;
+        }
+        contentLen_ = 0;
+        if(len.size() > 18) {       // 防止溢出
+            LOG_ERROR("Content-Length Error");
+            return false;
+        }
+        for(char ch : len) {
+            if(ch < '0' || ch > '9') {
+                LOG_ERROR("Content-Length Error");
+                return false;
+            }
+            contentLen_ = contentLen_ * 10 + (ch - '0');
+        }
+        state_ = BODY;
+        return true;
+    }
+    const char* colon = Buffer::ScanChar(begin, end, ':');
+    if(colon == nullptr || colon == begin || headerCnt_ >= MAX_HEADERS) {
+        LOG_ERROR("Header Error");
+        return false;
+    }
+    // 去掉值两侧的空白
+    const char* vBegin = colon + 1;
+    const char* vEnd = end;
+    while(vBegin < vEnd && (*vBegin == ' ' || *vBegin == '\t')) vBegin++;
+    while(vEnd > vBegin && (vEnd[-1] == ' ' || vEnd[-1] == '\t')) vEnd--;
+    Header& h = header_[headerCnt_++];
+    h.key = {static_cast<uint32_t>(off), static_cast<uint32_t>(colon - begin)};
+    h.value = {static_cast<uint32_t>(off + (vBegin - begin)), static_cast<uint32_t>(vEnd - vBegin)};
+    return true;
 }
 
-void HttpRequest::ParseHeader_(const std::string& line) {
-    std::regex patten("^([^:]*): ?(.*)$");
-    std::smatch subMatch;
-    if(std::regex_match(line, subMatch, patten)) {
-        header_[subMatch[1]] = subMatch[2];
+// 请求体按Content-Length接收，收齐后整个请求一起Retrieve
+HttpRequest::HTTP_CODE HttpRequest::ParseBody_(Buffer& buff) {
+    if(!streaming_) {
+        if(!chunked_ && contentLen_ > BodySink::maxSize) {
+            LOG_WARN("Body too large: %zu", contentLen_);
+            return TOO_LARGE_REQUEST;
+        }
+        // 整个请求体已经在缓冲区里，并且不需要落盘：直接拷贝，请求头仍然指向缓冲区
+        if(!chunked_ && buff.ReadableBytes() >= headEnd_ + contentLen_ && contentLen_ <= BodySink::memLimit) {
+            body_.Append(base_ + headEnd_, contentLen_);
+            buff.Retrieve(headEnd_ + contentLen_);
+            return FinishBody_();
+        }
+        // 请求体要分多次读取：把请求头拷贝出来，读缓冲区里已收到的请求体边读边写入body_
+        head_.assign(base_, headEnd_);
+        base_ = head_.data();
+        buff.Retrieve(headEnd_);
+        bodyRemain_ = contentLen_;
+        streaming_ = true;
     }
-    // 不成功是因为遇到空行了，代表HEADER部分结束，跳转到BODY
-    else {
-        state_ = BODY;     
+    if(chunked_) {
+        return ParseChunked_(buff);
     }
+    size_t n = std::min(bodyRemain_, buff.ReadableBytes());
+    if(n > 0 && !body_.Append(buff.Peek(), n)) {
+        return INTERNAL_ERROR;
+    }
+    buff.Retrieve(n);
+    bodyRemain_ -= n;
+    if(bodyRemain_ > 0) {
+        return NO_REQUEST;
+    }
+    return FinishBody_();
 }
 
-void HttpRequest::ParseBody_(const std::string& line) {
-    body_ = line;
-    // 解析POST表单并进行用户验证
-    ParsePost_();   
-    state_ = FINISH;
-    LOG_DEBUG("Body:%s, len:%s", line.c_str(), line.size());
+/* chunked：
+chunk-size(16进制)[;扩展] CRLF
+chunk-data CRLF
+...
+0 CRLF
+[trailer字段 CRLF]*
+CRLF
+已解析的部分随时从缓冲区取走，数据不完整时停在chunkState_，下次继续
+*/
+HttpRequest::HTTP_CODE HttpRequest::ParseChunked_(Buffer& buff) {
+    while(true) {
+        switch(chunkState_)
+        {
+        case CHUNK_SIZE: {
+            size_t pos = buff.FindCRLF(0);
+            if(pos == Buffer::npos) {
+                return buff.ReadableBytes() > MAX_CHUNK_LINE ? BAD_REQUSET : NO_REQUEST;
+            }
+            const char* p = buff.Peek();
+            size_t size = 0, digits = 0;
+            for(; digits < pos && isxdigit(static_cast<unsigned char>(p[digits])); digits++) {
+                char ch = p[digits];
+                size = size * 16 + (ch <= '9' ? ch - '0' : (ch | 0x20) - 'a' + 10);
+            }
+            // 至少一位16进制数，后面只能是扩展或空白；超过15位可能溢出
+            if(digits == 0 || digits > 15 || (digits < pos && p[digits] != ';' &&
+               p[digits] != ' ' && p[digits] != '\t')) {
+                LOG_ERROR("Chunk size Error");
+                return BAD_REQUSET;
+            }
+            buff.Retrieve(pos + 2);
+            if(size == 0) {
+                chunkState_ = CHUNK_TRAILER;
+                break;
+            }
+            if(body_.Size() + size > BodySink::maxSize) {
+                LOG_WARN("Body too large: %zu", body_.Size() + size);
+                return TOO_LARGE_REQUEST;
+            }
+            chunkRemain_ = size;
+            chunkState_ = CHUNK_DATA;
+            break;
+        }
+        case CHUNK_DATA: {
+            size_t n = std::min(chunkRemain_, buff.ReadableBytes());
+            if(n == 0) {
+                return NO_REQUEST;
+            }
+            if(!body_.Append(buff.Peek(), n)) {
+                return INTERNAL_ERROR;
+            }
+            buff.Retrieve(n);
+            chunkRemain_ -= n;
+            if(chunkRemain_ == 0) {
+                chunkState_ = CHUNK_DATA_END;
+            }
+            break;
+        }
+        case CHUNK_DATA_END:
+            if(buff.ReadableBytes() < 2) {
+                return NO_REQUEST;
+            }
+            if(buff.Peek()[0] != '\r' || buff.Peek()[1] != '\n') {
+                LOG_ERROR("Chunk data Error");
+                return BAD_REQUSET;
+            }
+            buff.Retrieve(2);
+            chunkState_ = CHUNK_SIZE;
+            break;
+        case CHUNK_TRAILER: {
+            // trailer字段不使用，直接跳过，空行表示请求结束
+            size_t pos = buff.FindCRLF(0);
+            if(pos == Buffer::npos) {
+                return buff.ReadableBytes() > MAX_CHUNK_LINE ? BAD_REQUSET : NO_REQUEST;
+            }
+            buff.Retrieve(pos + 2);
+            if(pos == 0) {
+                return FinishBody_();
+            }
+            break;
+        }
+        }
+    }
+}
+
+// 请求体收完：内存中的表单才解析，落盘的大请求体留给上层处理
+HttpRequest::HTTP_CODE HttpRequest::FinishBody_() {
+    if(body_.Size() > 0 && body_.InMemory()) {
+        // 解析POST表单并进行用户验证
+        ParsePost_();
+        LOG_DEBUG("Body:%s, len:%d", body_.Data().c_str(), (int)body_.Size());
+    }
+    return GET_REQUSET;
 }
 
 // 16进制转10进制
@@ -154,67 +404,76 @@ int HttpRequest::ConverHex(char ch) {
     return ch;
 }
 
-// 处理POST请求——解析表单数据并进行用户验证(如果是POST方法的话)
+// 处理POST请求——解析表单数据；注册或登录要查数据库，只记下来，由Verify()完成
 void HttpRequest::ParsePost_() {
-    if(method_ == "POST" && header_["Connect-Type"] == "application/x-www-form-urlencoded") {
+    if(method() == "POST" && GetHeader("Content-Type") == "application/x-www-form-urlencoded") {
         // 解析表单数据，映射到post_里
         ParseFromUrlencoded_();  
-        // 解析完表单数据，如果是注册或登记，就进行用户验证
+        // 解析完表单数据，如果是注册或登记，就需要用户验证
         if(DEFAULT_HTML_TAG.count(path_)) {
             int tag = DEFAULT_HTML_TAG.find(path_)->second;
             LOG_DEBUG("Tag:%d", tag);
             if(tag == 0 || tag == 1) { 
-                bool isLogin = (tag == 1);
-                // 用户验证
-                if(UserVerify(post_["username"], post_["password"], isLogin)) {
-                    path_ = "/welcome.html";
-                }
-                else {
-                    path_ = "/error.html";
-                }
+                verifyTag_ = tag;
             }
         }
     }
 }
 
+// 用户验证，根据结果改写path_
+void HttpRequest::Verify() {
+    if(verifyTag_ < 0) {
+        return;
+    }
+    bool isLogin = (verifyTag_ == 1);
+    verifyTag_ = -1;
+    if(UserVerify(post_["username"], post_["password"], isLogin)) {
+        path_ = "/welcome.html";
+    }
+    else {
+        path_ = "/error.html";
+    }
+}
+
 // 解析的是POST请求体中的数据(且这些数据用的是URL编码格式)，存放到post_里
 void HttpRequest::ParseFromUrlencoded_() {
-    if(body_.size() == 0) {
+    std::string& body = body_.Data();   // 原地解码
+    if(body.size() == 0) {
         return;
     }
 
     std::string key, value;
     int num = 0;
-    int n = body_.size();
+    int n = body.size();
     int i = 0, j = 0;
 
     for(; i < n; i++) {
-        char ch = body_[i];
+        char ch = body[i];
         switch(ch)
         {
         // '='的前面为key，后面为value
         case '=':
-            key = body_.substr(j, i-j); // substr(pos, len)
+            key = body.substr(j, i-j); // substr(pos, len)
             j = i + 1;
             break;
         // '&'代表一个键值对的结束
         case '&':
-            value = body_.substr(j, i-j);
+            value = body.substr(j, i-j);
             j = i + 1;
             post_[key] = value;
             LOG_DEBUG("key:%s, value:%s", key.c_str(), value.c_str());
             break;
         // '+'解码为空格
         case '+':
-            body_[i] = ' ';
+            body[i] = ' ';
             break;
         // '%HH'
         case '%':
-            num = ConverHex(body_[i+1]) * 16 + ConverHex(body_[i+2]);
+            num = ConverHex(body[i+1]) * 16 + ConverHex(body[i+2]);
             // 先由16进制数转为10进制，再转为ASCII码重新存入
             // 这地方似乎有问题？不应该是将num转为ASCII码后存入吗？为什么要分开个位和十位呢？
-            body_[i+1] = num / 10 + '0';
-            body_[i+2] = num % 10 + '0';
+            body[i+1] = num / 10 + '0';
+            body[i+2] = num % 10 + '0';
             break;
         default:
             break;
@@ -223,89 +482,11 @@ void HttpRequest::ParseFromUrlencoded_() {
     // 此时i=n-1，j=最后一个'&'后一个
     assert(j <= i);
     if(post_.count(key) == 0 && j < i) {
-        value = body_.substr(j, i-j);
+        value = body.substr(j, i-j);
          post_[key] = value;
     }
 }
 
-// 注册成功、登录成功都返回true，除此之外都返回false
-bool HttpRequest::UserVerify(const std::string &name, const std::string &pwd, bool isLogin) {
-    if(name == "" || pwd == "") {
-        return false;
-    }
-    LOG_INFO("Verify name:%s, pwd:%s", name.c_str(), pwd.c_str());
-    MYSQL* sql;
-    // RAII技术，且此时的sql是从连接池中get的
-    SqlConnRAII(&sql, SqlConnPool::Instance());
-    assert(sql);
-
-    /*登录时，flag=false，默认登录失败； 注册时，flag=true，默认注册成功*/
-    bool flag = false;
-    MYSQL_RES* res = nullptr;   // 结果集，即整个TABLE内容
-    MYSQL_FIELD* fields = nullptr;   // 字段，即TABLE中的表头
-    unsigned int j = 0;   // 有多少字段，即表头有多少列
-    char order[256] = {0};      // 放MYSQL命令的缓冲区
-
-    if(!isLogin) {   // 注册
-        flag = true;
-    }
-    // 该命令相当于查找TABLE-user中username对应的那一行
-    snprintf(order, 256, "SELECT username, password FROM user WHERE username='%s' LIMIT 1", name.c_str());
-    LOG_DEBUG("SELCET the USER'S info:%s", order);
-
-    // mysql_query()：执行MYSQL命令成功(这里的执行成功不一定代表TABLE中有对应username)返回0，不进入while
-    if(mysql_query(sql, order)) {
-        mysql_free_result(res);  // 释放结果集
-        return false;
-    }
-
-    // 这里的东西都是查询username成功后的信息了
-    res = mysql_store_result(sql);  // 结果集
-    j = mysql_num_fields(res);      // 字段长
-    fields = mysql_fetch_fields(res);  // 字段
-
-    // 进入while，说明row != NULL
-    while(MYSQL_ROW row = mysql_fetch_row(res)) {
-        LOG_DEBUG("username is %s, pwd is %s", row[0], row[1]);
-        std::string password(row[1]);      // 数据库中对应的真实密码
-        // 登录验证
-        if(isLogin) {
-            if(pwd == password) {
-                flag = true;   // 密码验证成功
-            }
-            else {
-                flag = false;
-                LOG_DEBUG("pwd error!");
-            }
-        }
-        else {   // 能进入这个while循环且是注册，证明之前row不为空，代表已经有这个用户名了
-            flag = false;
-            LOG_DEBUG("user used!");
-        }
-    }
-    mysql_free_result(res);
-
-    /*注册行为 且 用户名未被使用*/
-    if(!isLogin && flag == true) {
-        LOG_DEBUG("register!");
-        bzero(order, 256);
-        snprintf(order, 256, "INSERT INTO user(username, password) VALUES('%s','%s')", name.c_str(), pwd.c_str());
-        LOG_DEBUG("Insert command is:%s", order);
-        // 注册命令失败
-        if(mysql_query(sql, order)) {
-            LOG_DEBUG("Insert error!");
-            flag = false;
-        }
-        // 注册成功
-        flag = true;
-    }
-    SqlConnPool::Instance()->FreeConn(sql);
-    LOG_DEBUG("UserVerify success!")
-    /*这里包括的isLogin=true 且 username不存在的情况，直接返回flag=false*/
-    return flag;
-}
-
-
 std::string HttpRequest::path() const{
     return path_;
 }
@@ -313,12 +494,21 @@ std::string HttpRequest::path() const{
 std::string& HttpRequest::path(){
     return path_;
 }
-std::string HttpRequest::method() const {
-    return method_;
+std::string_view HttpRequest::method() const {
+    return View_(method_);
 }
 
-std::string HttpRequest::version() const {
-    return version_;
+std::string_view HttpRequest::version() const {
+    return View_(version_);
+}
+
+std::string_view HttpRequest::GetHeader(std::string_view key) const {
+    for(size_t i = 0; i < headerCnt_; i++) {
+        if(EqualsNoCase(View_(header_[i].key), key)) {
+            return View_(header_[i].value);
+        }
+    }
+    return std::string_view();
 }
 
 std::string HttpRequest::GetPost(const std::string& key) const {
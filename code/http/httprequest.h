@@ -1,25 +1,28 @@
 #ifndef HTTP_REQUEST_H
-#define HTTP_REQUSET_H
+#define HTTP_REQUEST_H
 
 #include <string>
-#include <regex>  // 正则表达式
+#include <string_view>  // C++17，指向读缓冲区的只读视图，不拷贝
 #include <errno.h>  // 错误号定义
-#include <mysql/mysql.h>
 #include <unordered_map>
 #include <unordered_set>
 
 #include "../buffer/buffer.h"
 #include "../log/log.h"
-#include "../pool/sqlconnpool.h"
+#include "bodysink.h"
 
 /*
 ​1、​初始化​​：创建对象时调用 Init()初始化所有成员变量。
 ​​2、解析请求​​：调用 parse(Buffer& buff)开始解析，按照状态逐步解析：
     - 首先解析请求行（ParseRequestLine_）
     - 然后解析请求头（ParseHeader_）
-    - 最后解析请求体（ParseBody_）
-​​3、数据处理​​：解析过程中填充成员变量，如 method_、path_、header_等。
+    - 最后解析请求体（ParseBody_）：按Content-Length或chunked分块读取，
+      写入BodySink(小的在内存，大的落到临时文件)，不需要整个请求体都在读缓冲区里
+​​3、数据处理​​：解析过程中只记录各字段相对buff.Peek()的偏移，不拷贝；
+    数据不完整时返回NO_REQUEST，下次parse()从上次停下的位置继续
 ​​4、结果获取​​：通过公共成员函数获取解析结果。
+    method()/version()/GetHeader()返回指向读缓冲区的string_view，
+    在下一次向该Buffer写入数据之前有效
 */
 
 class HttpRequest {
@@ -42,40 +45,102 @@ public:
         FILE_REQUEST,
         INTERNAL_ERROR,
         CLOSED_CONNECTION,
+        TOO_LARGE_REQUEST,      // 请求体超过BodySink::maxSize
+    };
+
+// chunked请求体的解析阶段
+    enum CHUNK_STATE {
+        CHUNK_SIZE,         // chunk-size[;ext] CRLF
+        CHUNK_DATA,         // chunk-data
+        CHUNK_DATA_END,     // chunk-data后的CRLF
+        CHUNK_TRAILER,      // 最后一个chunk之后的trailer，直到空行
     };
 
     HttpRequest() {Init();}
     ~HttpRequest() = default;
 
     void Init();
-    bool parse(Buffer& buff);       // 从缓冲区解析HTTP请求
+    // 从缓冲区解析HTTP请求：NO_REQUEST-数据不完整  GET_REQUSET-解析完成  BAD_REQUSET-请求格式错误
+    // TOO_LARGE_REQUEST-请求体过大  INTERNAL_ERROR-请求体写入临时文件失败
+    // 解析完成后会Retrieve掉整个请求；上一个请求完成后再调用会自动Init()
+    HTTP_CODE parse(Buffer& buff);
 
     std::string path() const;       // 获取请求路径
     std::string& path();
-    std::string method() const;     // 获取请求方法
-    std::string version() const;    // 获取HTTP版本
+    std::string_view method() const;     // 获取请求方法
+    std::string_view version() const;    // 获取HTTP版本
+    std::string_view GetHeader(std::string_view key) const;  // 获取请求头(key不区分大小写)，不存在返回空
     std::string GetPost(const std::string& key) const;  // 获取POST参数
     std::string GetPost(const char* key) const;               // C风格
     bool IsKeepAlive() const;       // 检查是否是持久连接
-
+    bool AcceptEncoding(std::string_view coding) const;     // Accept-Encoding是否接受该编码(q=0视为拒绝)
+    // 注册/登录请求解析完成后需要查数据库验证用户；解析时不做，调用方可以把Verify()放到别处执行
+    bool NeedsVerify() const {
+        return verifyTag_ >= 0;
+    }
+    void Verify();
+    const BodySink& body() const {      // 请求体
+        return body_;
+    }
+
+    static const size_t MAX_HEADERS = 64;           // 请求头个数上限
+    static const size_t MAX_HEAD_SIZE = 64 * 1024;  // 请求行+请求头的字节数上限
+    static const size_t MAX_CHUNK_LINE = 1024;      // chunk-size行/trailer行的长度上限
 
 private:
-    // 解析相关函数
-    bool ParseRequestLine_(const std::string& line);
-    void ParseHeader_(const std::string& line);
-    void ParseBody_(const std::string& line);
+    // 字段在缓冲区中的位置：相对于buff.Peek()的偏移，缓冲区扩容/搬移后依然有效
+    struct Span {
+        uint32_t off;
+        uint32_t len;
+    };
+    struct Header {
+        Span key;
+        Span value;
+    };
+
+    // 解析相关函数，[begin, end)为一行(不含CRLF)，off为该行相对Peek()的偏移
+    bool ParseRequestLine_(const char* begin, const char* end, size_t off);
+    bool ParseHeader_(const char* begin, const char* end, size_t off);
+    HTTP_CODE ParseBody_(Buffer& buff);
+    HTTP_CODE ParseChunked_(Buffer& buff);
+    HTTP_CODE FinishBody_();
+    std::string_view View_(Span s) const {
+        return std::string_view(base_ + s.off, s.len);
+    }
 
     static int ConverHex(char ch);      // 16进制字符转换为10进制
     void ParsePath_();    // 处理请求路径
-    void ParsePost_();    // 解析POST表单数据 && 用户验证
+    void ParsePost_();    // 解析POST表单数据，记录是否需要用户验证
 
     void ParseFromUrlencoded_();    // 解析URL编码的表单数据
-    static bool UserVerify(const std::string& name, const std::string& pwd, bool isLogin);      // 用户验证函数
+    // 用户验证函数，查MySQL(实现在userverify.cpp)
+    static bool UserVerify(const std::string& name, const std::string& pwd, bool isLogin);
 
     PARSE_STATE state_;     // 当前解析状态
-    std::string method_, path_, version_, body_;
-    std::unordered_map<std::string,std::string> header_;    // 请求头键值对：Content-Type和Content-Length
+    size_t lineStart_;      // 当前未解析行的起始偏移
+    size_t scanned_;        // 已经查找过CRLF的位置，数据不完整时下次从这里继续找
+    size_t headEnd_;        // 请求头结束(空行之后)的偏移
+    size_t contentLen_;     // Content-Length
+    const char* base_;      // 解析完成时的buff.Peek()，各Span相对它取值；请求体分多次读取时指向head_
+
+    // 请求体
+    bool chunked_;          // Transfer-Encoding: chunked
+    bool streaming_;        // 请求头已经拷贝到head_，读缓冲区里只剩请求体
+    size_t bodyRemain_;     // Content-Length方式还没收到的字节数
+    CHUNK_STATE chunkState_;
+    size_t chunkRemain_;    // 当前chunk还没收到的字节数
+    std::string head_;      // 请求行+请求头的拷贝
+    BodySink body_;
+
+    Span method_, version_;
+    Header header_[MAX_HEADERS];    // 请求头，固定数组，避免每个请求都分配内存
+    size_t headerCnt_;
+
+    // path_会被改写(补全.html、登录跳转)，因此仍用string
+    // 连接复用时string保留容量，赋值不会重新分配
+    std::string path_;
     std::unordered_map<std::string,std::string> post_;      // POST参数键值对
+    int verifyTag_;         // 待验证：0-注册 1-登录，-1表示不需要
 
     static const std::unordered_map<std::string,int> DEFAULT_HTML_TAG;  // HTML标签映射
     static const std::unordered_set<std::string> DEFAULT_HTML;  // 默认HTML页面集合
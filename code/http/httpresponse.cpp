@@ -1,5 +1,8 @@
+#define LOG_MODULE Log::HTTP
 #include "httpresponse.h"
 
+#include <zlib.h>
+
 /*
 HTTP/1.1 200 OK                             // 状态行
 Date: Fri, 22 May 2009 06:07:21 GMT         // 响应头
@@ -35,16 +38,21 @@ const std::unordered_map<std::string, std::string> HttpResponse::SUFFIX_TYPE = {
     { ".avi",   "video/x-msvideo" },
     { ".gz",    "application/x-gzip" },
     { ".tar",   "application/x-tar" },
-    { ".css",   "text/css "},
-    { ".js",    "text/javascript "},
+    { ".css",   "text/css" },
+    { ".js",    "text/javascript" },
 };
 
 // 状态码到状态文本的映射 —— 用于构建状态行
 const std::unordered_map<int, std::string> HttpResponse::CODE_STATUS = {
     {200, "OK"},
+    {206, "Partial Content"},
+    {304, "Not Modified"},
     {400, "Bad Request"},
     {403, "Forbidden"},
     {404, "Not Found"},
+    {413, "Payload Too Large"},
+    {416, "Range Not Satisfiable"},
+    {500, "Internal Server Error"},
 };
 
 // 状态码到错误页面路径的映射 —— 提供错误提示页面
@@ -52,15 +60,35 @@ const std::unordered_map<int, std::string> HttpResponse:: CODE_PATH = {
     { 400, "/400.html" },
     { 403, "/403.html" },
     { 404, "/404.html" },
+    { 413, "/413.html" },
+    { 500, "/500.html" },
 };
 
+size_t HttpResponse::sendfileThreshold = 256 * 1024;
+
+// MIME类型到Cache-Control的映射：页面每次都要验证，静态资源允许浏览器缓存一天，未列出的类型不发送
+std::unordered_map<std::string, std::string> HttpResponse::cacheControl = {
+    { "text/html",          "no-cache" },
+    { "text/css",           "public, max-age=86400" },
+    { "text/javascript",    "public, max-age=86400" },
+    { "image/png",          "public, max-age=86400" },
+    { "image/gif",          "public, max-age=86400" },
+    { "image/jpeg",         "public, max-age=86400" },
+};
+
+// multipart/byteranges的分隔符，不会出现在正常的文件内容里
+const char HttpResponse::BOUNDARY[] = "3d6b6a416f9b5a1c7e2f";
+
 HttpResponse::HttpResponse() {
     code_ = -1;
     path_ = "";
     srcDir_ = "";
     isKeepAlive_ = false;
     mmFile_ = nullptr;
+    fileFd_ = -1;
     mmFileStat_ = {0};
+    bodyOffset_ = bodyLen_ = 0;
+    acceptGzip_ = acceptDeflate_ = false;
 }
 
 HttpResponse::~HttpResponse() {
@@ -70,46 +98,339 @@ HttpResponse::~HttpResponse() {
 // 这里的path和ErrorHtml中的path不一样
 void HttpResponse::Init(const std::string& srcDir, std::string& path, bool isKeepAlive, int code) {
     assert(srcDir != "");
-    if(mmFile_) {
-        UnmapFile();
-    }
+    UnmapFile();
     code_ = code;
     isKeepAlive_ = isKeepAlive;
     path_ = path;
     srcDir_ = srcDir;
     mmFile_ = nullptr;
     mmFileStat_ = {0};
+    rangeHeader_.clear();
+    ifRange_.clear();
+    ifNoneMatch_.clear();
+    ifModifiedSince_.clear();
+    acceptGzip_ = acceptDeflate_ = false;
+    encoding_.clear();
+    ranges_.clear();
+    bodyOffset_ = bodyLen_ = 0;
+}
+
+void HttpResponse::SetRange(std::string_view range, std::string_view ifRange) {
+    rangeHeader_.assign(range.data(), range.size());
+    ifRange_.assign(ifRange.data(), ifRange.size());
+}
+
+void HttpResponse::SetConditional(std::string_view ifNoneMatch, std::string_view ifModifiedSince) {
+    ifNoneMatch_.assign(ifNoneMatch.data(), ifNoneMatch.size());
+    ifModifiedSince_.assign(ifModifiedSince.data(), ifModifiedSince.size());
+}
+
+void HttpResponse::SetAcceptEncoding(bool gzip, bool deflate) {
+    acceptGzip_ = gzip;
+    acceptDeflate_ = deflate;
+}
+
+void HttpResponse::SetCacheControl(const std::string& type, const std::string& value) {
+    if(value.empty()) {
+        cacheControl.erase(type);
+    } else {
+        cacheControl[type] = value;
+    }
 }
 
 // 此处的path还是request传进来的值，即想要访问的页面
-void HttpResponse::MakeResponse(Buffer& buff) {
+void HttpResponse::MakeResponse(ChainBuffer& buff) {
+    // 先查缓存：命中则直接拷贝预先生成好的响应头，文件内容由File()指向缓存，不需要任何文件系统调用
+    if(code_ == 200 || code_ == -1) {
+        cached_ = FileCache::Instance()->Get(path_);
+        // 原文件的mtime已知，直接找压缩变体
+        if(cached_ && Negotiable_(cached_->size)) {
+            StatFromEntry_(*cached_);
+            SelectVariant_();
+        }
+        if(cached_) {
+            code_ = 200;
+            RespondCached_(buff);
+            return;
+        }
+    }
+    // 记下查缓存时的版本号，读文件期间文件若被修改则不放入缓存
+    uint64_t epoch = FileCache::Instance()->Epoch();
+
     // stat(需要查看数据的文件路径的指针， stat结构体的指针)，文件属性就记录在结构体(mmFileStat_)中，成功返回0，失败返回1
     // mmFileStat_.st_mode：文件对应的模式(文件类型、文件权限)
     // S_ISDIR(st_mode)：判断是不是目录
-    /*文件不存在或无法访问  或者  路径指向的是目录而非文件*/
-    if(stat((srcDir_ + path_).data(), &mmFileStat_ ) < 0 || S_ISDIR(mmFileStat_.st_mode)) {
-        code_ = 404;
+    /*已经是错误码(400/413等)时不再查看请求的文件，由ErrorHtml_()换成错误页面*/
+    if(code_ == 200 || code_ == -1) {
+        /*文件不存在或无法访问  或者  路径指向的是目录而非文件*/
+        if(stat((srcDir_ + path_).data(), &mmFileStat_ ) < 0 || S_ISDIR(mmFileStat_.st_mode)) {
+            code_ = 404;
+        }
+        // S_IROTH：其他人可读
+        // mmFileStat_.st_mode & S_IROTH = true ：判断所有者对该文件有可读权限
+        else if(!(mmFileStat_.st_mode & S_IROTH)) {     // 无可读权限
+            code_ = 403;
+        }
+        else {
+            code_ = 200;
+        }
+    }
+    // 原文件不在缓存里，但压缩变体可能在(例如只有支持gzip的客户端访问过)
+    if(code_ == 200 && Negotiable_(mmFileStat_.st_size) && SelectVariant_()) {
+        RespondCached_(buff);
+        return;
+    }
+    // 文件未变化：只需要stat的结果，不打开也不映射文件
+    if(code_ == 200 && NotModified_(ETag_(), mmFileStat_.st_mtime)) {
+        code_ = 304;
+        AddStateLine_(buff);
+        AddHeader_(buff);
+        buff.Append("\r\n");
+        return;
     }
-    // S_IROTH：其他人可读
-    // mmFileStat_.st_mode & S_IROTH = true ：判断所有者对该文件有可读权限
-    else if(!(mmFileStat_.st_mode & S_IROTH)) {     // 无可读权限
-        code_ = 403;
+    if(code_ == 200 && !rangeHeader_.empty()) {
+        ParseRange_();
     }
-    else if(code_ == -1) {
-        code_ = 200;
+    // 多段的数据要在响应头之前读好：读失败时还能改成500，而不是在206里发出错误的内容
+    if(code_ == 206 && ranges_.size() > 1 && UseSendfile_(mmFileStat_.st_size) && !ReadRanges_()) {
+        code_ = 500;
+        ranges_.clear();
     }
     ErrorHtml_();
     AddStateLine_(buff);
     AddHeader_(buff);
     AddContent_(buff);
+    // 刚修改过的文件可能还在写入，先不缓存
+    if(code_ == 200 && mmFile_ && FileCache::Instance()->IsOpen() &&
+       mmFileStat_.st_mtime < time(nullptr) - 1 &&
+       static_cast<size_t>(mmFileStat_.st_size) <= FileCache::Instance()->MaxFileSize()) {
+        CacheFile_(epoch);
+    }
+}
+
+// 缓存项记录的源文件版本，和stat的结果互相转换
+void HttpResponse::StatFromEntry_(const FileCache::Entry& entry) {
+    mmFileStat_.st_mtim.tv_sec = entry.mtime;
+    mmFileStat_.st_mtim.tv_nsec = entry.mtimeNsec;
+    mmFileStat_.st_size = entry.size;
+    mmFileStat_.st_ino = entry.ino;
+}
+
+void HttpResponse::EntryFromStat_(const struct stat& st, FileCache::Entry& entry) {
+    entry.mtime = st.st_mtim.tv_sec;
+    entry.mtimeNsec = st.st_mtim.tv_nsec;
+    entry.size = st.st_size;
+    entry.ino = st.st_ino;
+}
+
+// 命中缓存(原文件或压缩变体)：304和完整200都有预先生成好的响应头
+void HttpResponse::RespondCached_(ChainBuffer& buff) {
+    if(NotModified_(cached_->etag, cached_->mtime)) {
+        code_ = 304;
+        buff.Append(isKeepAlive_ ? cached_->notModifiedKeepAlive : cached_->notModifiedClose);
+        cached_.reset();    // 304没有响应体
+        return;
+    }
+    if(rangeHeader_.empty()) {
+        bodyLen_ = cached_->body.size();
+        // 响应头和内容一样按引用发送，cached_持有缓存项直到发送完
+        const std::string& header = isKeepAlive_ ? cached_->headerKeepAlive : cached_->headerClose;
+        buff.AppendRef(header.data(), header.size());
+        return;
+    }
+    // Range请求(只会是原文件，变体不参与Range)：内容用缓存的，响应头按区间重新生成
+    StatFromEntry_(*cached_);
+    ParseRange_();
+    AddStateLine_(buff);
+    AddHeader_(buff);
+    AddContent_(buff);
 }
 
 char* HttpResponse::File() {
-    return mmFile_;
+    if(cached_) {
+        // iov_base是void*，这里只是去掉const，发送时不会修改
+        return const_cast<char*>(cached_->body.data()) + bodyOffset_;
+    }
+    return mmFile_ ? mmFile_ + bodyOffset_ : nullptr;
 }
 
 size_t HttpResponse::FileLen() const {
-    return mmFileStat_.st_size;
+    return bodyLen_;
+}
+
+// 与MakeResponse生成的响应头完全一致，只是不依赖本次请求的keep-alive
+std::string HttpResponse::RenderHeader_(bool isKeepAlive, int code, size_t contentLen) {
+    bool savedKeepAlive = isKeepAlive_;
+    int savedCode = code_;
+    isKeepAlive_ = isKeepAlive;
+    code_ = code;
+    ChainBuffer buff;
+    AddStateLine_(buff);
+    AddHeader_(buff);
+    if(code != 304) {
+        buff.Append("Content-Length: " + std::to_string(contentLen) + "\r\n");
+    }
+    buff.Append("\r\n");
+    isKeepAlive_ = savedKeepAlive;
+    code_ = savedCode;
+    return buff.RetrieveAllToStr();
+}
+
+// 拷贝一份文件内容放入缓存，本次响应也改为使用缓存，映射可以立刻释放
+void HttpResponse::CacheFile_(uint64_t epoch) {
+    std::shared_ptr<FileCache::Entry> entry(new FileCache::Entry());
+    entry->body.assign(mmFile_, mmFileStat_.st_size);
+    entry->headerKeepAlive = RenderHeader_(true, 200, entry->body.size());
+    entry->headerClose = RenderHeader_(false, 200, entry->body.size());
+    entry->notModifiedKeepAlive = RenderHeader_(true, 304, 0);
+    entry->notModifiedClose = RenderHeader_(false, 304, 0);
+    entry->etag = ETag_();
+    EntryFromStat_(mmFileStat_, *entry);
+    FileCache::Instance()->Put(path_, entry, epoch);
+    UnmapFile();
+    cached_ = entry;
+}
+
+bool HttpResponse::IsCompressible_(const std::string& type) {
+    return type.compare(0, 5, "text/") == 0 || type == "application/xhtml+xml" ||
+           type == "application/rtf";
+}
+
+// 变体只放在缓存里，缓存放不下的文件、Range请求都直接发送原文件
+bool HttpResponse::Negotiable_(size_t size) {
+    return (acceptGzip_ || acceptDeflate_) && rangeHeader_.empty() &&
+           FileCache::Instance()->IsOpen() && size >= MIN_COMPRESS_SIZE &&
+           size <= FileCache::Instance()->MaxFileSize() && IsCompressible_(GetFileType_());
+}
+
+// mmFileStat_为原文件的stat结果
+bool HttpResponse::SelectVariant_() {
+    const char* encodings[2];
+    int n = 0;
+    if(acceptGzip_) {
+        encodings[n++] = "gzip";
+    }
+    if(acceptDeflate_) {
+        encodings[n++] = "deflate";
+    }
+    for(int i = 0; i < n; i++) {
+        FileCache::EntryPtr variant = FileCache::Instance()->Get(
+            FileCache::VariantKey(path_, mmFileStat_, encodings[i]));
+        if(variant) {
+            cached_ = variant;
+            return true;
+        }
+    }
+    // 没有现成的变体：压缩不在Reactor线程中做，交给线程池生成首选编码，本次先发送原文件
+    std::string key = FileCache::VariantKey(path_, mmFileStat_, encodings[0]);
+    uint64_t epoch = FileCache::Instance()->Epoch();
+    FileCache::Instance()->Submit(key, [srcDir = srcDir_, path = path_, st = mmFileStat_,
+                                        encoding = std::string(encodings[0]), key, epoch] {
+        FileCache::EntryPtr entry = BuildVariant_(srcDir, path, st, encoding);
+        if(entry) {
+            FileCache::Instance()->Put(key, entry, epoch);
+        }
+    });
+    return false;
+}
+
+// 读取整个文件，文件大小超过maxSize时失败
+static bool ReadWholeFile(const std::string& file, size_t maxSize, std::string& out) {
+    int fd = open(file.data(), O_RDONLY);
+    if(fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if(fstat(fd, &st) < 0 || static_cast<size_t>(st.st_size) > maxSize) {
+        close(fd);
+        return false;
+    }
+    out.resize(st.st_size);
+    size_t done = 0;
+    while(done < out.size()) {
+        ssize_t len = read(fd, &out[done], out.size() - done);
+        if(len <= 0) {
+            if(len < 0 && errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        done += len;
+    }
+    close(fd);
+    out.resize(done);
+    return done == static_cast<size_t>(st.st_size);
+}
+
+FileCache::EntryPtr HttpResponse::BuildVariant_(const std::string& srcDir, const std::string& path,
+                                                const struct stat& st, const std::string& encoding) {
+    // 刚修改过的文件可能还在写入
+    if(st.st_mtime >= time(nullptr) - 1) {
+        return nullptr;
+    }
+    std::string file = srcDir + path;
+    size_t maxSize = FileCache::Instance()->MaxFileSize();
+    std::string body;
+    std::string usedEncoding = encoding;
+    // 优先使用预先压缩好的.gz文件，但不能比源文件旧
+    struct stat gzStat;
+    if(encoding == "gzip" && stat((file + ".gz").data(), &gzStat) == 0 && S_ISREG(gzStat.st_mode) &&
+       gzStat.st_mtime >= st.st_mtime && ReadWholeFile(file + ".gz", maxSize, body)) {
+        LOG_DEBUG("use precompressed %s.gz", path.data());
+    } else {
+        std::string raw;
+        if(!ReadWholeFile(file, maxSize, raw) || !Compress_(raw, body, encoding == "gzip")) {
+            return nullptr;
+        }
+        // 压缩后没有变小，变体就是原内容，以后也不用再尝试压缩
+        if(body.size() >= raw.size()) {
+            body.swap(raw);
+            usedEncoding.clear();
+        }
+    }
+    // 读取期间源文件被修改
+    struct stat now;
+    if(stat(file.data(), &now) < 0 || now.st_mtim.tv_sec != st.st_mtim.tv_sec ||
+       now.st_mtim.tv_nsec != st.st_mtim.tv_nsec || now.st_size != st.st_size || now.st_ino != st.st_ino) {
+        return nullptr;
+    }
+
+    // 借用一个响应对象生成响应头
+    HttpResponse response;
+    response.path_ = path;
+    response.mmFileStat_ = st;
+    response.encoding_ = usedEncoding;
+    std::shared_ptr<FileCache::Entry> entry(new FileCache::Entry());
+    entry->body.swap(body);
+    entry->headerKeepAlive = response.RenderHeader_(true, 200, entry->body.size());
+    entry->headerClose = response.RenderHeader_(false, 200, entry->body.size());
+    entry->notModifiedKeepAlive = response.RenderHeader_(true, 304, 0);
+    entry->notModifiedClose = response.RenderHeader_(false, 304, 0);
+    entry->etag = response.ETag_();
+    EntryFromStat_(st, *entry);
+    return entry;
+}
+
+// gzip和deflate(zlib格式)只是deflate数据外面的包装不同，由windowBits区分
+bool HttpResponse::Compress_(const std::string& src, std::string& dst, bool gzip) {
+    z_stream zs = {};
+    if(deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, gzip ? 15 + 16 : 15,
+                    8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+    dst.resize(deflateBound(&zs, src.size()));
+    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(src.data()));
+    zs.avail_in = src.size();
+    zs.next_out = reinterpret_cast<Bytef*>(&dst[0]);
+    zs.avail_out = dst.size();
+    int ret = deflate(&zs, Z_FINISH);
+    dst.resize(zs.total_out);
+    deflateEnd(&zs);
+    if(ret != Z_STREAM_END) {
+        LOG_ERROR("deflate error: %d", ret);
+        return false;
+    }
+    return true;
 }
 
 /*如果错误码code_ = 200，那么path_不变，还是原来申请的文件地址*/
@@ -121,7 +442,7 @@ void HttpResponse::ErrorHtml_() {
 }
 
 // HTTP版本 + 状态码 + 状态文本
-void HttpResponse::AddStateLine_(Buffer& buff) {
+void HttpResponse::AddStateLine_(ChainBuffer& buff) {
     std::string status;
     if(CODE_STATUS.count(code_) == 1) {
         status = CODE_STATUS.find(code_)->second;
@@ -129,11 +450,11 @@ void HttpResponse::AddStateLine_(Buffer& buff) {
         code_ = 400;
         status = CODE_STATUS.find(code_)->second;
     }
-    buff.Append("HTTP/1.1" + std::to_string(code_) + " " + status + "\r\n");
+    buff.Append("HTTP/1.1 " + std::to_string(code_) + " " + status + "\r\n");
 }
 
 // Connection + Content-Type
-void HttpResponse::AddHeader_(Buffer& buff) {
+void HttpResponse::AddHeader_(ChainBuffer& buff) {
     buff.Append("Connection: ");
     if(isKeepAlive_) {
         buff.Append("keep-alive\r\n");
@@ -141,40 +462,385 @@ void HttpResponse::AddHeader_(Buffer& buff) {
     } else {
         buff.Append("close\r\n");
     }
+    size_t size = mmFileStat_.st_size;
+    // 验证器和缓存策略：304要带上与200相同的这几个头
+    if(code_ == 200 || code_ == 206 || code_ == 304) {
+        if(IsCompressible_(GetFileType_())) {
+            buff.Append("Vary: Accept-Encoding\r\n");
+        }
+        buff.Append("Last-Modified: " + HttpDate_(mmFileStat_.st_mtime) + "\r\n");
+        buff.Append("ETag: " + ETag_() + "\r\n");
+        auto it = cacheControl.find(GetFileType_());
+        if(it != cacheControl.end()) {
+            buff.Append("Cache-Control: " + it->second + "\r\n");
+        }
+    }
+    if(code_ == 304) {
+        return;
+    }
+    if(code_ == 200 && !encoding_.empty()) {
+        buff.Append("Content-Encoding: " + encoding_ + "\r\n");
+    }
+    if(code_ == 200 || code_ == 206) {
+        buff.Append("Accept-Ranges: bytes\r\n");
+    }
+    if(code_ == 416) {
+        buff.Append("Content-Range: bytes */" + std::to_string(size) + "\r\n");
+    }
+    if(code_ == 206 && ranges_.size() > 1) {
+        buff.Append("Content-Type: multipart/byteranges; boundary=" + std::string(BOUNDARY) + "\r\n");
+        return;
+    }
+    if(code_ == 206) {
+        buff.Append("Content-Range: bytes " + std::to_string(ranges_[0].begin) + "-" +
+                    std::to_string(ranges_[0].end - 1) + "/" + std::to_string(size) + "\r\n");
+    }
     buff.Append("Content-Type: " + GetFileType_() + "\r\n");
 }
 
 // 文件映射 + 结束响应体头部(Cotent-Length)
-void HttpResponse::AddContent_(Buffer& buff) {
-    // 以只读模式(O_RDONLY)打开文件，打开失败则返回负值
-    int srcFd = open((srcDir_ + path_).data(), O_RDONLY);
-    if(srcFd < 0) {
-        ErrorContent(buff, "File NotFound!");
+void HttpResponse::AddContent_(ChainBuffer& buff) {
+    if(code_ == 416) {      // 没有响应体
+        buff.Append("Content-Length: 0\r\n\r\n");
         return;
     }
+    // 多段的数据已经读进partData_时不需要再打开文件
+    if(!cached_ && partData_.empty()) {
+        // 以只读模式(O_RDONLY)打开文件，打开失败则返回负值
+        int srcFd = open((srcDir_ + path_).data(), O_RDONLY);
+        if(srcFd < 0) {
+            ErrorContent(buff, "File NotFound!");
+            return;
+        }
 
-    /* 将文件映射到内存提高文件的访问速度 
-        MAP_PRIVATE 建立一个写入时拷贝的私有映射*/
-    LOG_DEBUG("file path: %s", (srcDir_ + path_).data());
-    // mmRet：内存映射地址
-    int* mmRet = (int*)mmap(0, mmFileStat_.st_size, PROT_READ, MAP_PRIVATE, srcFd, 0);
-    if(*mmRet == -1) {      // 内存映射失败
-        ErrorContent(buff, "File NotFound!");
-        return;
+        /* 将文件映射到内存提高文件的访问速度 
+            MAP_PRIVATE 建立一个写入时拷贝的私有映射*/
+        LOG_DEBUG("file path: %s", (srcDir_ + path_).data());
+
+        /* 大文件不映射，保留文件描述符，由HttpConn::write用sendfile直接从页缓存发往socket
+            既省去了拷贝到用户态，也不会每个连接都挂着一大块映射；能进缓存的文件仍然走mmap*/
+        if(UseSendfile_(mmFileStat_.st_size)) {
+            fileFd_ = srcFd;
+        } else {
+            // mmRet：内存映射地址
+            int* mmRet = (int*)mmap(0, mmFileStat_.st_size, PROT_READ, MAP_PRIVATE, srcFd, 0);
+            if(mmRet == MAP_FAILED) {      // 内存映射失败
+                close(srcFd);
+                ErrorContent(buff, "File NotFound!");
+                return;
+            }
+            mmFile_ = (char*) mmRet;
+            close(srcFd);
+        }
     }
-    mmFile_ = (char*) mmRet;
-    close(srcFd);
 
-    buff.Append("Content-Length: " + std::to_string(mmFileStat_.st_size) + "\r\n");
+    if(code_ == 206 && ranges_.size() > 1) {
+        AddMultipart_(buff);
+        return;
+    }
+    // 单段Range只发送[begin, end)，否则发送整个文件
+    if(code_ == 206) {
+        bodyOffset_ = ranges_[0].begin;
+        bodyLen_ = ranges_[0].end - ranges_[0].begin;
+    } else {
+        bodyOffset_ = 0;
+        bodyLen_ = mmFileStat_.st_size;
+    }
+    buff.Append("Content-Length: " + std::to_string(bodyLen_) + "\r\n");
     buff.Append("\r\n");   // 结束头部
 }
 
+bool HttpResponse::UseSendfile_(size_t size) const {
+    bool cacheable = FileCache::Instance()->IsOpen() && size <= FileCache::Instance()->MaxFileSize();
+    return sendfileThreshold > 0 && size >= sendfileThreshold && !cacheable;
+}
+
+/*
+Range: bytes=0-499,1000-,-200
+- a-b：第a到第b个字节(闭区间)   a-：从a到文件末尾   -n：最后n个字节
+- 语法错误、单位不是bytes、区间过多时忽略Range，发送整个文件(200)
+- 语法正确但没有一个区间落在文件内时返回416
+*/
+static bool ParseNum(std::string_view s, size_t* num) {
+    if(s.empty() || s.size() > 18) {    // 18位十进制数不会溢出size_t
+        return false;
+    }
+    *num = 0;
+    for(char ch : s) {
+        if(ch < '0' || ch > '9') {
+            return false;
+        }
+        *num = *num * 10 + (ch - '0');
+    }
+    return true;
+}
+
+static std::string_view Trim(std::string_view s) {
+    while(!s.empty() && (s.front() == ' ' || s.front() == '\t')) s.remove_prefix(1);
+    while(!s.empty() && (s.back() == ' ' || s.back() == '\t')) s.remove_suffix(1);
+    return s;
+}
+
+void HttpResponse::ParseRange_() {
+    ranges_.clear();
+    if(!ifRange_.empty() && !IfRangeMatch_()) {
+        return;     // 文件已经变了，客户端手里的片段没用了，发送整个文件
+    }
+    std::string_view spec = Trim(rangeHeader_);
+    if(spec.substr(0, 6) != "bytes=") {
+        return;
+    }
+    spec.remove_prefix(6);
+    size_t size = mmFileStat_.st_size;
+    bool valid = false;     // 是否有语法正确的区间
+    while(!spec.empty()) {
+        size_t comma = spec.find(',');
+        std::string_view item = Trim(spec.substr(0, comma));
+        spec = comma == std::string_view::npos ? std::string_view() : spec.substr(comma + 1);
+        if(item.empty()) {
+            continue;
+        }
+        size_t dash = item.find('-');
+        if(dash == std::string_view::npos) {
+            ranges_.clear();
+            return;
+        }
+        std::string_view first = item.substr(0, dash), last = item.substr(dash + 1);
+        size_t begin, end, n;
+        if(first.empty()) {             // -n
+            if(!ParseNum(last, &n)) {
+                ranges_.clear();
+                return;
+            }
+            valid = true;
+            if(n == 0 || size == 0) {
+                continue;
+            }
+            begin = n >= size ? 0 : size - n;
+            end = size;
+        } else {                        // a-b 或 a-
+            if(!ParseNum(first, &begin)) {
+                ranges_.clear();
+                return;
+            }
+            end = size;
+            if(!last.empty()) {
+                if(!ParseNum(last, &n) || n < begin) {
+                    ranges_.clear();
+                    return;
+                }
+                end = std::min(n + 1, size);
+            }
+            valid = true;
+            if(begin >= size) {
+                continue;
+            }
+        }
+        ranges_.push_back({begin, end});
+        if(ranges_.size() > MAX_RANGES) {
+            ranges_.clear();
+            return;
+        }
+    }
+    if(ranges_.empty()) {
+        if(valid) {
+            code_ = 416;
+        }
+        return;
+    }
+    if(ranges_.size() > 1) {
+        size_t total = 0;
+        for(const Range& r : ranges_) {
+            total += r.end - r.begin;
+        }
+        if(total > MAX_MULTIPART_SIZE) {
+            ranges_.clear();
+            return;
+        }
+    }
+    code_ = 206;
+}
+
+// If-Range可以是ETag或者HTTP-date；这里只生成了Last-Modified，日期需要完全一致才算没变
+bool HttpResponse::IfRangeMatch_() const {
+    // If-Range要求强比较：弱ETag永远不匹配
+    if(ifRange_.compare(0, 2, "W/") == 0) {
+        return false;
+    }
+    if(ifRange_[0] == '"') {
+        std::string etag = ETag_();
+        return etag[0] == '"' && ifRange_ == etag;
+    }
+    return ifRange_ == HttpDate_(mmFileStat_.st_mtime);
+}
+
+/* ETag：Nginx的格式，"mtime-size"(十六进制)，压缩变体后面再加上编码
+同一秒内文件可能被再次修改而mtime不变，因此一秒内刚修改过的文件只给弱ETag
+*/
+std::string HttpResponse::ETag_() const {
+    char buf[64];
+    bool weak = mmFileStat_.st_mtime >= time(nullptr) - 1;
+    int n = snprintf(buf, sizeof(buf), "%s\"%lx-%lx%s%s\"", weak ? "W/" : "",
+                     static_cast<unsigned long>(mmFileStat_.st_mtime),
+                     static_cast<unsigned long>(mmFileStat_.st_size),
+                     encoding_.empty() ? "" : "-", encoding_.c_str());
+    return std::string(buf, n);
+}
+
+bool HttpResponse::NotModified_(const std::string& etag, time_t mtime) const {
+    // 有If-None-Match时忽略If-Modified-Since(RFC 7232 3.3)
+    if(!ifNoneMatch_.empty()) {
+        return ETagListMatch_(ifNoneMatch_, etag);
+    }
+    time_t since;
+    if(!ifModifiedSince_.empty() && ParseHttpDate_(ifModifiedSince_, &since)) {
+        return mtime <= since;
+    }
+    return false;
+}
+
+// If-None-Match: "*" 或者逗号分隔的ETag列表，用弱比较(忽略W/前缀)
+bool HttpResponse::ETagListMatch_(const std::string& list, const std::string& etag) {
+    std::string_view target(etag);
+    if(target.compare(0, 2, "W/") == 0) {
+        target.remove_prefix(2);
+    }
+    size_t pos = 0;
+    while(pos < list.size()) {
+        size_t comma = list.find(',', pos);
+        if(comma == std::string::npos) {
+            comma = list.size();
+        }
+        std::string_view tag(list.data() + pos, comma - pos);
+        while(!tag.empty() && (tag.front() == ' ' || tag.front() == '\t')) {
+            tag.remove_prefix(1);
+        }
+        while(!tag.empty() && (tag.back() == ' ' || tag.back() == '\t')) {
+            tag.remove_suffix(1);
+        }
+        if(tag == "*") {
+            return true;
+        }
+        if(tag.compare(0, 2, "W/") == 0) {
+            tag.remove_prefix(2);
+        }
+        if(tag == target) {
+            return true;
+        }
+        pos = comma + 1;
+    }
+    return false;
+}
+
+// 只接受RFC 7231推荐的IMF-fixdate格式，其他格式视为无效(忽略该请求头)
+bool HttpResponse::ParseHttpDate_(const std::string& str, time_t* t) {
+    struct tm tm{};
+    const char* end = strptime(str.c_str(), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+    if(end == nullptr || *end != '\0') {
+        return false;
+    }
+    *t = timegm(&tm);
+    return *t != -1;
+}
+
+std::string HttpResponse::HttpDate_(time_t t) {
+    struct tm tm;
+    char buf[64];
+    gmtime_r(&t, &tm);
+    size_t n = strftime(buf, sizeof(buf), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+    return std::string(buf, n);
+}
+
+/*
+多段Range的响应体：
+\r\n--BOUNDARY\r\n
+Content-Type: text/html\r\n
+Content-Range: bytes 0-99/1000\r\n
+\r\n
+<第一段数据>
+\r\n--BOUNDARY\r\n
+...
+\r\n--BOUNDARY--\r\n
+分隔行拷贝到写缓冲区，各段数据按引用追加(指向缓存、内存映射或partData_)，不拷贝
+*/
+void HttpResponse::AddMultipart_(ChainBuffer& buff) {
+    std::string type = GetFileType_();
+    std::string size = std::to_string(mmFileStat_.st_size);
+    std::vector<std::string> heads;
+    size_t total = 0;
+    for(const Range& r : ranges_) {
+        heads.push_back("\r\n--" + std::string(BOUNDARY) + "\r\nContent-Type: " + type +
+                        "\r\nContent-Range: bytes " + std::to_string(r.begin) + "-" +
+                        std::to_string(r.end - 1) + "/" + size + "\r\n\r\n");
+        total += heads.back().size() + (r.end - r.begin);
+    }
+    std::string tail = "\r\n--" + std::string(BOUNDARY) + "--\r\n";
+    total += tail.size();
+
+    buff.Append("Content-Length: " + std::to_string(total) + "\r\n\r\n");
+    const char* data = cached_ ? cached_->body.data() : mmFile_;
+    size_t partOff = 0;
+    for(size_t i = 0; i < ranges_.size(); i++) {
+        const Range& r = ranges_[i];
+        size_t len = r.end - r.begin;
+        buff.Append(heads[i]);
+        if(data) {
+            buff.AppendRef(data + r.begin, len);
+        } else {
+            buff.AppendRef(partData_.data() + partOff, len);
+            partOff += len;
+        }
+    }
+    buff.Append(tail);
+    bodyOffset_ = bodyLen_ = 0;     // 响应体都在buff里了
+}
+
+// sendfile的大文件没有映射，多段的数据只能用pread读出来(总大小由MAX_MULTIPART_SIZE限制)
+bool HttpResponse::ReadRanges_() {
+    int fd = open((srcDir_ + path_).data(), O_RDONLY);
+    if(fd < 0) {
+        LOG_ERROR("open %s error: %d", path_.c_str(), errno);
+        return false;
+    }
+    size_t total = 0;
+    for(const Range& r : ranges_) {
+        total += r.end - r.begin;
+    }
+    partData_.resize(total);
+    size_t partOff = 0;
+    for(const Range& r : ranges_) {
+        size_t done = 0;
+        while(done < r.end - r.begin) {
+            ssize_t n = pread(fd, &partData_[partOff + done], r.end - r.begin - done, r.begin + done);
+            if(n < 0 && errno == EINTR) {
+                continue;
+            }
+            if(n <= 0) {        // 出错，或者文件在stat之后被截断
+                LOG_ERROR("pread %s error: %d", path_.c_str(), n < 0 ? errno : 0);
+                close(fd);
+                std::string().swap(partData_);
+                return false;
+            }
+            done += n;
+        }
+        partOff += done;
+    }
+    close(fd);
+    return true;
+}
+
 // 安全释放内存映射资源
 void HttpResponse::UnmapFile() {
     if(mmFile_) {
         munmap(mmFile_, mmFileStat_.st_size);     // 地址，长度
     }
     mmFile_ = nullptr;
+    cached_.reset();
+    std::string().swap(partData_);
+    if(fileFd_ >= 0) {
+        close(fileFd_);
+        fileFd_ = -1;
+    }
 }
 
 std::string HttpResponse::GetFileType_() {
@@ -190,7 +856,7 @@ std::string HttpResponse::GetFileType_() {
     return "text/plain";    // 未知扩展名的默认处理
 }
 
-void HttpResponse::ErrorContent(Buffer& buff, std::string message) {
+void HttpResponse::ErrorContent(ChainBuffer& buff, std::string message) {
     std::string body;
     std::string status;
     body += "<html><title>Error</title>";
@@ -2,14 +2,18 @@
 #define HTTP_RESPONSE_H
 
 #include <cassert>
+#include <ctime>        // strptime/timegm
+#include <vector>
+#include <string_view>
 #include <unordered_map>
 #include <fcntl.h>      // 文件控制
 #include <unistd.h>     // 系统调用
 #include <sys/stat.h>   // 获取文件状态信息
 #include <sys/mman.h>   // 内存映射文件
 
-#include "../buffer/buffer.h"
+#include "../buffer/chainbuffer.h"
 #include "../log/log.h"
+#include "filecache.h"
 
 class HttpResponse {
 public:
@@ -17,24 +21,72 @@ public:
     ~HttpResponse();
 
     void Init(const std::string& srcDir, std::string& path, bool isKeepAlive = false, int code = -1);
-    void MakeResponse(Buffer& buff);    // 生成完整HTTP响应
-    void UnmapFile();       // 释放内存映射文件
+    // Range/If-Range请求头，需在Init之后、MakeResponse之前设置；为空表示请求整个文件
+    void SetRange(std::string_view range, std::string_view ifRange);
+    // If-None-Match/If-Modified-Since请求头，同样在MakeResponse之前设置；文件未变化时响应304
+    void SetConditional(std::string_view ifNoneMatch, std::string_view ifModifiedSince);
+    // 客户端可接受的内容编码(Accept-Encoding)，同时支持时优先gzip
+    void SetAcceptEncoding(bool gzip, bool deflate);
+    void MakeResponse(ChainBuffer& buff);   // 生成完整HTTP响应
+    void UnmapFile();       // 释放内存映射文件(以及对缓存的引用、sendfile用的文件描述符)
+    // 需要发送的文件内容：缓存命中时指向缓存，否则指向内存映射；206时只是其中请求的那一段
     char* File();
     size_t FileLen() const;
+    // 大文件走sendfile时返回打开的文件描述符(此时File()为nullptr)，否则返回-1
+    int FileFd() const {
+        return fileFd_;
+    }
+    // 需要发送的内容在文件中的起始偏移(sendfile用)
+    size_t FileOffset() const {
+        return bodyOffset_;
+    }
     // 生成错误页面提示
-    void ErrorContent(Buffer& buff, std::string message);
+    void ErrorContent(ChainBuffer& buff, std::string message);
     int Code() const {
         return code_;
     }
 
+    // 不小于该大小且不进缓存的文件用sendfile发送，0表示关闭
+    static size_t sendfileThreshold;
+    // 按MIME类型配置Cache-Control，value为空表示不发送；非线程安全，需在服务器启动前调用
+    static void SetCacheControl(const std::string& type, const std::string& value);
+
 private:
-    void AddStateLine_(Buffer& buff);   // 状态行
-    void AddHeader_(Buffer& buff);      // 响应头部
-    void AddContent_(Buffer& buff);     // 响应内容
+    void AddStateLine_(ChainBuffer& buff);  // 状态行
+    void AddHeader_(ChainBuffer& buff);     // 响应头部
+    void AddContent_(ChainBuffer& buff);    // 响应内容
 
     void ErrorHtml_();                  // 自动选择错误页面
     std::string GetFileType_();         // 获取MIME类型
 
+    std::string RenderHeader_(bool isKeepAlive, int code, size_t contentLen);   // 生成完整响应头，用于放入缓存
+    void CacheFile_(uint64_t epoch);                // 把刚映射的文件放入缓存
+    void RespondCached_(ChainBuffer& buff);         // 用cached_生成响应
+    void StatFromEntry_(const FileCache::Entry& entry);     // 源文件的版本信息填进mmFileStat_
+    static void EntryFromStat_(const struct stat& st, FileCache::Entry& entry);
+
+    // 内容编码：只对缓存范围内的文本文件协商，压缩结果作为变体放入缓存
+    bool Negotiable_(size_t size);
+    bool SelectVariant_();              // 命中变体时cached_改为指向它；否则提交后台压缩任务
+    static bool IsCompressible_(const std::string& type);
+    // 在线程池中执行：读取.gz文件或压缩源文件，生成变体缓存项；st为源文件的stat
+    static FileCache::EntryPtr BuildVariant_(const std::string& srcDir, const std::string& path,
+                                             const struct stat& st, const std::string& encoding);
+    static bool Compress_(const std::string& src, std::string& dst, bool gzip);
+
+    void ParseRange_();                 // 解析Range，决定200/206/416
+    bool IfRangeMatch_() const;         // If-Range与当前文件是否一致
+    void AddMultipart_(ChainBuffer& buff);  // 多段Range：multipart/byteranges响应体
+    bool UseSendfile_(size_t size) const;   // 文件不映射，由sendfile发送
+    bool ReadRanges_();                 // 不映射的文件：多段Range的数据先读进partData_
+    static std::string HttpDate_(time_t t);     // RFC 7231 HTTP-date(GMT)
+    static bool ParseHttpDate_(const std::string& str, time_t* t);
+
+    std::string ETag_() const;          // 由mtime和大小生成，刚修改过的文件为弱ETag
+    // 条件请求：If-None-Match优先，其次If-Modified-Since；返回true表示应响应304
+    bool NotModified_(const std::string& etag, time_t mtime) const;
+    static bool ETagListMatch_(const std::string& list, const std::string& etag);
+
     int code_;
     bool isKeepAlive_;
 
@@ -43,11 +95,43 @@ private:
 
     // 内存映射
     char* mmFile_;
+    int fileFd_;        // sendfile的源文件
     struct stat mmFileStat_;
 
+    // 缓存命中时持有该缓存项，保证发送期间内容不被释放
+    FileCache::EntryPtr cached_;
+
+    // Range请求，区间为[begin, end)
+    struct Range {
+        size_t begin;
+        size_t end;
+    };
+    std::string rangeHeader_;
+    std::string ifRange_;
+    std::vector<Range> ranges_;     // 需要发送的区间，为空表示整个文件
+    size_t bodyOffset_;             // 单段时为区间起点，否则为0
+    size_t bodyLen_;                // 通过File()/sendfile发送的字节数
+    std::string partData_;          // 多段Range从不映射的文件中读出的数据，各段依次相连
+
+    // 条件请求
+    std::string ifNoneMatch_;
+    std::string ifModifiedSince_;
+
+    // 内容编码
+    bool acceptGzip_;
+    bool acceptDeflate_;
+    std::string encoding_;          // 响应体的Content-Encoding，为空表示未编码
+
+    static const size_t MIN_COMPRESS_SIZE = 256;    // 太小的文件压缩收益不大
+
+    static const size_t MAX_RANGES = 16;                    // 区间过多视为滥用，忽略Range
+    static const size_t MAX_MULTIPART_SIZE = 4 * 1024 * 1024;   // 多段响应体需要拷贝到缓冲区，限制大小
+    static const char BOUNDARY[];
+
     static const std::unordered_map<std::string, std::string> SUFFIX_TYPE;
     static const std::unordered_map<int, std::string> CODE_STATUS;
     static const std::unordered_map<int, std::string> CODE_PATH;
+    static std::unordered_map<std::string, std::string> cacheControl;   // MIME类型到Cache-Control的映射
 };
 
 #endif
\ No newline at end of file
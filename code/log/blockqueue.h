@@ -46,7 +46,7 @@ public:
 };
 
 template<class T>
-BlockDeque<T>::BlockDeque(size_t MaxCapacity) : capacity(MaxCapacity) {
+BlockDeque<T>::BlockDeque(size_t MaxCapacity) : capacity_(MaxCapacity) {
     assert(MaxCapacity > 0);
     isClose_ = false;      // 标记打开队列
 }
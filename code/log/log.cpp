@@ -1,171 +1,328 @@
 #include "log.h"
 
+#include <zlib.h>
+#include <stdlib.h>     // posix_memalign
+
 /*写线程writeThread_不属于线程池，其生命周期和日志实例绑定了*/
 
-Log::Log() : lineCount_(0), toDay_(0), isAsync_(nullptr), deque_(nullptr), writeThread_(nullptr), fp_(nullptr) {}
+std::atomic<int> Log::levels_[Log::MODULE_COUNT] = {
+    {LEVEL_OFF}, {LEVEL_OFF}, {LEVEL_OFF}, {LEVEL_OFF}, {LEVEL_OFF}, {LEVEL_OFF}
+};
+
+size_t Log::maxFileSize = 64 * 1024 * 1024;
+bool Log::compressRotated = true;
+int Log::writerCpu = -1;
+
+Log::Log() : fileSize_(0), nextDay_(0), isOpen_(false), level_(1), isAsync_(false), deferred_(false), blockOnFull_(false),
+    dropped_(0), fd_(-1), buff_(nullptr), buffLen_(0), ring_(nullptr), writeThread_(nullptr), isClose_(false) {}
 
 Log::~Log() {
-    // 由于unique_ptr，deque_和writeThread都是指针，因此用->
-    // 处理写线程
+    // 由于unique_ptr，ring_和writeThread都是指针，因此用->
+    // 处理写线程：标记关闭后唤醒，写线程把队列和缓冲区中剩余的日志写完再退出
     // joinable():检查一个线程对象是否可以被join()或detach()
     if(writeThread_ && writeThread_->joinable()) {
-        while(!deque_->empty()) {
-            deque_->flush();  // 唤醒后台刷盘线程 writeThread_
-        }
-        deque_->Close();
+        isClose_ = true;
+        ring_->Notify();
         writeThread_->join(); // 主线程Log阻塞，等待写进程结束，再析构
     }
+    if(compressThread_.joinable()) {
+        compressThread_.join();
+    }
     // 处理文件资源
-    if(fp_) {
-        std::lock_guard<std::mutex> locker(mtx_);
-        flush();        // 强制写入FILE*缓冲区数据
-        fclose(fp_);    // 关闭文件
+    std::lock_guard<std::mutex> locker(mtx_);
+    if(fd_ >= 0) {
+        close(fd_);
     }
+    free(buff_);
 }
 
 /*
 - 初始化队列和线程(需要判断是否已经有了，防止多次创建)
-- 创建文件：日期、名称
-- 清空缓冲区，关闭旧文件，打开新文件
-*/ 
-void Log::init(int level = 1, const char* path, const char* suffix, int maxQueueSize) {
+- 关闭旧文件，打开当天的日志文件
+*/
+void Log::init(int level = 1, const char* path, const char* suffix, int maxQueueSize, bool blockOnFull, bool deferred) {
     isOpen_ = true;
-    level_ = level;
+    blockOnFull_ = blockOnFull;
+    path_ = path;    // 存储日志目录（./logs）
+    suffix_ = suffix; // 存储文件后缀（.log）
+
+    {
+        std::lock_guard<std::mutex> locker(mtx_);
+        if(fd_ >= 0) {
+            close(fd_);
+            fd_ = -1;
+        }
+        bool ok = OpenFile_(time(nullptr));
+        assert(ok);
+        (void)ok;
+    }
+
+    // 文件打开之后才开放各模块的日志
+    SetLevel(level);
+
     if(maxQueueSize > 0) {    // 异步模式
+        // 只有当ring_为空时才继续操作，这样是为了防止重复初始化队列和线程
+        if(!ring_) {
+            ring_.reset(new LogRing(maxQueueSize));
+            // 按页对齐，write()从对齐的地址整块拷贝
+            void* buff = nullptr;
+            int ret = posix_memalign(&buff, 4096, BUFF_SIZE);
+            assert(ret == 0);
+            (void)ret;
+            buff_ = static_cast<char*>(buff);
+            // 动态创建一个线程，并指定其入口函数为 FlushLogThread(入口函数：线程启动后执行的第一个函数)
+            writeThread_.reset(new std::thread(FlushLogThread));
+        }
         isAsync_ = true;
-        // 只有当deque_为空时才继续操作，这样是为了防止重复初始化队列和线程
-        if(!deque_) {   
-            std::unique_ptr<BlockDeque<std::string>> newDeque(new BlockDeque<std::string>(maxQueueSize));
-            deque_ = std::move(newDeque);  // newDeque是unique_ptr指针，不能复制，只能移动
+        deferred_ = deferred;
+    }
+    else {
+        isAsync_ = false;
+        deferred_ = false;
+    }
+}
 
-            // 动态创建一个线程，并指定其入口函数为 FlushLogThread(入口函数：线程启动后执行的第一个函数)
-            std::unique_ptr<std::thread> NewThread(new std::thread(FlushLogThread));
-            writeThread_ = std::move(NewThread);
+void Log::write(int level, const char* format, ...) {
+    va_list valist;   // 可变参数列表
+    va_start(valist, format);   // 初始化可变参数列表
 
-            // 直接构造
-            // writeThread_ = std::unique_ptr<std::thread>(new std::thread(FlushLogThread))
-        } 
-    } 
-    else {
-            isAsync_ = false;
+    if(isAsync_) {
+        // 直接格式化进环形队列的槽里：不加锁、不分配内存
+        LogRing::Record* rec = AcquireRecord_();
+        if(rec) {
+            rec->len = FormatLine_(rec->data, LogRing::RECORD_SIZE, level, format, valist);
+            rec->binary = false;
+            ring_->Commit(rec, level >= 2);
+        }
+    } else {
+        // 同步模式：没有写线程，轮转只能在调用者线程中完成；格式化在锁外完成
+        char line[LogRing::RECORD_SIZE];
+        size_t len = FormatLine_(line, sizeof(line), level, format, valist);
+        std::lock_guard<std::mutex> locker(mtx_);
+        RotateIfNeeded_(time(nullptr), len);
+        WriteAll_(line, len);
     }
+    va_end(valist);   // 清理可变参数列表
+}
 
-    lineCount_ = 0;
+LogRing::Record* Log::AcquireRecord_() {
+    LogRing::Record* rec = ring_->Acquire();
+    while(!rec && blockOnFull_ && !isClose_) {
+        ring_->Notify();
+        std::this_thread::yield();
+        rec = ring_->Acquire();
+    }
+    if(!rec) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+    }
+    return rec;
+}
 
-    // 生成日志文件
-    time_t timer = time(nullptr);         // 获取当前时间戳(秒级)
-    struct tm* sysTime = localtime(&timer);  // 转换为本地时间结构体
-    struct tm t = *sysTime;               // 拷贝一份（避免后续被修改）
+// 时间戳每秒才重新格式化一次(每个线程各缓存一份)
+size_t Log::FormatTime_(char* buf, time_t sec) {
+    static thread_local time_t lastSec = 0;
+    static thread_local char timeStr[32];
+    static thread_local int timeLen = 0;
 
-    path_ = path;    // 存储日志目录（./logs）
-    suffix_ = suffix; // 存储文件后缀（.log）
+    if(sec != lastSec) {
+        struct tm t;
+        localtime_r(&sec, &t);
+        timeLen = snprintf(timeStr, sizeof(timeStr), "%04d-%02d-%02d %02d:%02d:%02d ",
+                           t.tm_year + 1900, t.tm_mon + 1, t.tm_mday,
+                           t.tm_hour, t.tm_min, t.tm_sec);
+        lastSec = sec;
+    }
+    memcpy(buf, timeStr, timeLen);
+    return timeLen;
+}
 
-    // 生成日志文件名，格式：目录/年_月_日.后缀（如 "./logs/2023_10_05.log"）
+// 写日志 —— 时间戳-日志级别-用户消息，超长的消息截断，保证以换行结尾
+size_t Log::FormatLine_(char* buf, size_t size, int level, const char* format, va_list valist) {
+    size_t n = FormatTime_(buf, time(nullptr));
+    n += AppendLogLevelTitle_(buf + n, level);
+
+    // 留一个字节给换行符
+    int m = vsnprintf(buf + n, size - n, format, valist);
+    if(m > 0) {
+        n += std::min(static_cast<size_t>(m), size - n - 1);
+    }
+    buf[n++] = '\n';
+    return n;
+}
+
+// 生成日志文件名，格式：目录/年_月_日.后缀（如 "./logs/2023_10_05.log"），以追加模式打开
+bool Log::OpenFile_(time_t now) {
+    struct tm t;
+    localtime_r(&now, &t);              // 转换为本地时间结构体(线程安全版本)
     char fileName[LOG_NAME_LEN] = {0};
-    snprintf(fileName, LOG_NAME_LEN - 1, "%s/%04d_%02d_%02d%s", 
+    snprintf(fileName, LOG_NAME_LEN - 1, "%s/%04d_%02d_%02d%s",
         path_, t.tm_year + 1900, t.tm_mon + 1, t.tm_mday, suffix_);
 
-    toDay_ = t.tm_mday;  // 记录当前日期（用于后续判断是否跨天）
-
-    {
-        // 缓冲区清空并关闭旧文件
-        std::lock_guard<std::mutex> locker(mtx_);
-        buff_.RetrieveAll();
-        if(fp_) {
-            flush();
-            fclose(fp_);
-        }
-        fp_ = fopen(fileName, "a"); // 以追加模式打开
-        if(fp_ == nullptr) {
-            mkdir(path_, 0777);
-            fp_ = fopen(fileName, "a");
-        }
-        assert(fp_ != nullptr);
+    // O_APPEND：每次write()都追加到文件末尾，多个进程同时写也不会互相覆盖
+    fd_ = open(fileName, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if(fd_ < 0) {
+        mkdir(path_, 0777);
+        fd_ = open(fileName, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
     }
-}
+    if(fd_ < 0) {
+        return false;
+    }
+    struct stat st;
+    fileSize_ = fstat(fd_, &st) == 0 ? st.st_size : 0;
+    fileName_ = fileName;
 
-void Log::write(int level, const char* format, ...) {
-    time_t tSec = time(nullptr);
-    struct tm *sysTime = localtime(&tSec);
-    struct tm t = *sysTime;
-    va_list valist;   // 可变参数列表
+    // 记录下一个0点，之后每批日志只比较一次时间戳，不再调用localtime
+    t.tm_hour = t.tm_min = t.tm_sec = 0;
+    t.tm_mday++;
+    t.tm_isdst = -1;
+    nextDay_ = mktime(&t);
+    return true;
+}
 
-    // 日志
-    {
-        // 处理日志名
-        if(toDay_ != t.tm_mday || (lineCount_ && (lineCount_ % MAX_LINES) == 0)) {
-            std::unique_lock<std::mutex> locker(mtx_);
-            locker.unlock();   // 日志名操作没涉及到共享资源(fp_等，故解锁)
-            
-            char newFile[LOG_NAME_LEN];
-            char tail[36];   // 日期格式化缓冲区
-            // 将格式化字符串写入tail缓冲区，并返回长度
-            snprintf(tail, 36, "%04d_%02d_%02d", t.tm_year + 1900, t.tm_mon + 1, t.tm_mday);
-
-            if(toDay_ != t.tm_mday) {   // 日期变了
-                snprintf(newFile, LOG_NAME_LEN - 72, "%s/%s%s", path_, tail, suffix_);
-                toDay_ = t.tm_mday;
-                lineCount_ = 0;
-            } else {    // 一个文件写满了
-                snprintf(newFile, LOG_NAME_LEN - 72, "%s/%s-%d%s", path_, tail, (lineCount_ / MAX_LINES), suffix_);
+/*
+换文件：
+1、跨天：旧文件保持原名
+2、当天的文件写满：旧文件改名为 年_月_日-N.后缀，N取第一个没用过的编号
+之后打开新文件，旧文件交给后台线程压缩，写线程不等待压缩完成
+*/
+void Log::RotateIfNeeded_(time_t now, size_t incoming) {
+    bool newDay = now >= nextDay_;
+    bool full = maxFileSize > 0 && fileSize_ > 0 && fileSize_ + incoming > maxFileSize;
+    if(!newDay && !full) {
+        return;
+    }
+    if(fd_ >= 0) {
+        close(fd_);
+        fd_ = -1;
+    }
+    std::string rotated = fileName_;
+    if(!newDay) {
+        std::string base = fileName_.substr(0, fileName_.size() - strlen(suffix_));
+        for(int i = 1; ; i++) {
+            std::string name = base + "-" + std::to_string(i) + suffix_;
+            if(access(name.c_str(), F_OK) != 0 && access((name + ".gz").c_str(), F_OK) != 0) {
+                rotated = name;
+                break;
             }
+        }
+        rename(fileName_.c_str(), rotated.c_str());
+    }
+    OpenFile_(now);
 
-            // 关旧日志，开新日志
-            locker.lock();  // 操作fp_，需要上锁
-            flush();
-            fclose(fp_);
-            fopen(newFile, "a");
-            assert(fp_ != nullptr);
+    if(compressRotated) {
+        // 上一个文件一般早已压缩完；压缩比写日志还慢时在这里等待，避免压缩线程越积越多
+        if(compressThread_.joinable()) {
+            compressThread_.join();
         }
+        compressThread_ = std::thread(CompressFile_, rotated);
     }
+}
 
-        // 写日志 —— 时间戳-日志级别-用户消息
-    {
-        std::unique_lock<std::mutex> locker(mtx_);
-        lineCount_++;
-        int n = snprintf(buff_.BeginWrite(), 128, "%04d-%02d-%2d %02d:%02d:%02d",
-                            t.tm_year + 1900, t.tm_mon + 1, t.tm_mday,
-                            t.tm_hour, t.tm_min, t.tm_sec);
-        // 时间戳
-        buff_.HasWritten(n);
-
-        // 日志级别
-        AppendLogLevelTitle_(level);
-
-        // 用户消息
-        va_start(valist, format);   // 初始化可变参数列表
-        int m = vsnprintf(buff_.BeginWrite(), buff_.WritableBytes(), format, valist);
-        va_end(valist);   // 清理可变参数列表
-        buff_.HasWritten(m);
-        buff_.Append("\n\0", 2);
-
-
-        // 将上述写入内存的日志推送到队列或文件中
-        if(isAsync_ && deque_ && !deque_->full()) {  // 异步
-            deque_->push_back(buff_.RetrieveAllToStr());
-        } else {                                     // 同步
-            fputs(buff_.Peek(), fp_);
+void Log::WriteAll_(const char* data, size_t len) {
+    if(fd_ < 0) {
+        return;
+    }
+    fileSize_ += len;
+    while(len > 0) {
+        ssize_t n = ::write(fd_, data, len);
+        if(n < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            break;      // 磁盘错误时丢弃，不能再写日志报告
         }
-        buff_.RetrieveAll();
+        data += n;
+        len -= n;
     }
 }
 
+void Log::FlushBuffer_() {
+    if(buffLen_ == 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> locker(mtx_);
+    RotateIfNeeded_(time(nullptr), buffLen_);
+    WriteAll_(buff_, buffLen_);
+    buffLen_ = 0;
+}
 
-// 异步写日志：将deque_队列中的日志先存放到FILE*缓冲区中，而后再刷盘(由缓冲区写到磁盘中)
+/*
+异步写日志：每次取出环形队列中连续的一批日志拷贝(二进制记录则格式化)到缓冲区，随即归还槽位
+缓冲区快满或队列取空时才write()一次，负载高时每次写入接近BUFF_SIZE
+*/
 void Log::AsyncWrite_() {
-    std::string str = "";
-    while(deque_->pop(str)) {     // str接收pop出的item
-        std::lock_guard<std::mutex> locker(mtx_);
-        // 将日志写入FILE*的内核缓冲区
-        fputs(str.c_str(), fp_);  // fputs()需要接收const char*类型数据，c_str()将string转为C风格的const char*
+    while(true) {
+        size_t n = 0;
+        while(n < MAX_BATCH && ring_->Peek(n)) {
+            n++;
+        }
+        if(n == 0) {
+            FlushBuffer_();
+            // 关闭时队列已经写空，退出
+            if(isClose_) {
+                break;
+            }
+            ring_->Wait(WAIT_MS);
+            continue;
+        }
+        for(size_t i = 0; i < n; i++) {
+            if(BUFF_SIZE - buffLen_ < static_cast<size_t>(LINE_SIZE)) {
+                FlushBuffer_();
+            }
+            LogRing::Record* rec = ring_->Peek(i);
+            char* line = buff_ + buffLen_;
+            if(!rec->binary) {
+                memcpy(line, rec->data, rec->len);
+                buffLen_ += rec->len;
+                continue;
+            }
+            size_t len = FormatTime_(line, LogDecoder::Timestamp(rec->data) / 1000000000);
+            len += AppendLogLevelTitle_(line + len, rec->level);
+            len += LogDecoder::Format(rec->data, rec->len, line + len, LINE_SIZE - len - 1);
+            line[len++] = '\n';
+            buffLen_ += len;
+        }
+        ring_->Release(n);
     }
 }
 
+// 轮转下来的文件压缩为.gz，成功后删除原文件；失败时保留原文件
+void Log::CompressFile_(std::string src) {
+    pthread_setname_np(pthread_self(), "log-gzip");
+    std::string dst = src + ".gz";
+    int in = open(src.c_str(), O_RDONLY | O_CLOEXEC);
+    if(in < 0) {
+        return;
+    }
+    gzFile out = gzopen(dst.c_str(), "wb6");
+    if(!out) {
+        close(in);
+        return;
+    }
+    char buf[64 * 1024];
+    bool ok = true;
+    ssize_t n;
+    while((n = read(in, buf, sizeof(buf))) > 0) {
+        if(gzwrite(out, buf, n) != n) {
+            ok = false;
+            break;
+        }
+    }
+    if(n < 0) {
+        ok = false;
+    }
+    close(in);
+    if(gzclose(out) != Z_OK) {
+        ok = false;
+    }
+    unlink(ok ? src.c_str() : dst.c_str());
+}
+
 void Log::flush() {
-    if(isAsync_) {    
-        deque_->flush();   // 唤醒writethread_进程，而后执行AsyncWrite_()
+    // 同步模式下write()不经过用户态缓冲区，不需要刷新
+    if(isAsync_) {
+        ring_->Notify();   // 唤醒writethread_进程，而后执行AsyncWrite_()
     }
-    fflush(fp_);    // 刷盘
 }
 
 // 单例模式核心
@@ -176,41 +333,43 @@ Log* Log::Instance() {
 
 // 消费者线程的入口函数
 void Log::FlushLogThread() {
+    // 线程名和绑核：profiling时能区分写线程，写线程也不会和Reactor抢同一个核
+    pthread_setname_np(pthread_self(), "log-writer");
+    if(writerCpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(writerCpu, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
     // inst是函数内部的静态变量，它的作用域仅限于Instance()函数内部，​​外部无法直接访问inst​​。
     // 因此，​​外部代码只能通过Log::Instance()获取单例对象的指针​​，而不能直接使用inst。
     Log::Instance()->AsyncWrite_();
 }
 
-void Log::AppendLogLevelTitle_(int level) {
-    switch(level) {
-        case 0:
-        // 9:字符串长度（"[debug]: "共8字符 + 结尾的\0）
-        // 所有字符串必须以\0结尾，这是区分"字符数组"和"字符串"的关键
-            buff_.Append("[debug]:", 9);  
-            break;
-        case 1:
-        // "[info] :" 由const char[9]退化为const char* 
-            buff_.Append("[info] :", 9);  // 注意[]后的空格，这是为了对齐。空格也算一个字符
-            break;
-        case 2:
-            buff_.Append("[warn] :", 9);
-            break;
-        case 3:
-            buff_.Append("[error]:", 9);
-            break;
-        default:
-            buff_.Append("[info]: ", 9);
-            break;
-    }
+// 前缀固定9个字符(含结尾的空格)，各级别对齐；不能把'\0'写进日志，否则读日志时会被截断
+size_t Log::AppendLogLevelTitle_(char* buf, int level) {
+    static const char* titles[] = {"[debug]: ", "[info] : ", "[warn] : ", "[error]: "};
+    const char* title = (level >= 0 && level <= 3) ? titles[level] : titles[1];
+    memcpy(buf, title, 9);
+    return 9;
 }
 
 // 查看通知级别
 int Log::GetLevel() {
-    std::lock_guard<std::mutex> locker(mtx_);
-    return level_;
+    return level_.load(std::memory_order_relaxed);
 }
 // 调整通知级别
 void Log::SetLevel(int level) {
-    std::lock_guard<std::mutex> locker(mtx_);
-    level_ = level;
-}
\ No newline at end of file
+    level_.store(level, std::memory_order_relaxed);
+    for(int i = 0; i < MODULE_COUNT; i++) {
+        levels_[i].store(level, std::memory_order_relaxed);
+    }
+}
+
+int Log::GetModuleLevel(MODULE module) {
+    return levels_[module].load(std::memory_order_relaxed);
+}
+
+void Log::SetModuleLevel(MODULE module, int level) {
+    levels_[module].store(level, std::memory_order_relaxed);
+}
@@ -8,64 +8,169 @@
 #include <string.h>
 #include <stdarg.h>  // 提供可变参数
 #include <assert.h>
+#include <errno.h>
+#include <algorithm>
+#include <atomic>
+#include <fcntl.h>
+#include <unistd.h>
 #include <sys/stat.h>  // 文件状态和权限相关
-#include "blockqueue.h"
-#include "../buffer/buffer.h"
+#include <time.h>
+#include <pthread.h>    // pthread_setname_np、pthread_setaffinity_np
+#include <sched.h>
+#include "logring.h"
+#include "logformat.h"
+
+/*
+编译期最低级别：低于它的LOG_*语句在编译期就是死代码，参数不会被求值
+默认Release(定义了NDEBUG)编译掉debug日志，也可以用-DLOG_MIN_LEVEL=N指定
+*/
+#ifndef LOG_MIN_LEVEL
+#ifdef NDEBUG
+#define LOG_MIN_LEVEL 1
+#else
+#define LOG_MIN_LEVEL 0
+#endif
+#endif
 
 class Log{
+public:
+    // 日志模块：各模块有独立的运行时级别
+    // 源文件在include之前#define LOG_MODULE Log::HTTP指定所属模块，不指定时为CORE
+    enum MODULE {
+        CORE = 0,
+        SERVER,
+        HTTP,
+        TIMER,
+        POOL,
+        BUFFER,
+        MODULE_COUNT,
+    };
+    static const int LEVEL_OFF = 4;     // 高于所有级别，表示关闭
+
 private:
     Log();   // 私有构造函数，禁止外部实例化对象
     virtual ~Log();   // 虚析构
-    void AppendLogLevelTitle_(int level);  // 加日志级别前缀
+    size_t FormatLine_(char* buf, size_t size, int level, const char* format, va_list valist);  // 时间戳-日志级别-用户消息
+    size_t FormatTime_(char* buf, time_t sec);          // 时间戳前缀，每个线程每秒只格式化一次
+    size_t AppendLogLevelTitle_(char* buf, int level);  // 加日志级别前缀
+    LogRing::Record* AcquireRecord_();  // 从环形队列占用一个槽，按溢出策略等待或丢弃
+    bool OpenFile_(time_t now);         // 打开当天的日志文件，记录文件大小和下一次跨天的时间
+    void RotateIfNeeded_(time_t now, size_t incoming);  // 跨天或超过maxFileSize时换文件，调用前需持有mtx_
+    void WriteAll_(const char* data, size_t len);       // write()写完为止
+    void FlushBuffer_();                // 把写线程缓冲区中的日志一次写入文件
     void AsyncWrite_();  // 异步写日志
+    static void CompressFile_(std::string src);         // 把轮转下来的文件压缩为.gz并删除原文件
     
 private:
 // 日志文件配置
     static const int LOG_PATH_LEN = 256;
     static const int LOG_NAME_LEN = 256;
-    static const int MAX_LINES = 50000;    // 默认最大长度
+    static const int MAX_BATCH = 64;       // 写线程一次最多从队列取出的日志条数
+    static const int LINE_SIZE = 1024;     // 写线程格式化二进制记录时单行的最大长度
+    static const int WAIT_MS = 100;        // 队列为空时写线程的最长睡眠时间
+    static const size_t BUFF_SIZE = 64 * 1024;   // 写线程缓冲区，攒满或队列取空时write()一次
 
     const char* path_;   
     const char* suffix_;   // 日志文件后缀
-    int MAX_LINES_;        // 当前最大长度
+    std::string fileName_; // 当前日志文件名
 
 // 日志状态监控
-    int lineCount_;     // 当前写入行数
-    int toDay_;         // 日期
+    size_t fileSize_;   // 当前文件大小
+    time_t nextDay_;    // 下一个0点，到了就换文件
     bool isOpen_;       // 日志系统是否开启
 
 // 日志内容处理
-    Buffer buff_;    // 日志内容缓冲区
-    int level_;      // 当前日志级别（0-3）
+    std::atomic<int> level_;    // 当前日志级别（0-3），每条日志都要读，不加锁
     bool isAsync_;   // 是否异步写入标志
+    bool deferred_;  // 二进制延迟格式化(仅异步模式)
+    bool blockOnFull_;          // 队列满时：true-等待写线程腾出位置  false-丢弃并计数
+    std::atomic<uint64_t> dropped_;     // 队列满被丢弃的日志条数
 
 // 文件操作
-    FILE* fp_;      // 日志文件指针，缓冲多条日志(写入磁盘前都需要先写入FILE*缓冲区)
+// O_APPEND打开，直接write()，不经过stdio缓冲；异步模式下由写线程攒成大块再写
+    int fd_;
+    char* buff_;            // 写线程缓冲区(按页对齐)
+    size_t buffLen_;
+    std::thread compressThread_;    // 压缩轮转文件的后台线程，同一时刻最多一个
 
 // 异步日志
 // unique_ptr:智能指针，​​独占所有权​​地管理动态分配的对象，确保该对象​​同一时间只能被一个指针拥有(RAII机制)
-// 会自动释放内存，无需手动delete，确保阻塞队列和写线程的生命周期和日志实例一致
+// 会自动释放内存，无需手动delete，确保环形队列和写线程的生命周期和日志实例一致
 // 这里的成员都是指针类型的
-    std::unique_ptr<BlockDeque<std::string>> deque_;  // 阻塞队列(日志内容存放位置)
+// 业务线程直接把日志格式化进环形队列的槽里，不加锁；只有写线程会写文件、换文件
+    std::unique_ptr<LogRing> ring_;     // 无锁环形队列(日志内容存放位置)
     std::unique_ptr<std::thread> writeThread_;      // 写日志的线程
-    std::mutex mtx_;
+    std::atomic<bool> isClose_;
+    std::mutex mtx_;                    // 保护fd_和文件大小(同步写、换文件)
+
+// 各模块的级别：每条日志语句只读一次，放在同一个缓存行里，日志未开启时都是LEVEL_OFF
+    alignas(64) static std::atomic<int> levels_[MODULE_COUNT];
 
 public:
+    // 单个日志文件的最大字节数，超过后轮转；0表示只按天轮转
+    static size_t maxFileSize;
+    // 轮转下来的文件是否在后台压缩为.gz
+    static bool compressRotated;
+    // 写线程绑定的CPU，-1表示不绑定；需要在init之前设置
+    static int writerCpu;
+
+    // maxQueueCapacity > 0 为异步模式，向上取整为2的幂
+    // 异步模式下warn/error日志立即唤醒写线程，debug/info日志最迟WAIT_MS毫秒后写入文件
     void init(int level, const char* path = "./log",
                 const char* suffix = ".log",
-                int maxQueueCaoacity = 1024);
+                int maxQueueCaoacity = 1024,
+                bool blockOnFull = false,
+                bool deferred = false);
     static Log* Instance();   // 单例模式
 
-    // write()：同步模式下写入文件，异步模式下写入阻塞队列
+    // write()：同步模式下写入文件，异步模式下写入环形队列
     void write(int level, const char* format,...);
+
+    /*
+    延迟格式化：只记录时间戳、格式串指针和参数，vsnprintf/localtime都放到写线程
+    format必须是字符串常量；参数只能是整数、浮点数、指针和C字符串(字符串会被拷贝)
+    */
+    template<typename... Args>
+    void WriteDeferred(int level, const char* format, const Args&... args) {
+        LogRing::Record* rec = AcquireRecord_();
+        if(!rec) {
+            return;
+        }
+        // 粗粒度时钟走vDSO，只读内核维护的时间，比CLOCK_REALTIME更快；日志只精确到秒
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+        LogEncoder enc(rec->data, LogRing::RECORD_SIZE);
+        enc.Begin(ts.tv_sec * 1000000000LL + ts.tv_nsec, format);
+        (enc.Put(args), ...);
+        rec->len = enc.Size();
+        rec->level = level;
+        rec->binary = true;
+        ring_->Commit(rec, level >= 2);
+    }
+
+    bool IsDeferred() {
+        return deferred_;
+    }
     // 后台线程：从内存队列取出日志，批量写入磁盘（仅异步模式需要）——持续执行
     static void FlushLogThread();   
-    // 从队列取日志写入文件(磁盘)——立即执行(由关键日志调用，如错误日志)
+    // 唤醒写线程，让它尽快把队列中的日志写入文件
     void flush();   
 
-    // 动态调整要记录哪些级别的日志
+    // 异步模式下因队列满而丢弃的日志条数
+    uint64_t Dropped() {
+        return dropped_.load(std::memory_order_relaxed);
+    }
+
+    // 动态调整要记录哪些级别的日志：SetLevel设置全局级别并覆盖所有模块
     int GetLevel();     
     void SetLevel(int level);
+    int GetModuleLevel(MODULE module);
+    void SetModuleLevel(MODULE module, int level);
+
+    // module模块的level级日志是否需要记录；不需要访问日志实例
+    static bool Enabled(int module, int level) {
+        return level >= levels_[module].load(std::memory_order_relaxed);
+    }
 
     bool IsOpen() {
         return isOpen_;
@@ -73,12 +178,21 @@ public:
 
 };
 
+#ifndef LOG_MODULE
+#define LOG_MODULE Log::CORE
+#endif
+
+// level是常量：低于LOG_MIN_LEVEL时整条语句被编译器删除；否则先用一次原子读检查模块级别
 #define LOG_BASE(level, format, ...) \
     do {\
-        Log* log = Log::Instance();\
-        if (log->IsOpen() && log->GetLevel() <= level) {\
-            log->write(level, format, ##__VA_ARGS__); \
-            log->flush();\
+        if (level >= LOG_MIN_LEVEL && Log::Enabled(LOG_MODULE, level)) {\
+            Log* log = Log::Instance();\
+            static const bool deferrable = LogDecoder::Deferrable(format);\
+            if (deferrable && log->IsDeferred()) {\
+                log->WriteDeferred(level, format, ##__VA_ARGS__);\
+            } else {\
+                log->write(level, format, ##__VA_ARGS__); \
+            }\
         }\
     } while(0);
 
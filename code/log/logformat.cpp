@@ -0,0 +1,145 @@
+#include "logformat.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+
+static const size_t HEADER_SIZE = sizeof(int64_t) + sizeof(const char*);
+
+bool LogDecoder::Deferrable(const char* format) {
+    for(const char* p = format; *p; p++) {
+        if(*p != '%') {
+            continue;
+        }
+        p++;
+        while(*p && !strchr("diouxXeEfFgGaAcspn%", *p)) {
+            if(*p == '*') {
+                return false;
+            }
+            p++;
+        }
+        if(*p == 'n') {
+            return false;
+        }
+        if(!*p) {
+            break;
+        }
+    }
+    return true;
+}
+
+int64_t LogDecoder::Timestamp(const char* data) {
+    int64_t ns;
+    memcpy(&ns, data, sizeof(ns));
+    return ns;
+}
+
+/*
+逐个处理格式串中的转换说明：
+把原说明中的标志、宽度、精度保留下来，长度修饰符统一换成与编码类型一致的(ll)，再交给snprintf
+参数缺失或类型对不上时输出<?>，不会读越界
+*/
+size_t LogDecoder::Format(const char* data, size_t len, char* out, size_t size) {
+    const char* format;
+    memcpy(&format, data + sizeof(int64_t), sizeof(format));
+    const char* arg = data + HEADER_SIZE;
+    const char* argEnd = data + len;
+    size_t n = 0;
+
+    auto append = [&](int m) {
+        if(m > 0) {
+            n += std::min(static_cast<size_t>(m), size - 1 - n);
+        }
+    };
+
+    for(const char* p = format; *p && n + 1 < size; p++) {
+        if(*p != '%') {
+            out[n++] = *p;
+            continue;
+        }
+        if(p[1] == '%') {
+            out[n++] = '%';
+            p++;
+            continue;
+        }
+        // spec：标志、宽度、精度，去掉长度修饰符
+        char spec[32];
+        size_t s = 0;
+        spec[s++] = '%';
+        p++;
+        while(*p && !strchr("diouxXeEfFgGaAcsp", *p)) {
+            if(!strchr("hlLqjzt", *p) && s < sizeof(spec) - 4) {
+                spec[s++] = *p;
+            }
+            p++;
+        }
+        if(!*p) {
+            break;
+        }
+        char conv = *p;
+        char tag = arg < argEnd ? *arg : 0;
+        if(tag == 'i' || tag == 'u' || tag == 'p') {
+            uint64_t v;
+            if(arg + 1 + sizeof(v) > argEnd) {
+                tag = 0;
+            } else {
+                memcpy(&v, arg + 1, sizeof(v));
+                arg += 1 + sizeof(v);
+                if(conv == 'p') {
+                    spec[s++] = 'p'; spec[s] = '\0';
+                    append(snprintf(out + n, size - n, spec, reinterpret_cast<void*>(v)));
+                } else if(conv == 'c') {
+                    spec[s++] = 'c'; spec[s] = '\0';
+                    append(snprintf(out + n, size - n, spec, static_cast<int>(v)));
+                } else if(conv == 'd' || conv == 'i') {
+                    spec[s++] = 'l'; spec[s++] = 'l'; spec[s++] = conv; spec[s] = '\0';
+                    append(snprintf(out + n, size - n, spec, static_cast<long long>(v)));
+                } else if(strchr("ouxX", conv)) {
+                    spec[s++] = 'l'; spec[s++] = 'l'; spec[s++] = conv; spec[s] = '\0';
+                    append(snprintf(out + n, size - n, spec, static_cast<unsigned long long>(v)));
+                } else {
+                    tag = 0;
+                }
+            }
+        } else if(tag == 'f') {
+            double v;
+            if(arg + 1 + sizeof(v) > argEnd || !strchr("eEfFgGaA", conv)) {
+                tag = 0;
+            } else {
+                memcpy(&v, arg + 1, sizeof(v));
+                arg += 1 + sizeof(v);
+                spec[s++] = conv; spec[s] = '\0';
+                append(snprintf(out + n, size - n, spec, v));
+            }
+        } else if(tag == 's') {
+            uint16_t sl;
+            if(arg + 1 + sizeof(sl) > argEnd || conv != 's') {
+                tag = 0;
+            } else {
+                memcpy(&sl, arg + 1, sizeof(sl));
+                const char* str = arg + 1 + sizeof(sl);
+                if(str + sl > argEnd) {
+                    sl = static_cast<uint16_t>(argEnd - str);
+                }
+                arg = str + sl;
+                // 字符串在记录中不以'\0'结尾，用精度限制长度(原说明中的精度更小时以原来的为准)
+                spec[s] = '\0';
+                const char* dot = strchr(spec, '.');
+                int prec = sl;
+                if(dot) {
+                    prec = std::min<int>(atoi(dot + 1), sl);
+                    s = dot - spec;
+                }
+                spec[s++] = '.'; spec[s++] = '*'; spec[s++] = 's'; spec[s] = '\0';
+                append(snprintf(out + n, size - n, spec, prec, str));
+            }
+        } else {
+            tag = 0;
+        }
+        if(tag == 0) {
+            append(snprintf(out + n, size - n, "<?>"));
+        }
+    }
+    out[n] = '\0';
+    return n;
+}
@@ -0,0 +1,100 @@
+#ifndef LOG_FORMAT_H
+#define LOG_FORMAT_H
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+/*
+二进制延迟格式化：
+业务线程不调用vsnprintf/localtime，只把时间戳、格式串指针和原始参数按类型编码进日志记录，
+由写线程解码后再按printf的规则格式化
+记录格式：[int64 纳秒时间戳][const char* 格式串][参数...]
+每个参数：1字节类型 + 数据
+  'i' int64    'u' uint64    'f' double    'p' 指针
+  's' uint16长度 + 字符串内容(拷贝，不依赖调用者的内存)
+格式串只保存指针，所以必须是字符串常量(LOG_*宏都是)
+*/
+class LogEncoder {
+public:
+    LogEncoder(char* buf, size_t size) : buf_(buf), end_(buf + size), cur_(buf) {}
+
+    void Begin(int64_t ns, const char* format) {
+        PutRaw_(&ns, sizeof(ns));
+        PutRaw_(&format, sizeof(format));
+    }
+
+    template<typename T>
+    void Put(const T& v) {
+        typedef typename std::decay<const T&>::type D;
+        D d = v;    // 字符数组退化为指针
+        if constexpr (std::is_same<D, char*>::value || std::is_same<D, const char*>::value) {
+            PutStr_(d);
+        } else if constexpr (std::is_floating_point<D>::value) {
+            PutTag_('f', static_cast<double>(d));
+        } else if constexpr (std::is_enum<D>::value) {
+            PutTag_('i', static_cast<int64_t>(d));
+        } else if constexpr (std::is_integral<D>::value && std::is_signed<D>::value) {
+            PutTag_('i', static_cast<int64_t>(d));
+        } else if constexpr (std::is_integral<D>::value) {
+            PutTag_('u', static_cast<uint64_t>(d));
+        } else if constexpr (std::is_pointer<D>::value) {
+            PutTag_('p', reinterpret_cast<uint64_t>(d));
+        } else {
+            static_assert(std::is_pointer<D>::value, "unsupported log argument type");
+        }
+    }
+
+    size_t Size() const {
+        return cur_ - buf_;
+    }
+
+private:
+    void PutRaw_(const void* p, size_t len) {
+        memcpy(cur_, p, len);
+        cur_ += len;
+    }
+
+    // 空间不够时丢弃后面的参数，解码时会输出占位符
+    template<typename V>
+    void PutTag_(char tag, V v) {
+        if(cur_ + 1 + sizeof(v) > end_) {
+            cur_ = end_;
+            return;
+        }
+        *cur_++ = tag;
+        PutRaw_(&v, sizeof(v));
+    }
+
+    void PutStr_(const char* s) {
+        if(!s) {
+            s = "(null)";
+        }
+        if(cur_ + 3 > end_) {
+            cur_ = end_;
+            return;
+        }
+        size_t len = strnlen(s, end_ - cur_ - 3);
+        uint16_t n = static_cast<uint16_t>(len);
+        *cur_++ = 's';
+        PutRaw_(&n, sizeof(n));
+        PutRaw_(s, len);
+    }
+
+    char* buf_;
+    char* end_;
+    char* cur_;
+};
+
+class LogDecoder {
+public:
+    // 格式串中有*宽度/精度时参数之间有依赖(如%.*s的字符串不以'\0'结尾)，不能延迟格式化
+    static bool Deferrable(const char* format);
+
+    // 读出记录头
+    static int64_t Timestamp(const char* data);
+    // 按格式串把参数格式化到out，返回写入的长度(不含'\0')
+    static size_t Format(const char* data, size_t len, char* out, size_t size);
+};
+
+#endif
@@ -0,0 +1,84 @@
+#include "logring.h"
+
+#include <chrono>
+
+const size_t LogRing::RECORD_SIZE;
+
+LogRing::LogRing(size_t capacity) : tail_(0), head_(0), sleeping_(false) {
+    size_t n = 4;
+    while(n < capacity) {
+        n <<= 1;
+    }
+    records_.reset(new Record[n]);
+    mask_ = n - 1;
+    for(size_t i = 0; i < n; i++) {
+        records_[i].seq.store(i, std::memory_order_relaxed);
+        records_[i].len = 0;
+    }
+}
+
+LogRing::Record* LogRing::Acquire() {
+    uint64_t pos = tail_.load(std::memory_order_relaxed);
+    while(true) {
+        Record& rec = records_[pos & mask_];
+        uint64_t seq = rec.seq.load(std::memory_order_acquire);
+        int64_t diff = static_cast<int64_t>(seq) - static_cast<int64_t>(pos);
+        if(diff == 0) {
+            // 抢到pos这个位置；失败时pos会被更新为最新的tail_
+            if(tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                return &rec;
+            }
+        } else if(diff < 0) {
+            // 上一圈的记录还没被消费者读走：队列满
+            return nullptr;
+        } else {
+            // 被其他生产者抢先了
+            pos = tail_.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+void LogRing::Commit(Record* rec, bool wake) {
+    assert(rec);
+    // 占用时seq == pos，只有当前生产者会修改它
+    uint64_t pos = rec->seq.load(std::memory_order_relaxed);
+    rec->seq.store(pos + 1, std::memory_order_seq_cst);
+    // 不要求立即唤醒时，每写满1/4个队列才唤醒一次，其余由消费者的定时等待兜底
+    if(!wake && (pos & (Capacity() / 4 - 1)) != 0) {
+        return;
+    }
+    // 与Wait()中的sleeping_/seq构成Dekker式的检查，不会丢失唤醒
+    // 只有第一个看到消费者睡眠的生产者去唤醒，其余的不再加锁
+    if(sleeping_.load(std::memory_order_seq_cst) && sleeping_.exchange(false)) {
+        Notify();
+    }
+}
+
+LogRing::Record* LogRing::Peek(size_t i) {
+    uint64_t pos = head_ + i;
+    Record& rec = records_[pos & mask_];
+    if(rec.seq.load(std::memory_order_acquire) != pos + 1) {
+        return nullptr;
+    }
+    return &rec;
+}
+
+void LogRing::Release(size_t n) {
+    for(size_t i = 0; i < n; i++, head_++) {
+        records_[head_ & mask_].seq.store(head_ + mask_ + 1, std::memory_order_release);
+    }
+}
+
+void LogRing::Wait(int ms) {
+    std::unique_lock<std::mutex> locker(mtx_);
+    sleeping_.store(true, std::memory_order_seq_cst);
+    if(!Peek(0)) {
+        cond_.wait_for(locker, std::chrono::milliseconds(ms));
+    }
+    sleeping_.store(false, std::memory_order_relaxed);
+}
+
+void LogRing::Notify() {
+    std::lock_guard<std::mutex> locker(mtx_);
+    cond_.notify_one();
+}
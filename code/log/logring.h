@@ -0,0 +1,70 @@
+#ifndef LOG_RING_H
+#define LOG_RING_H
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <cstdint>
+#include <assert.h>
+
+/*
+LogRing：多生产者单消费者(MPSC)的无锁环形队列，存放定长的日志记录
+1、每个槽带一个序号seq(Vyukov有界队列)：
+   seq == pos      槽空闲，生产者可以占用pos这个位置
+   seq == pos + 1  生产者已写完，消费者可以读
+   消费者读完后把seq设为pos + capacity，留给下一圈的生产者
+2、生产者只用一次CAS抢位置，之后直接把日志格式化进槽里，没有锁也没有内存分配
+3、消费者一次取出连续的多条记录，整批写入文件后再归还槽位
+4、队列空时消费者在条件变量上睡眠，生产者只在消费者睡眠时才去加锁唤醒；
+   普通日志每1/4个队列才唤醒一次，消费者最多睡眠一个等待周期
+*/
+class LogRing {
+public:
+    static const size_t RECORD_SIZE = 512;     // 单条日志的最大长度，超出部分截断
+
+    struct Record {
+        std::atomic<uint64_t> seq;
+        uint32_t len;
+        int level;
+        bool binary;        // 二进制记录(LogEncoder编码)，由写线程格式化
+        char data[RECORD_SIZE];
+    };
+
+    // capacity向上取整为2的幂(至少为4)
+    explicit LogRing(size_t capacity);
+    ~LogRing() = default;
+
+    // 生产者：占用一个槽，队列满时返回nullptr；写完后必须Commit
+    // wake为false时不一定唤醒消费者(消费者最迟在下一次Wait超时后读到)，减少唤醒的系统调用
+    Record* Acquire();
+    void Commit(Record* rec, bool wake = true);
+
+    // 消费者：第i条待读的记录，还没写完返回nullptr
+    Record* Peek(size_t i);
+    // 消费者：归还前n条记录的槽位
+    void Release(size_t n);
+
+    // 消费者：队列为空时最多睡眠ms毫秒
+    void Wait(int ms);
+    // 唤醒消费者(Close或需要立即刷盘时)
+    void Notify();
+
+    size_t Capacity() const {
+        return mask_ + 1;
+    }
+
+private:
+    std::unique_ptr<Record[]> records_;
+    size_t mask_;
+
+    // 生产者和消费者各自的位置放在不同的缓存行，避免伪共享
+    alignas(64) std::atomic<uint64_t> tail_;    // 下一个可占用的位置(生产者)
+    alignas(64) uint64_t head_;                 // 下一个要读的位置(只有消费者访问)
+
+    std::atomic<bool> sleeping_;
+    std::mutex mtx_;
+    std::condition_variable cond_;
+};
+
+#endif
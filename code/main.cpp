@@ -0,0 +1,33 @@
+#include <unistd.h>
+#include "server/webserver.h"
+
+int main() {
+    /* 守护进程 后台运行 */
+    //daemon(1, 0);
+
+    ServerOptions opt;
+    opt.port = 1316;
+    opt.trigMode = 3;               /* ET模式 */
+    opt.timeoutMS = 60000;
+    opt.optLinger = false;          /* 优雅退出 */
+    opt.sqlPort = 3306;             /* Mysql配置 */
+    opt.sqlUser = "root";
+    opt.sqlPwd = "root";
+    opt.dbName = "webserver";
+    opt.connPoolNum = 12;           /* 连接池数量 */
+    opt.threadNum = 0;              /* 线程池数量(0:在Reactor线程内处理) */
+    opt.reactorNum = 0;             /* Reactor数量(0:CPU核数) */
+    opt.openLog = true;             /* 日志开关 日志等级 日志异步队列容量 日志延迟格式化 */
+    opt.logLevel = 1;
+    opt.logQueSize = 1024;
+    opt.logDeferred = true;
+    opt.fileCacheMB = 64;           /* 静态文件缓存大小(MB)，0为关闭 */
+    opt.pipelineDepth = 8;          /* 流水线深度 */
+    opt.timerMode = 0;              /* 定时器(0:小根堆 1:时间轮 2:惰性小根堆) */
+    opt.pinThreads = false;         /* 按NUMA节点绑核 */
+    opt.coroutine = false;          /* 协程处理连接(需要C++20) */
+    opt.ioMode = 0;                 /* I/O(0:epoll 1:io_uring) */
+    opt.reusePort = true;           /* 每个Reactor一个监听socket */
+    WebServer server(opt);
+    server.Start();
+}
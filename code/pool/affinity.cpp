@@ -0,0 +1,93 @@
+#include "affinity.h"
+
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+
+const std::vector<std::vector<int>>& Affinity::Nodes() {
+    // 拓扑在运行期间不会变，只读一次(C++11保证局部静态变量初始化是线程安全的)
+    static const std::vector<std::vector<int>> nodes = LoadNodes_();
+    return nodes;
+}
+
+std::vector<std::vector<int>> Affinity::LoadNodes_() {
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if(sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        CPU_ZERO(&allowed);
+        CPU_SET(0, &allowed);
+    }
+
+    std::vector<std::vector<int>> nodes;
+    std::string online;
+    std::ifstream in("/sys/devices/system/node/online");
+    if(in && std::getline(in, online)) {
+        for(int node : ParseCpuList(online)) {
+            std::ifstream cpuIn("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+            std::string list;
+            if(!cpuIn || !std::getline(cpuIn, list)) {
+                continue;
+            }
+            std::vector<int> cpus;
+            for(int cpu : ParseCpuList(list)) {
+                if(cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed)) {
+                    cpus.push_back(cpu);
+                }
+            }
+            if(!cpus.empty()) {
+                nodes.push_back(std::move(cpus));
+            }
+        }
+    }
+    // 没有sysfs(容器)或者解析失败：所有允许的CPU作为一个节点
+    if(nodes.empty()) {
+        std::vector<int> cpus;
+        for(int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if(CPU_ISSET(cpu, &allowed)) {
+                cpus.push_back(cpu);
+            }
+        }
+        nodes.push_back(std::move(cpus));
+    }
+    return nodes;
+}
+
+std::vector<int> Affinity::ParseCpuList(const std::string& list) {
+    std::vector<int> cpus;
+    std::stringstream ss(list);
+    std::string item;
+    while(std::getline(ss, item, ',')) {
+        if(item.empty()) {
+            continue;
+        }
+        char* end = nullptr;
+        long first = strtol(item.c_str(), &end, 10);
+        long last = first;
+        if(*end == '-') {
+            last = strtol(end + 1, &end, 10);
+        }
+        for(long cpu = first; cpu <= last && cpu >= 0; cpu++) {
+            cpus.push_back(static_cast<int>(cpu));
+        }
+    }
+    return cpus;
+}
+
+bool Affinity::SetName(const std::string& name) {
+    // 内核限制线程名最多16字节(含'\0')
+    return pthread_setname_np(pthread_self(), name.substr(0, 15).c_str()) == 0;
+}
+
+bool Affinity::Bind(const std::vector<int>& cpus) {
+    if(cpus.empty()) {
+        return true;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for(int cpu : cpus) {
+        if(cpu >= 0 && cpu < CPU_SETSIZE) {
+            CPU_SET(cpu, &set);
+        }
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
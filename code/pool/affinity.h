@@ -0,0 +1,37 @@
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include <sched.h>
+
+/*
+Affinity：线程命名、绑核和NUMA拓扑
+1、拓扑从/sys/devices/system/node读取，不依赖libnuma；读不到时当作只有一个节点
+2、每个节点只保留本进程允许运行的CPU(taskset/cgroup限制之后的)，没有可用CPU的节点被忽略
+3、内存按首次访问(first-touch)分配在访问线程所在的节点：线程先绑到节点上，
+   再由它分配和初始化Buffer等数据，数据就落在本节点
+*/
+class Affinity {
+public:
+    // 可用的NUMA节点，每个节点是一组CPU编号；至少返回一个节点
+    static const std::vector<std::vector<int>>& Nodes();
+
+    // 设置当前线程名(ps -L、top -H、perf中可见)，超过15个字符时截断
+    static bool SetName(const std::string& name);
+
+    // 把当前线程绑定到cpus中的CPU上，cpus为空时什么也不做
+    static bool Bind(const std::vector<int>& cpus);
+    static bool Bind(int cpu) {
+        return Bind(std::vector<int>{cpu});
+    }
+
+    // 解析sysfs中的CPU列表，如"0-3,8,10-11"
+    static std::vector<int> ParseCpuList(const std::string& list);
+
+private:
+    static std::vector<std::vector<int>> LoadNodes_();
+};
+
+#endif
@@ -0,0 +1,153 @@
+// 模板类的具体实现代码也得放到.h文件中
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stdint.h>
+#include <assert.h>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+/*
+Slab：固定类型对象的预分配池，SubReactor用它存放连接(HttpConn)
+1、按CHUNK_SIZE个槽位一块分配，块地址不变，对象的指针一直有效；每个槽位按缓存行(64字节)对齐，
+   相邻连接不会共享缓存行
+2、对象只在分配块时构造一次，之后反复使用：Acquire()后由使用者初始化(HttpConn::init)，
+   Release()前由使用者清理(HttpConn::Close)。空闲槽位放在LIFO链表里，最近释放的先被重用，缓存还是热的
+3、句柄 = 代数(高32位) | 槽位下标(低32位)。槽位每次Acquire/Release代数加一，使用中为奇数、空闲为偶数，
+   因此旧句柄(连接已关闭，槽位可能已经给了新连接)用Get()查到的是nullptr，晚到的事件、定时器回调找不到新连接；
+   句柄至少是1<<32，不会和Epoller的LISTEN_TOKEN等小常量冲突
+4、Acquire/Release加锁；Get不加锁，可以在任何线程调用
+   Get()只是检查当时句柄是否有效，之后对象仍可能被归还：使用者要保证用对象期间没有别的线程Release它
+   (SubReactor：有任务在线程池中的连接只能由Reactor线程在任务结束后关闭)
+*/
+template<class T>
+class Slab {
+public:
+    typedef uint64_t Handle;
+    static const size_t CHUNK_SIZE = 1024;     // 每块的槽位数(2的幂)
+    static const size_t MAX_CHUNKS = 1024;     // 最多CHUNK_SIZE * MAX_CHUNKS个对象
+
+    Slab() : capacity_(0), used_(0) {}
+    ~Slab();
+
+    bool Reserve(size_t n);         // 预先分配至少n个槽位(向上取整到块)，超过上限返回false
+    T* Acquire(Handle* handle);     // 取一个空闲对象，没有空闲槽位时分配新块，达到上限返回nullptr
+    bool Release(Handle handle);    // 归还对象，句柄已经失效时返回false
+    T* Get(Handle handle) const;    // 句柄失效(已归还或槽位被重用)时返回nullptr
+
+    size_t Capacity() const {
+        return capacity_.load(std::memory_order_acquire);
+    }
+    size_t Used() const {
+        return used_.load(std::memory_order_relaxed);
+    }
+
+    Slab(const Slab&) = delete;
+    Slab& operator=(const Slab&) = delete;
+
+private:
+    struct alignas(64) Slot {
+        std::atomic<uint32_t> gen{0};
+        T obj;
+    };
+
+    Slot& SlotAt_(uint32_t idx) const {
+        return chunks_[idx / CHUNK_SIZE][idx % CHUNK_SIZE];
+    }
+    bool Grow_();   // 调用方持有mtx_
+
+    // 块的指针在capacity_增加之前写好；拿到句柄的线程一定能看到对应的块
+    Slot* chunks_[MAX_CHUNKS] = {};
+    std::atomic<size_t> capacity_;
+    std::atomic<size_t> used_;
+    std::vector<uint32_t> free_;    // 空闲槽位下标，从尾部取
+    std::mutex mtx_;
+};
+
+template<class T>
+Slab<T>::~Slab() {
+    size_t chunks = capacity_ / CHUNK_SIZE;
+    for(size_t i = 0; i < chunks; i++) {
+        delete[] chunks_[i];
+    }
+}
+
+template<class T>
+bool Slab<T>::Grow_() {
+    size_t chunk = capacity_ / CHUNK_SIZE;
+    if(chunk >= MAX_CHUNKS) {
+        return false;
+    }
+    chunks_[chunk] = new Slot[CHUNK_SIZE];
+    // 倒序放入，先用下标小的槽位
+    free_.reserve(free_.size() + CHUNK_SIZE);
+    for(size_t i = CHUNK_SIZE; i > 0; i--) {
+        free_.push_back(static_cast<uint32_t>(chunk * CHUNK_SIZE + i - 1));
+    }
+    capacity_.store((chunk + 1) * CHUNK_SIZE, std::memory_order_release);
+    return true;
+}
+
+template<class T>
+bool Slab<T>::Reserve(size_t n) {
+    std::lock_guard<std::mutex> locker(mtx_);
+    while(capacity_ < n) {
+        if(!Grow_()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template<class T>
+T* Slab<T>::Acquire(Handle* handle) {
+    assert(handle);
+    std::lock_guard<std::mutex> locker(mtx_);
+    if(free_.empty() && !Grow_()) {
+        return nullptr;
+    }
+    uint32_t idx = free_.back();
+    free_.pop_back();
+    Slot& slot = SlotAt_(idx);
+    uint32_t gen = slot.gen.load(std::memory_order_relaxed) + 1;
+    assert(gen & 1);
+    slot.gen.store(gen, std::memory_order_release);
+    used_.fetch_add(1, std::memory_order_relaxed);
+    *handle = (static_cast<Handle>(gen) << 32) | idx;
+    return &slot.obj;
+}
+
+template<class T>
+bool Slab<T>::Release(Handle handle) {
+    std::lock_guard<std::mutex> locker(mtx_);
+    uint32_t idx = static_cast<uint32_t>(handle);
+    uint32_t gen = static_cast<uint32_t>(handle >> 32);
+    if(!(gen & 1) || idx >= capacity_) {
+        return false;
+    }
+    Slot& slot = SlotAt_(idx);
+    if(slot.gen.load(std::memory_order_relaxed) != gen) {
+        return false;
+    }
+    slot.gen.store(gen + 1, std::memory_order_release);
+    used_.fetch_sub(1, std::memory_order_relaxed);
+    free_.push_back(idx);
+    return true;
+}
+
+template<class T>
+T* Slab<T>::Get(Handle handle) const {
+    uint32_t idx = static_cast<uint32_t>(handle);
+    uint32_t gen = static_cast<uint32_t>(handle >> 32);
+    if(!(gen & 1) || idx >= capacity_.load(std::memory_order_acquire)) {
+        return nullptr;
+    }
+    Slot& slot = SlotAt_(idx);
+    if(slot.gen.load(std::memory_order_acquire) != gen) {
+        return nullptr;
+    }
+    return &slot.obj;
+}
+
+#endif
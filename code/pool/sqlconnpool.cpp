@@ -1,5 +1,15 @@
+#define LOG_MODULE Log::POOL
 #include "sqlconnpool.h"
 
+SqlConnPool::SqlConnPool() {
+    useCount_ = 0;
+    freeCount_ = 0;
+}
+
+SqlConnPool::~SqlConnPool() {
+    ClosePool();
+}
+
 // 单例模式
 SqlConnPool* SqlConnPool::Instance() {
     static SqlConnPool connPool;
@@ -0,0 +1,129 @@
+#ifndef TASK_H
+#define TASK_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/*
+Task：线程池的任务，只能移动的可调用对象，固定64字节(一个缓存行)
+1、小而且可以按字节拷贝的可调用对象(如只捕获指针的Lambda)直接放在内部，不分配内存
+2、其他对象(如捕获了std::string、std::function的Lambda)在堆上分配，内部只存指针
+因此Task本身可以按字节搬移：工作窃取队列里按8字节一个原子字存放，窃取时先读出再CAS
+*/
+class Task {
+public:
+    static const size_t INLINE_SIZE = 48;
+    static const size_t WORDS = 8;          // sizeof(Task) / 8
+
+    Task() : invoke_(nullptr), destroy_(nullptr) {}
+
+    template<class F, class = typename std::enable_if<
+        !std::is_same<typename std::decay<F>::type, Task>::value>::type>
+    Task(F&& f) {
+        typedef typename std::decay<F>::type Fn;
+        if constexpr (sizeof(Fn) <= INLINE_SIZE && alignof(Fn) <= alignof(uint64_t) &&
+                      std::is_trivially_copyable<Fn>::value) {
+            new (storage_) Fn(std::forward<F>(f));
+            invoke_ = [](Task& t) {
+                (*std::launder(reinterpret_cast<Fn*>(t.storage_)))();
+            };
+            destroy_ = nullptr;
+        } else {
+            Fn* p = new Fn(std::forward<F>(f));
+            memcpy(storage_, &p, sizeof(p));
+            invoke_ = [](Task& t) {
+                (*t.Heap_<Fn>())();
+            };
+            destroy_ = [](Task& t) {
+                delete t.Heap_<Fn>();
+            };
+        }
+    }
+
+    Task(Task&& other) noexcept {
+        MoveFrom_(other);
+    }
+
+    Task& operator=(Task&& other) noexcept {
+        if(this != &other) {
+            Reset_();
+            MoveFrom_(other);
+        }
+        return *this;
+    }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    ~Task() {
+        Reset_();
+    }
+
+    explicit operator bool() const {
+        return invoke_ != nullptr;
+    }
+
+    void operator()() {
+        invoke_(*this);
+    }
+
+    // 把任务按字节写入words，所有权随之转移，本对象变为空
+    void StoreTo(std::atomic<uint64_t>* words) {
+        uint64_t raw[WORDS];
+        memcpy(raw, static_cast<const void*>(this), sizeof(raw));
+        for(size_t i = 0; i < WORDS; i++) {
+            words[i].store(raw[i], std::memory_order_relaxed);
+        }
+        invoke_ = nullptr;
+        destroy_ = nullptr;
+    }
+
+    // 从原子字中读出字节(还不拥有任务，窃取失败时直接丢弃)
+    static void LoadRaw(const std::atomic<uint64_t>* words, uint64_t* raw) {
+        for(size_t i = 0; i < WORDS; i++) {
+            raw[i] = words[i].load(std::memory_order_relaxed);
+        }
+    }
+
+    // 接管LoadRaw读出的任务
+    void Adopt(const uint64_t* raw) {
+        Reset_();
+        memcpy(static_cast<void*>(this), raw, WORDS * sizeof(uint64_t));
+    }
+
+private:
+    template<class Fn>
+    Fn* Heap_() {
+        Fn* p;
+        memcpy(&p, storage_, sizeof(p));
+        return p;
+    }
+
+    void MoveFrom_(Task& other) {
+        invoke_ = other.invoke_;
+        destroy_ = other.destroy_;
+        memcpy(storage_, other.storage_, INLINE_SIZE);
+        other.invoke_ = nullptr;
+        other.destroy_ = nullptr;
+    }
+
+    void Reset_() {
+        if(destroy_) {
+            destroy_(*this);
+        }
+        invoke_ = nullptr;
+        destroy_ = nullptr;
+    }
+
+    void (*invoke_)(Task&);
+    void (*destroy_)(Task&);        // 内部存放的对象不需要析构时为nullptr
+    alignas(uint64_t) unsigned char storage_[INLINE_SIZE];
+};
+
+static_assert(sizeof(Task) == Task::WORDS * sizeof(uint64_t), "Task must be 64 bytes");
+
+#endif
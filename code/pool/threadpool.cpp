@@ -0,0 +1,347 @@
+#include "threadpool.h"
+
+const int64_t TaskDeque::CAPACITY;
+const size_t ThreadPool::INJECT_BATCH;
+const int ThreadPool::PARK_MS;
+
+// 当前线程所属的线程池和下标，工作线程提交任务时直接放进自己的队列
+static thread_local const void* tlsPool = nullptr;
+static thread_local size_t tlsIndex = 0;
+
+/*
+C11内存模型下的Chase-Lev(Lê et al. 2013)：
+Push先写任务再release发布bottom；Pop先减bottom再用seq_cst栅栏与Steal读top/bottom排序，
+只剩最后一个任务时和Steal一样用CAS抢top
+*/
+bool TaskDeque::Push(Task& task) {
+    int64_t b = bottom_.load(std::memory_order_relaxed);
+    int64_t t = top_.load(std::memory_order_acquire);
+    if(b - t >= CAPACITY) {
+        return false;
+    }
+    task.StoreTo(slots_[b & (CAPACITY - 1)].words);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom_.store(b + 1, std::memory_order_relaxed);
+    return true;
+}
+
+bool TaskDeque::Pop(Task& task) {
+    int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+    bottom_.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top_.load(std::memory_order_relaxed);
+    if(t > b) {
+        bottom_.store(b + 1, std::memory_order_relaxed);
+        return false;
+    }
+    uint64_t raw[Task::WORDS];
+    Task::LoadRaw(slots_[b & (CAPACITY - 1)].words, raw);
+    if(t == b) {
+        bool won = top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                                std::memory_order_relaxed);
+        bottom_.store(b + 1, std::memory_order_relaxed);
+        if(!won) {
+            return false;
+        }
+    }
+    task.Adopt(raw);
+    return true;
+}
+
+bool TaskDeque::Steal(Task& task) {
+    int64_t t = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = bottom_.load(std::memory_order_acquire);
+    if(t >= b) {
+        return false;
+    }
+    // CAS成功前这个槽不会被覆盖：所属线程要写到这里，必须先看到top_越过t
+    uint64_t raw[Task::WORDS];
+    Task::LoadRaw(slots_[t & (CAPACITY - 1)].words, raw);
+    if(!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                     std::memory_order_relaxed)) {
+        return false;
+    }
+    task.Adopt(raw);
+    return true;
+}
+
+ThreadPool::ThreadPool(size_t threadCount, const std::string& name, const std::vector<int>& cpus) :
+    pool_(new Pool()) {
+    assert(threadCount > 0);
+    pool_->name = name;
+    pool_->cpus = cpus;
+    pool_->lanes[LOW].limit = std::max<size_t>(1, threadCount / 2);
+    for(size_t i = 0; i < threadCount; i++) {
+        pool_->workers.emplace_back(new Worker());
+    }
+    // 所有Worker创建完再启动线程，窃取时会遍历workers
+    for(size_t i = 0; i < threadCount; i++) {
+        pool_->workers[i]->thread = std::thread(&Pool::Run, pool_.get(), i);
+    }
+}
+
+// 标记关闭后唤醒所有线程；工作线程把剩余任务执行完才退出
+ThreadPool::~ThreadPool() {
+    if(!pool_) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> locker(pool_->parkMtx);
+        pool_->isClosed = true;
+    }
+    pool_->parkCond.notify_all();
+    for(auto& worker : pool_->workers) {
+        if(worker->thread.joinable()) {
+            worker->thread.join();
+        }
+    }
+}
+
+void ThreadPool::SetLaneLimit(PRIORITY pri, size_t n) {
+    {
+        // 和PopInject_检查limit互斥，避免running计数和Limited()的判断不一致
+        std::lock_guard<std::mutex> locker(pool_->injectMtx);
+        pool_->lanes[pri].limit = std::max<size_t>(1, n);
+    }
+    pool_->Wake(pool_->workers.size());
+}
+
+ThreadPool::LaneStats ThreadPool::Stats(PRIORITY pri) const {
+    const Lane& lane = pool_->lanes[pri];
+    LaneStats st;
+    st.depth = lane.size.load(std::memory_order_relaxed);
+    st.submitted = lane.submitted.load(std::memory_order_relaxed);
+    st.executed = lane.executed.load(std::memory_order_relaxed);
+    st.expired = lane.expired.load(std::memory_order_relaxed);
+    st.waitAvgUs = st.executed ? lane.waitNs.load(std::memory_order_relaxed) / st.executed / 1000 : 0;
+    st.waitMaxUs = lane.waitMaxNs.load(std::memory_order_relaxed) / 1000;
+    return st;
+}
+
+void ThreadPool::Pool::Push(Task& task, PRIORITY pri, int64_t deadlineNs, Task& onExpire) {
+    // 工作线程内提交且不需要超时、不受限：放进自己的队列，满了再放注入队列
+    if(tlsPool == this && deadlineNs == 0 && !Limited(pri) && workers[tlsIndex]->deque.Push(task)) {
+        Wake(1);
+        return;
+    }
+    int64_t now = NowNs();
+    Lane& lane = lanes[pri];
+    {
+        std::lock_guard<std::mutex> locker(injectMtx);
+        lane.queue.push_back(Entry{std::move(task), std::move(onExpire), now, deadlineNs});
+        lane.size.fetch_add(1, std::memory_order_relaxed);
+        lane.submitted.fetch_add(1, std::memory_order_relaxed);
+        injectSize.fetch_add(1, std::memory_order_seq_cst);
+    }
+    Wake(1);
+}
+
+void ThreadPool::Pool::PushBatch(std::vector<Task>& tasks, PRIORITY pri) {
+    if(tasks.empty()) {
+        return;
+    }
+    int64_t now = NowNs();
+    Lane& lane = lanes[pri];
+    {
+        std::lock_guard<std::mutex> locker(injectMtx);
+        for(auto& task : tasks) {
+            lane.queue.push_back(Entry{std::move(task), Task(), now, 0});
+        }
+        lane.size.fetch_add(tasks.size(), std::memory_order_relaxed);
+        lane.submitted.fetch_add(tasks.size(), std::memory_order_relaxed);
+        injectSize.fetch_add(tasks.size(), std::memory_order_seq_cst);
+    }
+    Wake(tasks.size());
+}
+
+// 与Run中的idle/HasWork_构成Dekker式的检查：先发布任务再读idle，不会丢失唤醒
+void ThreadPool::Pool::Wake(size_t n) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int idleCnt = idle.load(std::memory_order_seq_cst);
+    if(idleCnt <= 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> locker(parkMtx);
+    if(n >= static_cast<size_t>(idleCnt)) {
+        parkCond.notify_all();
+    } else {
+        for(size_t i = 0; i < n; i++) {
+            parkCond.notify_one();
+        }
+    }
+}
+
+// 受限通道的线程数已满时，它排队的任务不算可执行的任务，否则空闲线程会一直空转
+bool ThreadPool::Pool::HasWork_() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(injectSize.load(std::memory_order_seq_cst) > 0) {
+        for(int pri = 0; pri < PRIORITY_COUNT; pri++) {
+            const Lane& lane = lanes[pri];
+            if(lane.size.load(std::memory_order_relaxed) > 0 &&
+               lane.running.load(std::memory_order_relaxed) < lane.limit.load(std::memory_order_relaxed)) {
+                return true;
+            }
+        }
+    }
+    for(auto& worker : workers) {
+        if(worker->deque.Size() > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// 取出时检查是否超时，没超时则记录等待时间
+bool ThreadPool::Pool::Take_(Lane& lane, Entry& entry, int64_t now) {
+    if(entry.deadlineNs != 0 && now > entry.deadlineNs) {
+        lane.expired.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    uint64_t wait = now > entry.enqueueNs ? now - entry.enqueueNs : 0;
+    lane.executed.fetch_add(1, std::memory_order_relaxed);
+    lane.waitNs.fetch_add(wait, std::memory_order_relaxed);
+    uint64_t max = lane.waitMaxNs.load(std::memory_order_relaxed);
+    while(wait > max && !lane.waitMaxNs.compare_exchange_weak(max, wait, std::memory_order_relaxed)) {
+    }
+    return true;
+}
+
+/*
+从优先级最高的非空通道取出第一个任务直接执行：
+1、不受限的通道另外按线程数平分取一批放进自己的队列，倒序放入，这样Pop(后进先出)出来仍是提交的顺序
+2、受限的通道只取一个，running加一，执行完由Run减一；已经满了就跳过这个通道
+已超时的任务换成它的onExpire；lane返回需要在执行后减running的通道，否则为-1
+*/
+bool ThreadPool::Pool::PopInject_(Worker& self, Task& task, int& lane) {
+    lane = -1;
+    if(injectSize.load(std::memory_order_relaxed) == 0) {
+        return false;
+    }
+    Entry first;
+    Entry batch[INJECT_BATCH];
+    size_t n = 0;
+    int pri = 0;
+    bool limited = false;
+    {
+        std::lock_guard<std::mutex> locker(injectMtx);
+        for(; pri < PRIORITY_COUNT; pri++) {
+            Lane& l = lanes[pri];
+            if(l.queue.empty()) {
+                continue;
+            }
+            limited = Limited(pri);
+            if(limited && l.running.load(std::memory_order_relaxed) >= l.limit.load(std::memory_order_relaxed)) {
+                continue;
+            }
+            first = std::move(l.queue.front());
+            l.queue.pop_front();
+            if(limited) {
+                l.running.fetch_add(1, std::memory_order_relaxed);
+            } else {
+                size_t share = std::min(l.queue.size() / workers.size(), INJECT_BATCH);
+                for(; n < share; n++) {
+                    batch[n] = std::move(l.queue.front());
+                    l.queue.pop_front();
+                }
+            }
+            l.size.fetch_sub(n + 1, std::memory_order_relaxed);
+            injectSize.fetch_sub(n + 1, std::memory_order_relaxed);
+            break;
+        }
+    }
+    if(pri == PRIORITY_COUNT) {
+        return false;
+    }
+    Lane& l = lanes[pri];
+    int64_t now = NowNs();
+    for(size_t i = n; i > 0; i--) {
+        Entry& e = batch[i - 1];
+        if(!Take_(l, e, now)) {
+            if(e.onExpire) {
+                e.onExpire();
+            }
+            continue;
+        }
+        if(!self.deque.Push(e.task)) {
+            // 自己的队列满了(大多是任务内提交的任务)，放回通道最前面
+            std::lock_guard<std::mutex> locker(injectMtx);
+            l.queue.push_front(Entry{std::move(e.task), Task(), now, 0});
+            l.size.fetch_add(1, std::memory_order_relaxed);
+            injectSize.fetch_add(1, std::memory_order_seq_cst);
+        }
+    }
+    if(n > 0) {
+        Wake(n);
+    }
+    if(limited) {
+        lane = pri;
+    }
+    // 超时时执行onExpire代替任务；onExpire为空时task为空
+    task = Take_(l, first, now) ? std::move(first.task) : std::move(first.onExpire);
+    return true;
+}
+
+bool ThreadPool::Pool::Steal_(size_t self, unsigned& seed, Task& task) {
+    size_t n = workers.size();
+    if(n <= 1) {
+        return false;
+    }
+    // xorshift选一个起点，避免所有空闲线程都去窃取同一个线程
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    size_t start = seed % n;
+    for(size_t k = 0; k < n; k++) {
+        size_t victim = (start + k) % n;
+        if(victim != self && workers[victim]->deque.Steal(task)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::Pool::Run(size_t index) {
+    tlsPool = this;
+    tlsIndex = index;
+    Affinity::SetName(name + "-" + std::to_string(index));
+    Affinity::Bind(cpus);
+    Worker& self = *workers[index];
+    unsigned seed = static_cast<unsigned>(index) * 2654435761u + 1;
+    int spins = 0;
+    while(true) {
+        Task task;
+        int lane = -1;
+        if(self.deque.Pop(task) || PopInject_(self, task, lane) || Steal_(index, seed, task)) {
+            if(task) {
+                task();
+            }
+            if(lane >= 0) {
+                // 受限通道空出一个位置，它排队的任务可能有线程在等
+                lanes[lane].running.fetch_sub(1, std::memory_order_seq_cst);
+                if(lanes[lane].size.load(std::memory_order_relaxed) > 0) {
+                    Wake(1);
+                }
+            }
+            spins = 0;
+            continue;
+        }
+        if(isClosed.load(std::memory_order_acquire) && !HasWork_()) {
+            break;
+        }
+        // 先自旋：任务往往马上就来，避免休眠和唤醒的系统调用
+        if(++spins < SPIN_ROUNDS) {
+            std::this_thread::yield();
+            continue;
+        }
+        spins = 0;
+        std::unique_lock<std::mutex> locker(parkMtx);
+        idle.fetch_add(1, std::memory_order_seq_cst);
+        // 最多休眠PARK_MS，醒来后重新找一遍任务
+        parkCond.wait_for(locker, std::chrono::milliseconds(PARK_MS), [this] {
+            return HasWork_() || isClosed.load(std::memory_order_relaxed);
+        });
+        idle.fetch_sub(1, std::memory_order_relaxed);
+    }
+    tlsPool = nullptr;
+}
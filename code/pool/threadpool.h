@@ -1,96 +1,198 @@
-#ifndef THREADPOOL.H
-#define THREADPOOL.J
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
 
 #include <cassert>
+#include <cstdint>
+#include <chrono>
 #include <mutex>
 #include <thread>
 #include <condition_variable>
-#include <functional>
-#include <queue>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+#include "task.h"
+#include "affinity.h"
 
-class ThreadPool {
+/*
+TaskDeque：Chase-Lev工作窃取队列(固定容量)
+1、只有所属的工作线程在底部Push/Pop(后进先出，缓存里的数据还是热的)
+2、其他线程在顶部Steal(先进先出)，与Pop竞争最后一个任务时用CAS决定归属
+3、任务按字节存放在原子字中，窃取方先读出字节再CAS，成功才接管
+*/
+class TaskDeque {
 public:
-    // 初始化pool_指针
-    explicit ThreadPool(size_t threadCount = 8) : pool_(std::make_shared<Pool>()) {
-        assert(threadCount > 0);
-        // 创建工作线程
-        for(size_t i = 0; i < threadCount; i++) { 
-            // thread的构造函数接受可调用对象(此处为Lambda)作为线程的入口函数
-            std::thread([pool = pool_] {
-                std::unique_lock<std::mutex> locker(pool->mtx);
-                while(true) {
-                    if(!pool->tasks.empty()) {
-                        auto task = pool->tasks.front();
-                        pool->tasks.pop();
-                        locker.unlock();
-                        // 此时释放锁，这样其他线程也可操作队列，否则只能串行执行任务
-                        task();
-                        locker.lock();
-                    }
-                    else if(pool->isClosed) {
-                        break;
-                    }
-                    // 任务队列为空
-                    else pool->cond.wait(locker);   // 释放锁并阻塞当前线程(直到被notify唤醒)
-                }
-            }).detach();    // 工作子线程独立运行，和ThreadPool这一主线程独立开来
-        }
+    static const int64_t CAPACITY = 256;
+
+    TaskDeque() : top_(0), bottom_(0) {}
+
+    bool Push(Task& task);      // 队列满返回false，task保持不变
+    bool Pop(Task& task);
+    bool Steal(Task& task);     // 队列空或与其他线程竞争失败返回false
+
+    int64_t Size() const {
+        int64_t b = bottom_.load(std::memory_order_relaxed);
+        int64_t t = top_.load(std::memory_order_relaxed);
+        return b > t ? b - t : 0;
     }
-    
-    ThreadPool() = default;   // 运行创建对象时不传参数
+
+private:
+    struct Slot {
+        std::atomic<uint64_t> words[Task::WORDS];
+    };
+
+    alignas(64) std::atomic<int64_t> top_;      // 窃取端
+    alignas(64) std::atomic<int64_t> bottom_;   // 所属线程端
+    alignas(64) Slot slots_[CAPACITY];
+};
+
+/*
+ThreadPool：工作窃取线程池
+1、每个工作线程有自己的TaskDeque；工作线程内提交的任务放进自己的队列
+2、外部线程(Reactor)提交的任务按优先级放进注入队列(HIGH/NORMAL/LOW三条通道)；
+   工作线程一次从中取一批放进自己的队列，减少抢锁次数
+3、工作线程找任务的顺序：自己的队列 -> 注入队列(按优先级) -> 随机选其他线程窃取；
+   都没有时先自旋一会，再在条件变量上休眠；提交任务时只有存在休眠线程才去加锁唤醒
+4、析构时等待所有已提交的任务执行完，再join工作线程
+5、工作线程命名为name-编号；cpus不为空时工作线程只在这些CPU上运行(一般是一个NUMA节点的所有CPU)
+6、通道可以限制同时执行的线程数(SetLaneLimit)：LOW默认最多占一半线程，慢任务(数据库登录)再多也留出线程给其他通道
+   受限的通道一次只取一个任务，不放进工作线程自己的队列
+7、提交时可以指定超时：执行前已超时的任务不再执行，改为执行onExpire(可以为空)
+8、Stats()：各通道的排队数、提交/执行/超时数和排队等待时间；工作线程内提交到自己队列的任务不经过通道，不计入
+*/
+class ThreadPool {
+public:
+    enum PRIORITY {
+        HIGH = 0,
+        NORMAL,
+        LOW,
+        PRIORITY_COUNT,
+    };
+
+    struct LaneStats {
+        size_t depth;           // 当前排队的任务数
+        uint64_t submitted;
+        uint64_t executed;      // 从通道取出执行的任务数(不含超时丢弃的)
+        uint64_t expired;       // 超时丢弃的任务数
+        uint64_t waitAvgUs;     // 从提交到取出的平均等待时间
+        uint64_t waitMaxUs;
+    };
+
+    explicit ThreadPool(size_t threadCount = 8, const std::string& name = "worker",
+                        const std::vector<int>& cpus = {});
 
     /*
     默认移动构造函数
     ThreadPool pool1(4);  // pool1是智能指针，只能移动不能复制
     ThreadPool pool2 = std::move(pool1);  // 调用移动构造函数
     */
-    ThreadPool(ThreadPool&&) = default;   
-
-    // 析构的流程是：关闭pool_后，改变标识符，唤醒所阻塞线程(else pool->cond.wait(locker))，再检查else函数后break
-    ~ThreadPool() {
-        if(pool_) {
-            std::lock_guard<std::mutex> locker(pool_->mtx);
-            pool_->isClosed = false;
-        }
-        pool_->cond.notify_all();
-    }
-
+    ThreadPool(ThreadPool&&) = default;
 
+    ~ThreadPool();
 
     /*
     F&& task是一个通用引用(C++11特性)，用于实现完美转发
     传入左值，自动推导为左值引用(F&)
     传入右值(临时对象-返回值；字面量-int x = 1, 这里的1；move转换结果； Lambda表达式)，自动推导为右值引用(F&&)
-
-    move：移动语义，高效转移资源，避免拷贝   int a = 1;  int b = move(a) ——> a本是左值，但被move转为右值了
-    forward：完美转发，保持参数的左值/右值的原有属性
     */
     template<class F>
-    void AddTask(F&& task) {
-        {
-            std::lock_guard<std::mutex> locker(pool_->mtx);
-            pool_->tasks.emplace(std::forward<F>(task));
-        }
-        pool_->cond.notify_one();    // 唤醒一个等待的工作线程
+    void AddTask(F&& task, PRIORITY pri = NORMAL) {
+        Task t(std::forward<F>(task));
+        Task none;
+        pool_->Push(t, pri, 0, none);
+    }
+
+    // timeoutMS > 0：超过timeoutMS还没开始执行就丢弃task，改为执行onExpire
+    template<class F, class G>
+    void AddTask(F&& task, PRIORITY pri, int timeoutMS, G&& onExpire) {
+        Task t(std::forward<F>(task));
+        Task expire(std::forward<G>(onExpire));
+        pool_->Push(t, pri, timeoutMS > 0 ? Pool::NowNs() + timeoutMS * 1000000LL : 0, expire);
+    }
+
+    // 批量提交：只加一次锁，按空闲线程数唤醒
+    void AddTasks(std::vector<Task>& tasks, PRIORITY pri = NORMAL) {
+        pool_->PushBatch(tasks, pri);
+        tasks.clear();
+    }
+
+    // 通道pri最多同时占用n个工作线程(至少1个)，n >= 线程数表示不限制
+    void SetLaneLimit(PRIORITY pri, size_t n);
+    LaneStats Stats(PRIORITY pri) const;
+
+    size_t ThreadCount() const {
+        return pool_->workers.size();
     }
 
 private:
-    // 封装线程池的共享状态
+    struct Worker {
+        TaskDeque deque;
+        std::thread thread;
+    };
+
+    // 注入队列中的任务：带提交时间(统计等待时间)和截止时间
+    struct Entry {
+        Task task;
+        Task onExpire;
+        int64_t enqueueNs;
+        int64_t deadlineNs;     // 0表示不超时
+    };
+
+    // 一条优先级通道；queue由injectMtx保护，计数器可以不加锁读
+    struct Lane {
+        std::deque<Entry> queue;
+        std::atomic<size_t> size{0};
+        std::atomic<size_t> running{0};     // 受限通道正在执行的任务数
+        std::atomic<size_t> limit{SIZE_MAX};
+        std::atomic<uint64_t> submitted{0};
+        std::atomic<uint64_t> executed{0};
+        std::atomic<uint64_t> expired{0};
+        std::atomic<uint64_t> waitNs{0};
+        std::atomic<uint64_t> waitMaxNs{0};
+    };
+
+    // 线程池的共享状态；工作线程持有Pool*，ThreadPool移动时不受影响
     struct Pool {
-        bool isClosed;
-        std::mutex mtx;
-        std::condition_variable cond;
-        std::queue<std::function<void()>> tasks;   // 任务是无参数、无返回的可调用对象
+        std::vector<std::unique_ptr<Worker>> workers;
+        std::string name;
+        std::vector<int> cpus;
+
+        std::mutex injectMtx;
+        Lane lanes[PRIORITY_COUNT];             // 注入队列，按优先级
+        std::atomic<size_t> injectSize{0};      // 所有通道排队的任务数
+
+        std::mutex parkMtx;
+        std::condition_variable parkCond;
+        std::atomic<int> idle{0};               // 休眠的工作线程数
+        std::atomic<bool> isClosed{false};
+
+        void Push(Task& task, PRIORITY pri, int64_t deadlineNs, Task& onExpire);
+        void PushBatch(std::vector<Task>& tasks, PRIORITY pri);
+        void Run(size_t index);
+        void Wake(size_t n);       // 有休眠的线程时唤醒最多n个
+
+        bool Limited(int pri) const {
+            return lanes[pri].limit.load(std::memory_order_relaxed) < workers.size();
+        }
+
+        static int64_t NowNs() {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+    private:
+        bool PopInject_(Worker& self, Task& task, int& lane);
+        bool Take_(Lane& lane, Entry& entry, int64_t now);
+        bool Steal_(size_t self, unsigned& seed, Task& task);
+        bool HasWork_();
     };
-    /*
-    管理线程池的共享状态（Pool结构体）
-        1、所有线程（工作线程、主线程）安全访问同一 Pool实例（如任务队列、关闭标志）
-        2、当最后一个引用 pool_的线程结束时，自动释放 Pool对象
-        3、通过 shared_ptr的原子引用计数，保证 Pool的析构时机正确
-    */
-    std::shared_ptr<Pool> pool_;
 
+    static const int SPIN_ROUNDS = 64;      // 休眠前自旋找任务的次数
+    static const size_t INJECT_BATCH = 32;  // 一次从注入队列取出的最大任务数
+    static const int PARK_MS = 100;         // 单次休眠的最长时间
 
+    std::unique_ptr<Pool> pool_;
 };
 
-#endif
\ No newline at end of file
+#endif
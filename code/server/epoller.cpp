@@ -1,4 +1,5 @@
 #include "epoller.h"
+#include <algorithm>
 
 /*
 int epoll_create(int size);         // 成功返回文件描述符，失败返回-1且设置errno
@@ -19,8 +20,10 @@ size_t​​      std::vector::size()     表示内存/容器大小的无符号
 ​​int​​         epoll_wait()            系统调用的错误码兼容性
 */
 
-Epoller::Epoller(int maxEvent) : epollFd_(epoll_create(512)), events_(maxEvent) {
-    assert(epollFd_ >= 0 && events_.size() >= 0);
+const size_t Epoller::MAX_EVENTS;
+
+Epoller::Epoller(int maxEvent) : epollFd_(epoll_create(512)), readyCnt_(0), events_(maxEvent) {
+    assert(epollFd_ >= 0 && events_.size() > 0);
 }
 
 Epoller::~Epoller() {
@@ -29,18 +32,27 @@ Epoller::~Epoller() {
 
 // 注册监听事件,传进来的这个events是指监听事件类型
 bool Epoller::AddFd(int fd, uint32_t events) {
+    return AddFd(fd, events, static_cast<uint64_t>(fd));
+}
+
+// epoll_data是联合体：token和fd共用，事件返回时原样带回
+bool Epoller::AddFd(int fd, uint32_t events, uint64_t token) {
     if(fd < 0) return false;
     struct epoll_event ev = {0};
-    ev.data.fd = fd;
+    ev.data.u64 = token;
     ev.events = events;
     return 0 == epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd, &ev);
 }
 
 bool Epoller::ModFd(int fd, uint32_t events) {
+    return ModFd(fd, events, static_cast<uint64_t>(fd));
+}
+
+bool Epoller::ModFd(int fd, uint32_t events, uint64_t token) {
     if(fd < 0) return false;
     struct epoll_event ev = {0};
-    ev.data.fd = fd;
-    ev.events =events;
+    ev.data.u64 = token;
+    ev.events = events;
     return 0 == epoll_ctl(epollFd_, EPOLL_CTL_MOD, fd, &ev);
 }
 
@@ -50,19 +62,27 @@ bool Epoller::DelFd(int fd) {
     return 0 == epoll_ctl(epollFd_, EPOLL_CTL_DEL, fd, &ev);
 }
 
-// 返回就绪文件描述符个数
+// 返回就绪文件描述符个数；上一轮把数组填满了说明还有事件没取到，先扩容
 int Epoller::Wait(int timeoutMs) {
-    return epoll_wait(epollFd_, &events_[0], static_cast<int>(events_.size()), timeoutMs);
-} 
+    if(readyCnt_ == events_.size() && events_.size() < MAX_EVENTS) {
+        events_.resize(std::min(events_.size() * 2, MAX_EVENTS));
+    }
+    int n = epoll_wait(epollFd_, &events_[0], static_cast<int>(events_.size()), timeoutMs);
+    readyCnt_ = n > 0 ? n : 0;
+    return n;
+}
 
 int Epoller::GetEventFd(size_t i) const {
-    assert(i >= 0 && i < events_.size());
+    assert(i < readyCnt_);
     return events_[i].data.fd;
 }
 
+uint64_t Epoller::GetToken(size_t i) const {
+    assert(i < readyCnt_);
+    return events_[i].data.u64;
+}
+
 uint32_t Epoller::GetEvents(size_t i) const {
-    assert(i >= 0 && i < events_.size());
+    assert(i < readyCnt_);
     return events_[i].events;
 }
-
-
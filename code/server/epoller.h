@@ -0,0 +1,67 @@
+#ifndef EPOLLER_H
+#define EPOLLER_H
+
+#include <sys/epoll.h>  // epoll_create, epoll_ctl, epoll_wait
+#include <fcntl.h>      // fcntl()
+#include <unistd.h>     // close()
+#include <assert.h>
+#include <stdint.h>
+#include <vector>
+#include <errno.h>
+
+/*Epoller：对epoll三个系统调用的简单封装
+每个SubReactor独占一个Epoller，因此这里不需要加锁(epoll_ctl本身是线程安全的)
+1、注册时可以带一个64位的token(放在epoll_data里)，事件返回时原样带回；
+   SubReactor用连接在连接Slab中的句柄(代数|槽位下标)作token，处理事件时不用再按fd查连接表，
+   连接关闭后晚到的事件也能按代数识别出来。不指定时token就是fd
+2、Wait()之后用Ready()遍历本轮的就绪事件：for(const epoll_event& ev : epoller.Ready())
+3、一轮事件把数组填满时，下一次Wait()之前扩容(最多MAX_EVENTS)，突发的连接不用分好几轮取
+4、多个Epoller共享一个监听socket时用AddFd(fd, EPOLLIN | EPOLLEXCLUSIVE, ...)，新连接只唤醒其中一个*/
+class Epoller {
+public:
+    // 最近一次Wait()返回的就绪事件，可以用范围for遍历
+    class Batch {
+    public:
+        Batch(const struct epoll_event* first, size_t n) : first_(first), n_(n) {}
+        const struct epoll_event* begin() const {
+            return first_;
+        }
+        const struct epoll_event* end() const {
+            return first_ + n_;
+        }
+        size_t size() const {
+            return n_;
+        }
+    private:
+        const struct epoll_event* first_;
+        size_t n_;
+    };
+
+    explicit Epoller(int maxEvent = 1024);
+    ~Epoller();
+
+    bool AddFd(int fd, uint32_t events);    // 注册fd，token为fd
+    bool AddFd(int fd, uint32_t events, uint64_t token);
+    bool ModFd(int fd, uint32_t events);    // 修改fd监听的事件，token为fd
+    bool ModFd(int fd, uint32_t events, uint64_t token);
+    bool DelFd(int fd);                     // 移除fd
+
+    int Wait(int timeoutMs = -1);           // 等待就绪事件，返回就绪个数
+
+    Batch Ready() const {
+        return Batch(events_.data(), readyCnt_);
+    }
+
+    int GetEventFd(size_t i) const;         // 第i个就绪事件的fd(token为fd时)
+    uint64_t GetToken(size_t i) const;      // 第i个就绪事件的token
+    uint32_t GetEvents(size_t i) const;     // 第i个就绪事件的事件类型
+
+    static const size_t MAX_EVENTS = 16384;
+
+private:
+    int epollFd_;
+    size_t readyCnt_;
+    std::vector<struct epoll_event> events_;    // 就绪事件数组
+};
+
+#endif
@@ -0,0 +1,1022 @@
+#define LOG_MODULE Log::SERVER
+#include "subreactor.h"
+
+int SubReactor::slowTimeoutMS = 3000;
+size_t SubReactor::connReserve = 1024;
+
+SubReactor::SubReactor(int id, int port, int trigMode, int timeoutMS,
+                       bool optLinger, ThreadPool* threadpool, int timerMode) :
+    id_(id), cpu_(-1), coroutine_(false), ioMode_(0), port_(port), timeoutMS_(timeoutMS), openLinger_(optLinger), isClose_(false),
+    listenFd_(-1), sharedListenFd_(-1), wakeupFd_(-1), threadpool_(threadpool), epoller_(new Epoller()) {
+    InitEventMode_(trigMode);
+    // 连接数很多时用时间轮：刷新超时是O(1)的链表操作，没有哈希查找和堆调整
+    // 惰性小根堆：活跃连接刷新超时不调整堆
+    if(timerMode == 1) {
+        timer_.reset(new TimingWheel());
+    } else {
+        timer_.reset(new HeapTimer(timerMode == 2));
+    }
+}
+
+SubReactor::~SubReactor() {
+#ifdef URING_ENABLED
+    // 关闭所有连接，等它们未完成的请求结束(最多1秒)，之后才能释放连接和缓冲区
+    if(uring_) {
+        // 线程池已经先析构，验证任务都已结束，先把交回的连接收回来
+        DealFinished_();
+        std::vector<int> fds;
+        for(auto& kv : uringConns_) {
+            fds.push_back(kv.first);
+        }
+        for(int fd : fds) {
+            UringClose_(fd);
+        }
+        for(int i = 0; i < 100 && !uringConns_.empty(); i++) {
+            HandleUring_(uring_->Wait(10));
+        }
+    }
+#endif
+#ifdef CORO_ENABLED
+    // 还挂起的连接协程以取消恢复，关闭连接后结束，释放协程帧
+    // 线程池已经先析构，验证任务都已结束，等着恢复的协程在resumed_里
+    if(io_) {
+        DealFinished_();
+        io_->CancelAll();
+        io_->RunReady();
+    }
+#endif
+    if(listenFd_ >= 0 && listenFd_ != sharedListenFd_) {
+        close(listenFd_);
+    }
+    if(wakeupFd_ >= 0) {
+        close(wakeupFd_);
+    }
+}
+
+/*
+listenEvent_：监听socket关注的事件
+connEvent_：连接socket关注的事件
+EPOLLONESHOT：一个连接同一时刻只会被一个线程处理，处理完后需要ModFd重新注册
+EPOLLRDHUP：对端关闭连接
+*/
+void SubReactor::InitEventMode_(int trigMode) {
+    listenEvent_ = EPOLLRDHUP;
+    connEvent_ = EPOLLONESHOT | EPOLLRDHUP;
+    switch(trigMode)
+    {
+    case 0:
+        break;
+    case 1:
+        connEvent_ |= EPOLLET;
+        break;
+    case 2:
+        listenEvent_ |= EPOLLET;
+        break;
+    case 3:
+        listenEvent_ |= EPOLLET;
+        connEvent_ |= EPOLLET;
+        break;
+    default:
+        listenEvent_ |= EPOLLET;
+        connEvent_ |= EPOLLET;
+        break;
+    }
+    HttpConn::isET = (connEvent_ & EPOLLET);
+}
+
+bool SubReactor::Init() {
+    // EFD_NONBLOCK：读空时直接返回，不会阻塞loop
+    wakeupFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(wakeupFd_ < 0) {
+        LOG_ERROR("Reactor[%d] create eventfd error!", id_);
+        return false;
+    }
+    if(!epoller_->AddFd(wakeupFd_, EPOLLIN, WAKEUP_TOKEN)) {
+        LOG_ERROR("Reactor[%d] add eventfd error!", id_);
+        return false;
+    }
+    if(ioMode_ == 1) {
+#ifdef URING_ENABLED
+        uring_.reset(new Uring(URING_ENTRIES));
+        if(!uring_->Init() || !uring_->SetupBufRing(URING_BGID, URING_BUF_COUNT, URING_BUF_SIZE)) {
+            LOG_WARN("Reactor[%d] io_uring unavailable(errno %d), use epoll", id_, errno);
+            uring_.reset();
+            ioMode_ = 0;
+        } else if(coroutine_) {
+            LOG_WARN("Reactor[%d] io_uring mode ignores coroutine", id_);
+            coroutine_ = false;
+        }
+#else
+        LOG_WARN("Reactor[%d] built without io_uring support, use epoll", id_);
+        ioMode_ = 0;
+#endif
+    }
+    if(coroutine_) {
+#ifdef CORO_ENABLED
+        io_.reset(new IoContext(epoller_.get(), timer_.get(), connEvent_));
+#else
+        LOG_WARN("Reactor[%d] built without coroutine support (needs C++20), use callbacks", id_);
+        coroutine_ = false;
+#endif
+    }
+    return InitSocket_();
+}
+
+/*
+事件循环：
+1、根据定时器计算epoll_wait的超时时间
+2、epoll_wait返回后刷新定时器缓存的当前时间，再处理就绪事件
+3、本轮的读写任务批量提交给线程池
+4、Stop()写eventfd后，epoll_wait返回，循环退出
+*/
+void SubReactor::Loop() {
+    int timeMS = -1;    // -1表示无事件时一直阻塞
+    Affinity::SetName("reactor-" + std::to_string(id_));
+    if(cpu_ >= 0 && !Affinity::Bind(cpu_)) {
+        LOG_WARN("Reactor[%d] bind cpu %d error!", id_, cpu_);
+    }
+    LOG_INFO("Reactor[%d] loop start, cpu: %d", id_, cpu_);
+    // 绑核之后再分配，槽位的内存在本节点上
+    if(!conns_.Reserve(connReserve)) {
+        LOG_WARN("Reactor[%d] reserve %zu connections error!", id_, connReserve);
+    }
+#ifdef URING_ENABLED
+    if(uring_) {
+        UringLoop_();
+        LOG_INFO("Reactor[%d] loop quit, io_uring_enter calls: %u", id_, uring_->SubmitCount());
+        return;
+    }
+#endif
+    while(!isClose_) {
+        // 处理上一轮事件、线程池交回的任务都要花时间，先刷新时钟再算超时，到期的任务不会晚一轮才执行
+        if(timeoutMS_ > 0 || coroutine_) {
+            timer_->UpdateNow();
+            timeMS = timer_->GetNextTick();
+        }
+#ifdef CORO_ENABLED
+        // 定时器唤醒的协程(睡眠结束、连接超时)恢复后可能又添加了定时任务，重新计算超时时间
+        while(io_ && io_->RunReady() > 0) {
+            timer_->UpdateNow();
+            timeMS = timer_->GetNextTick();
+        }
+#endif
+        epoller_->Wait(timeMS);
+        // 每轮只读一次时钟，本轮处理事件时刷新超时都用这个时间
+        timer_->UpdateNow();
+        // 连接的token是Slab句柄，直接找回连接，不查连接表
+        for(const struct epoll_event& ev : epoller_->Ready()) {
+            uint64_t token = ev.data.u64;
+            uint32_t events = ev.events;
+            if(token == LISTEN_TOKEN) {
+                DealListen_();
+                continue;
+            }
+            if(token == WAKEUP_TOKEN) {
+                uint64_t one;
+                ::read(wakeupFd_, &one, sizeof(one));
+                DealFinished_();
+                continue;
+            }
+            HttpConn* client = conns_.Get(token);
+            if(!client) {
+                continue;   // 连接已经关闭，句柄失效
+            }
+#ifdef CORO_ENABLED
+            if(io_) {
+                // 协程模式：所有事件(包括挂断和错误)交给等待这个fd的协程，由它读写时发现并关闭连接
+                ExtentTime_(client);
+                io_->Dispatch(client->GetFd(), events);
+                continue;
+            }
+#endif
+            if(events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+                CloseConn_(client);
+            }
+            else if(events & EPOLLIN) {
+                DealRead_(client);
+            }
+            else if(events & EPOLLOUT) {
+                DealWrite_(client);
+            }
+            else {
+                LOG_ERROR("Reactor[%d] unexpected event", id_);
+            }
+        }
+        if(!pendingWrite_.empty()) {
+            threadpool_->AddTasks(pendingWrite_, ThreadPool::HIGH);
+        }
+        if(!pendingRead_.empty()) {
+            threadpool_->AddTasks(pendingRead_, ThreadPool::NORMAL);
+        }
+    }
+    LOG_INFO("Reactor[%d] loop quit", id_);
+}
+
+void SubReactor::Stop() {
+    isClose_ = true;
+    if(wakeupFd_ >= 0) {
+        uint64_t one = 1;
+        ::write(wakeupFd_, &one, sizeof(one));
+    }
+}
+
+void SubReactor::SendError_(int fd, const char* info) {
+    assert(fd > 0);
+    int ret = send(fd, info, strlen(info), 0);
+    if(ret < 0) {
+        LOG_WARN("send error to client[%d] error!", fd);
+    }
+    close(fd);
+}
+
+void SubReactor::CloseConn_(HttpConn* client) {
+    assert(client);
+    LOG_INFO("Client[%d] quit!", client->GetFd());
+    epoller_->DelFd(client->GetFd());
+    uint64_t token = client->Token();
+    client->Close();
+    // 清理完再归还槽位；之后旧句柄都找不到它，槽位可以给新连接
+    conns_.Release(token);
+}
+
+void SubReactor::AddClient_(int fd, sockaddr_in addr) {
+    assert(fd > 0);
+    Slab<HttpConn>::Handle token;
+    HttpConn* client = conns_.Acquire(&token);
+    if(!client) {
+        SendError_(fd, "Server busy!");
+        LOG_WARN("Reactor[%d] connection slab is full!", id_);
+        return;
+    }
+    client->init(fd, addr, token);
+    if(timeoutMS_ > 0) {
+        // 超时后在本Reactor线程内关闭连接；协程模式下取消协程的等待，由协程关闭
+        // 回调按句柄找连接：连接已经关闭、fd被新连接复用时什么也不做
+        if(ioMode_ == 1) {
+#ifdef URING_ENABLED
+            timer_->add(fd, timeoutMS_, [this, token] {
+                if(HttpConn* conn = conns_.Get(token)) {
+                    UringClose_(conn->GetFd());
+                }
+            });
+#endif
+        } else if(coroutine_) {
+#ifdef CORO_ENABLED
+            // 协程正等着线程池验证时fd上没有等待，Cancel不起作用，靠标记在恢复后关闭
+            timer_->add(fd, timeoutMS_, [this, token] {
+                if(HttpConn* conn = conns_.Get(token)) {
+                    conn->MarkClose();
+                    io_->Cancel(conn->GetFd());
+                }
+            });
+#endif
+        } else {
+            // 任务还在线程池中时只做标记，任务结束交回本线程时关闭
+            timer_->add(fd, timeoutMS_, [this, token] {
+                if(HttpConn* conn = conns_.Get(token)) {
+                    if(conn->IsBusy()) {
+                        conn->MarkClose();
+                    } else {
+                        CloseConn_(conn);
+                    }
+                }
+            });
+        }
+    }
+#ifdef URING_ENABLED
+    if(uring_) {
+        UringConn& uc = uringConns_[fd];
+        uc = UringConn();
+        uc.conn = token;
+        uc.pipe[0] = uc.pipe[1] = -1;
+        uc.recvArmed = true;
+        uc.inflight = 1;
+        uring_->PrepRecv(fd, URING_BGID, UringData_(URING_RECV, fd));
+        LOG_INFO("Reactor[%d] Client[%d] in!", id_, fd);
+        return;
+    }
+#endif
+    epoller_->AddFd(fd, EPOLLIN | connEvent_, token);
+    SetFdNonblock(fd);
+    LOG_INFO("Reactor[%d] Client[%d] in!", id_, fd);
+#ifdef CORO_ENABLED
+    if(io_) {
+        Spawn(Serve_(client));
+    }
+#endif
+}
+
+// 监听socket是本Reactor独占的，accept到的连接就归本Reactor管理
+void SubReactor::DealListen_() {
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    do {
+        int fd = accept(listenFd_, (struct sockaddr *)&addr, &len);
+        if(fd <= 0) {
+            return;
+        }
+        else if(HttpConn::userCount >= MAX_FD) {
+            SendError_(fd, "Server busy!");
+            LOG_WARN("Clients is full!");
+            return;
+        }
+        AddClient_(fd, addr);
+    } while(listenEvent_ & EPOLLET);
+}
+
+void SubReactor::DealRead_(HttpConn* client) {
+    assert(client);
+    ExtentTime_(client);
+    if(threadpool_) {
+        // busy期间连接不会被关闭，任务里按句柄一定能找到
+        client->SetBusy(true);
+        pendingRead_.emplace_back([this, token = client->Token()] {
+            if(HttpConn* conn = conns_.Get(token)) {
+                OnRead_(conn);
+            }
+        });
+    } else {
+        OnRead_(client);
+    }
+}
+
+void SubReactor::DealWrite_(HttpConn* client) {
+    assert(client);
+    ExtentTime_(client);
+    if(threadpool_) {
+        client->SetBusy(true);
+        pendingWrite_.emplace_back([this, token = client->Token()] {
+            if(HttpConn* conn = conns_.Get(token)) {
+                OnWrite_(conn);
+            }
+        });
+    } else {
+        OnWrite_(client);
+    }
+}
+
+// 有活动的连接延长超时时间；延迟关闭中的连接只再等LINGER_MS
+void SubReactor::ExtentTime_(HttpConn* client) {
+    assert(client);
+    if(timeoutMS_ > 0) {
+        timer_->adjust(client->GetFd(), client->Lingering() ? std::min(timeoutMS_, HttpConn::LINGER_MS) : timeoutMS_);
+    }
+}
+
+void SubReactor::OnRead_(HttpConn* client) {
+    assert(client);
+    int ret = -1;
+    int readErrno = 0;
+    ret = client->read(&readErrno);
+    // 对端关闭(ret == 0)或者读出错(非EAGAIN)
+    if(ret <= 0 && readErrno != EAGAIN) {
+        Finish_(client, 0);
+        return;
+    }
+    if(client->Lingering()) {
+        Finish_(client, client->Discard() ? static_cast<uint32_t>(EPOLLIN) : 0u);
+        return;
+    }
+    OnProcess_(client);
+}
+
+/*
+解析成功则关注写事件，否则继续等待数据
+没有线程池时直接在本线程验证用户；否则需要验证的请求提交到LOW通道，
+数据库慢的时候只占用LOW通道的线程，静态文件请求不受影响
+*/
+void SubReactor::OnProcess_(HttpConn* client, bool allowSlow) {
+    if(client->process(allowSlow || !threadpool_)) {
+        Finish_(client, EPOLLOUT);
+    } else if(client->HasSlowRequest()) {
+        SubmitSlow_(client);
+    } else {
+        Finish_(client, EPOLLIN);
+    }
+}
+
+// 连接保持busy，直到验证任务结束或排队超时，结果经Finish_交回Reactor线程
+void SubReactor::SubmitSlow_(HttpConn* client) {
+    uint64_t token = client->Token();
+    threadpool_->AddTask([this, token] {
+        if(HttpConn* conn = conns_.Get(token)) {
+            OnProcess_(conn, true);
+        }
+    }, ThreadPool::LOW, slowTimeoutMS, [this, token] {
+        if(HttpConn* conn = conns_.Get(token)) {
+            OnSlowExpired_(conn);
+        }
+    });
+}
+
+void SubReactor::Finish_(HttpConn* client, uint32_t events) {
+    if(!threadpool_) {
+        if(events) {
+            if(client->Lingering()) {
+                ExtentTime_(client);
+            }
+            epoller_->ModFd(client->GetFd(), connEvent_ | events, client->Token());
+        } else {
+            CloseConn_(client);
+        }
+        return;
+    }
+    // 之后不能再访问client：Reactor线程随时可能关闭它
+    bool wakeup;
+    {
+        std::lock_guard<std::mutex> locker(finishMtx_);
+        wakeup = finished_.empty();
+#ifdef CORO_ENABLED
+        wakeup = wakeup && resumed_.empty();
+#endif
+        finished_.push_back({client->Token(), events});
+    }
+    // 队列原来不空时已经唤醒过，Reactor会一起处理
+    if(wakeup) {
+        uint64_t one = 1;
+        ::write(wakeupFd_, &one, sizeof(one));
+    }
+}
+
+// Reactor线程：连接交回本线程，超时标记过的直接关闭，否则重新注册事件
+void SubReactor::DealFinished_() {
+    std::vector<Finished> finished;
+#ifdef CORO_ENABLED
+    std::vector<Resumed> resumed;
+#endif
+    {
+        std::lock_guard<std::mutex> locker(finishMtx_);
+        finished.swap(finished_);
+#ifdef CORO_ENABLED
+        resumed.swap(resumed_);
+#endif
+    }
+#ifdef CORO_ENABLED
+    // 恢复的协程接着发送响应，或者关闭连接
+    for(const Resumed& r : resumed) {
+        *r.result = r.value;
+        r.handle.resume();
+    }
+#endif
+    for(const Finished& f : finished) {
+        HttpConn* client = conns_.Get(f.token);
+        if(!client) {
+            continue;
+        }
+        client->SetBusy(false);
+#ifdef URING_ENABLED
+        if(uring_) {
+            UringResume_(client, f.events);
+            continue;
+        }
+#endif
+        if(f.events == 0 || client->ClosePending()) {
+            CloseConn_(client);
+        } else {
+            if(client->Lingering()) {
+                ExtentTime_(client);    // 刚开始延迟关闭的连接从现在起等LINGER_MS
+            }
+            epoller_->ModFd(client->GetFd(), connEvent_ | f.events, f.token);
+        }
+    }
+}
+
+#ifdef CORO_ENABLED
+/*
+协程模式下一个连接的处理流程，按顺序写：读 -> 解析 -> 写 -> (长连接)继续
+读不到数据、发送缓冲区满时在ReadAsync/WriteAllAsync里挂起，Reactor线程继续处理其他连接
+*/
+Co<void> SubReactor::Serve_(HttpConn* client) {
+    int fd = client->GetFd();
+    // co_await不放在&&、||里：GCC 12对短路求值中的co_await生成的代码有误，左边为false时右边仍会执行
+    bool keepAlive = true;
+    bool linger = false;
+    while(keepAlive) {
+        bool readOk = co_await client->ReadAsync(*io_);
+        if(!readOk) {
+            break;
+        }
+        // 读缓冲区中可能有多个请求(流水线)，一批发完再处理下一批，没有完整的请求时继续读
+        // 有线程池时数据库验证不在本线程做：停在要验证的请求之前，交给LOW通道后挂起
+        while(true) {
+            bool ready = client->process(!threadpool_);
+            if(!ready && client->HasSlowRequest()) {
+                int slow = co_await SlowProcess_(client);
+                if(slow < 0 || client->ClosePending()) {
+                    keepAlive = false;
+                    break;
+                }
+                ready = slow > 0;
+            }
+            if(!ready) {
+                break;
+            }
+            bool writeOk = co_await client->WriteAllAsync(*io_);
+            if(!writeOk || !client->IsKeepAlive()) {
+                keepAlive = false;
+                linger = writeOk && client->NeedsLinger();
+                break;
+            }
+        }
+    }
+    // 出错的响应发完后延迟关闭：丢弃客户端还在上传的数据，直到对端关闭、超量或超时
+    if(linger) {
+        client->StartLinger();
+        ExtentTime_(client);
+        while(true) {
+            bool readOk = co_await client->ReadAsync(*io_);
+            if(!readOk || !client->Discard()) {
+                break;
+            }
+        }
+    }
+    if(timeoutMS_ > 0) {
+        timer_->cancel(fd);
+    }
+    CloseConn_(client);
+}
+
+/*
+协程挂起期间连接只由工作线程使用：Reactor不会恢复它(fd上没有等待)，超时回调只做标记(MarkClose)，
+所以process(true)可以直接在工作线程里执行；排队超时说明数据库跟不上，协程恢复后关闭连接
+*/
+void SubReactor::OffloadSlow_(HttpConn* client, std::coroutine_handle<> h, int* result) {
+    threadpool_->AddTask([this, token = client->Token(), h, result] {
+        HttpConn* conn = conns_.Get(token);
+        Resume_(h, result, conn && conn->process(true) ? 1 : 0);
+    }, ThreadPool::LOW, slowTimeoutMS, [this, h, result] {
+        Resume_(h, result, -1);
+    });
+}
+
+void SubReactor::Resume_(std::coroutine_handle<> h, int* result, int value) {
+    bool wakeup;
+    {
+        std::lock_guard<std::mutex> locker(finishMtx_);
+        wakeup = finished_.empty() && resumed_.empty();
+        resumed_.push_back({h, result, value});
+    }
+    if(wakeup) {
+        uint64_t one = 1;
+        ::write(wakeupFd_, &one, sizeof(one));
+    }
+}
+#endif
+
+// 排队超时，说明数据库跟不上，直接关闭连接
+void SubReactor::OnSlowExpired_(HttpConn* client) {
+    LOG_WARN("Client[%d] verify request expired after %dms", client->GetFd(), slowTimeoutMS);
+    Finish_(client, 0);
+}
+
+void SubReactor::OnWrite_(HttpConn* client) {
+    assert(client);
+    int ret = -1;
+    int writeErrno = 0;
+    ret = client->write(&writeErrno);
+    if(client->ToWriteBytes() == 0) {
+        /* 传输完成 */
+        if(client->IsKeepAlive()) {
+            OnProcess_(client);
+            return;
+        }
+        if(client->NeedsLinger() && !client->Lingering()) {
+            client->StartLinger();
+            Finish_(client, EPOLLIN);
+            return;
+        }
+    }
+    else if(ret < 0) {
+        if(writeErrno == EAGAIN) {
+            /* 内核发送缓冲区满，继续等待可写 */
+            Finish_(client, EPOLLOUT);
+            return;
+        }
+    }
+    Finish_(client, 0);
+}
+
+#ifdef URING_ENABLED
+/*
+io_uring模式的事件循环：
+1、监听socket一个多次完成的accept，eventfd一个poll(Stop()唤醒)，之后只在内核结束它们时重新提交
+2、每轮一次Wait()：提交上一轮产生的所有请求，并等待完成事件或定时器超时
+3、完成事件按user_data中的请求类型分发
+*/
+void SubReactor::UringLoop_() {
+    uring_->PrepAccept(listenFd_, UringData_(URING_ACCEPT, listenFd_));
+    uring_->PrepPoll(wakeupFd_, POLLIN, UringData_(URING_WAKE, wakeupFd_));
+    int timeMS = -1;
+    while(!isClose_) {
+        if(timeoutMS_ > 0) {
+            timer_->UpdateNow();    // 同epoll循环：处理完一轮完成事件后时钟已经过时
+            timeMS = timer_->GetNextTick();
+        }
+        int cnt = uring_->Wait(timeMS);
+        if(cnt < 0) {
+            LOG_ERROR("Reactor[%d] io_uring_enter error: %d", id_, errno);
+            break;
+        }
+        timer_->UpdateNow();
+        HandleUring_(cnt);
+    }
+}
+
+void SubReactor::HandleUring_(int cnt) {
+    for(int i = 0; i < cnt; i++) {
+        uint64_t data = uring_->GetData(i);
+        int res = uring_->GetRes(i);
+        uint32_t flags = uring_->GetFlags(i);
+        int fd = static_cast<int>(data & 0xffffffff);
+        int op = static_cast<int>(data >> 32);
+        switch(op) {
+        case URING_ACCEPT:
+            OnUringAccept_(res, flags);
+            break;
+        case URING_WAKE: {
+            uint64_t one;
+            ::read(wakeupFd_, &one, sizeof(one));
+            if(!isClose_) {
+                uring_->PrepPoll(wakeupFd_, POLLIN, UringData_(URING_WAKE, wakeupFd_));
+            }
+            DealFinished_();
+            break;
+        }
+        case URING_RECV:
+            OnUringRecv_(fd, res, flags);
+            break;
+        case URING_SEND:
+        case URING_SPLICE_IN:
+        case URING_SPLICE_OUT:
+            OnUringSend_(fd, op, res);
+            break;
+        default:    // 取消请求本身的完成事件，不需要处理
+            break;
+        }
+    }
+}
+
+void SubReactor::OnUringAccept_(int res, uint32_t flags) {
+    // 内核结束了多次完成的accept(出错或队列溢出)，重新提交
+    if(!(flags & IORING_CQE_F_MORE) && !isClose_) {
+        uring_->PrepAccept(listenFd_, UringData_(URING_ACCEPT, listenFd_));
+    }
+    if(res < 0) {
+        LOG_WARN("Reactor[%d] accept error: %d", id_, -res);
+        return;
+    }
+    int fd = res;
+    if(HttpConn::userCount >= MAX_FD) {
+        SendError_(fd, "Server busy!");
+        LOG_WARN("Clients is full!");
+        return;
+    }
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    memset(&addr, 0, sizeof(addr));
+    getpeername(fd, (struct sockaddr *)&addr, &len);
+    AddClient_(fd, addr);
+}
+
+/*
+多次完成的recv：每个完成事件带一块提供缓冲区，数据拷进readBuff_后马上归还
+没有在发送的响应时立即解析；正在发送时只攒数据，发完后再处理(process()要求上一批已经发完)
+连接在线程池中验证时readBuff_归工作线程使用，数据先放进stash
+res为0表示对端关闭，-ENOBUFS表示缓冲区暂时用完(这次的recv结束了，重新提交)
+*/
+void SubReactor::OnUringRecv_(int fd, int res, uint32_t flags) {
+    auto it = uringConns_.find(fd);
+    assert(it != uringConns_.end());
+    UringConn& uc = it->second;
+    HttpConn* client = conns_.Get(uc.conn);
+    assert(client);
+    if(flags & IORING_CQE_F_BUFFER) {
+        uint16_t bid = static_cast<uint16_t>(flags >> IORING_CQE_BUFFER_SHIFT);
+        if(res > 0 && !uc.closing) {
+            if(client->IsBusy()) {
+                uc.stash.append(uring_->BufAddr(bid), res);
+            } else {
+                client->Feed(uring_->BufAddr(bid), res);
+            }
+        }
+        uring_->RecycleBuf(bid);
+    }
+    if(!(flags & IORING_CQE_F_MORE)) {
+        uc.recvArmed = false;
+        uc.inflight--;
+    }
+    if(uc.closing) {
+        if(uc.inflight == 0) {
+            UringFinish_(fd);
+        }
+        return;
+    }
+    if(res == 0) {
+        uc.peerClosed = true;
+        if(uc.sending == 0) {
+            UringProcess_(fd, uc);
+        }
+        return;
+    }
+    if(res < 0 && res != -ENOBUFS) {
+        UringClose_(fd);
+        return;
+    }
+    if(!uc.recvArmed) {
+        uc.recvArmed = true;
+        uc.inflight++;
+        uring_->PrepRecv(fd, URING_BGID, UringData_(URING_RECV, fd));
+    }
+    if(res > 0) {
+        // 验证期间超时的连接，定时任务已经执行并删除，只等交回时关闭，不再刷新
+        if(!client->IsBusy() && !client->ClosePending()) {
+            ExtentTime_(client);
+        }
+        if(uc.sending == 0) {
+            UringProcess_(fd, uc);
+        }
+    }
+}
+
+void SubReactor::UringProcess_(int fd, UringConn& uc) {
+    HttpConn* client = conns_.Get(uc.conn);
+    assert(client);
+    if(client->IsBusy()) {
+        return;     // 验证结束交回时由UringResume_继续
+    }
+    if(client->Lingering()) {
+        if(uc.peerClosed || !client->Discard()) {
+            UringClose_(fd);
+        }
+        return;
+    }
+    if(client->process(!threadpool_)) {
+        UringSend_(fd, uc);
+    } else if(client->HasSlowRequest()) {
+        client->SetBusy(true);
+        SubmitSlow_(client);
+    } else if(uc.peerClosed) {
+        UringClose_(fd);
+    }
+}
+
+// 验证任务结束(或排队超时)，连接交回本线程：先放回期间收到的数据，再发送响应或继续解析
+void SubReactor::UringResume_(HttpConn* client, uint32_t events) {
+    int fd = client->GetFd();
+    auto it = uringConns_.find(fd);
+    assert(it != uringConns_.end());
+    UringConn& uc = it->second;
+    if(!uc.stash.empty()) {
+        client->Feed(uc.stash.data(), uc.stash.size());
+        std::string().swap(uc.stash);
+    }
+    if(events == 0 || client->ClosePending()) {
+        UringClose_(fd);
+    } else if(events & EPOLLOUT) {
+        UringSend_(fd, uc);
+    } else {
+        UringProcess_(fd, uc);
+    }
+}
+
+/*
+提交一轮发送：
+1、iov_还有数据：sendmsg(MSG_WAITALL，内核负责发完，部分发送只在出错时发生)
+2、还有文件内容：文件 -> 管道 -> socket 两个splice，管道里有上一轮没发完的数据时只提交后一个
+三个请求用IOSQE_IO_LINK链起来，一次提交、按顺序执行；前面的失败或不完整时后面的以-ECANCELED结束，
+本轮请求全部完成后按已发送的字节数决定是否继续提交
+*/
+void SubReactor::UringSend_(int fd, UringConn& uc) {
+    HttpConn* client = conns_.Get(uc.conn);
+    assert(client);
+    int iovCnt = 0;
+    const struct iovec* iov = client->WriteIov(&iovCnt);
+    int fileFd = -1;
+    off_t offset = 0;
+    size_t fileLen = 0;
+    bool hasFile = client->PendingFile(&fileFd, &offset, &fileLen);
+    if(hasFile && uc.pipe[0] < 0) {
+        if(pipe2(uc.pipe, O_CLOEXEC) < 0) {
+            LOG_ERROR("Client[%d] create pipe error!", fd);
+            UringClose_(fd);
+            return;
+        }
+        // 管道容量决定一次splice能发多少；超过pipe-max-size时用默认大小
+        fcntl(uc.pipe[1], F_SETPIPE_SZ, URING_PIPE_SIZE);
+        uc.pipeSize = fcntl(uc.pipe[1], F_GETPIPE_SZ);
+    }
+    uc.sending = 0;
+    uc.sendFailed = false;
+    if(iovCnt > 0) {
+        memset(&uc.msg, 0, sizeof(uc.msg));
+        uc.msg.msg_iov = const_cast<struct iovec*>(iov);
+        uc.msg.msg_iovlen = iovCnt;
+        uring_->PrepSendmsg(fd, &uc.msg, MSG_NOSIGNAL | MSG_WAITALL, UringData_(URING_SEND, fd), hasFile);
+        uc.sending++;
+    }
+    if(hasFile) {
+        if(uc.pipeBytes == 0) {
+            unsigned len = static_cast<unsigned>(std::min(fileLen, uc.pipeSize));
+            uring_->PrepSplice(fileFd, offset, uc.pipe[1], len, UringData_(URING_SPLICE_IN, fd), true);
+            uring_->PrepSplice(uc.pipe[0], -1, fd, len, UringData_(URING_SPLICE_OUT, fd), false);
+            uc.sending += 2;
+        } else {
+            uring_->PrepSplice(uc.pipe[0], -1, fd, static_cast<unsigned>(uc.pipeBytes),
+                               UringData_(URING_SPLICE_OUT, fd), false);
+            uc.sending++;
+        }
+    }
+    uc.inflight += uc.sending;
+}
+
+void SubReactor::OnUringSend_(int fd, int op, int res) {
+    auto it = uringConns_.find(fd);
+    assert(it != uringConns_.end());
+    UringConn& uc = it->second;
+    HttpConn* client = conns_.Get(uc.conn);
+    assert(client);
+    uc.inflight--;
+    uc.sending--;
+    if(uc.closing) {
+        if(uc.inflight == 0) {
+            UringFinish_(fd);
+        }
+        return;
+    }
+    // -ECANCELED：链中前一个请求没有完整完成，已发送的部分照常记录，下一轮继续
+    if(res > 0) {
+        if(op == URING_SPLICE_IN) {
+            uc.pipeBytes += res;
+        } else {
+            if(op == URING_SPLICE_OUT) {
+                uc.pipeBytes -= res;
+            }
+            client->Written(res);
+        }
+    } else if(res != -ECANCELED) {
+        // 出错，或者splice返回0(文件在发送过程中被截断)
+        uc.sendFailed = true;
+    }
+    if(uc.sending > 0) {
+        return;
+    }
+    if(uc.sendFailed) {
+        UringClose_(fd);
+        return;
+    }
+    ExtentTime_(client);
+    if(client->ToWriteBytes() > 0) {
+        UringSend_(fd, uc);
+    } else if(!client->IsKeepAlive()) {
+        if(client->NeedsLinger() && !uc.peerClosed) {
+            // 延迟关闭：recv继续，读到的数据在UringProcess_中丢弃
+            client->StartLinger();
+            ExtentTime_(client);
+            if(!uc.recvArmed) {
+                uc.recvArmed = true;
+                uc.inflight++;
+                uring_->PrepRecv(fd, URING_BGID, UringData_(URING_RECV, fd));
+            }
+            UringProcess_(fd, uc);
+        } else {
+            UringClose_(fd);
+        }
+    } else {
+        // 流水线中剩下的请求，或者发送期间收到的数据
+        UringProcess_(fd, uc);
+    }
+}
+
+/*
+关闭连接：shutdown让阻塞中的splice和多次完成的recv尽快结束，再取消fd上所有未完成的请求
+请求全部完成后UringFinish_才close(fd)，在此之前fd号不会被新连接复用，晚到的完成事件不会串到别的连接
+*/
+void SubReactor::UringClose_(int fd) {
+    auto it = uringConns_.find(fd);
+    if(it == uringConns_.end() || it->second.closing) {
+        return;
+    }
+    UringConn& uc = it->second;
+    HttpConn* client = conns_.Get(uc.conn);
+    if(client && client->IsBusy()) {
+        client->MarkClose();    // 工作线程还在用它，交回时关闭
+        return;
+    }
+    uc.closing = true;
+    if(uc.inflight == 0) {
+        UringFinish_(fd);
+        return;
+    }
+    shutdown(fd, SHUT_RDWR);
+    uring_->PrepCancelFd(fd, UringData_(URING_CANCEL, fd));
+}
+
+void SubReactor::UringFinish_(int fd) {
+    auto it = uringConns_.find(fd);
+    assert(it != uringConns_.end() && it->second.inflight == 0);
+    if(it->second.pipe[0] >= 0) {
+        close(it->second.pipe[0]);
+        close(it->second.pipe[1]);
+    }
+    Slab<HttpConn>::Handle token = it->second.conn;
+    uringConns_.erase(it);
+    LOG_INFO("Client[%d] quit!", fd);
+    conns_.Get(token)->Close();
+    conns_.Release(token);
+}
+#endif
+
+/*
+SO_REUSEPORT：允许多个socket绑定同一个端口，内核按四元组哈希把新连接分给其中一个监听socket
+默认每个SubReactor各自创建一个，这样accept不会集中在一个线程上；
+WebServer也可以只创建一个(reusePort为false)，各SubReactor用EPOLLEXCLUSIVE注册同一个监听socket，
+新连接只唤醒其中一个，空闲的Reactor先醒先接，长连接多时负载比按哈希分更均匀
+*/
+bool SubReactor::InitSocket_() {
+    bool shared = sharedListenFd_ >= 0;
+    // 失败时listenFd_由析构函数关闭
+    listenFd_ = shared ? sharedListenFd_ : OpenListen(port_, openLinger_, true);
+    if(listenFd_ < 0) {
+        return false;
+    }
+    if(ioMode_ == 0) {
+        // EPOLLEXCLUSIVE只能和EPOLLIN、EPOLLET等一起用，不能带EPOLLRDHUP
+        uint32_t events = shared ? (EPOLLIN | EPOLLEXCLUSIVE | (listenEvent_ & EPOLLET)) : (listenEvent_ | EPOLLIN);
+        if(!epoller_->AddFd(listenFd_, events, LISTEN_TOKEN)) {
+            LOG_ERROR("Reactor[%d] add listen error!", id_);
+            return false;
+        }
+    }
+    SetFdNonblock(listenFd_);
+    LOG_INFO("Reactor[%d] listen port:%d%s", id_, port_, shared ? " (shared)" : "");
+    return true;
+}
+
+int SubReactor::OpenListen(int port, bool optLinger, bool reusePort) {
+    int ret;
+    struct sockaddr_in addr;
+    if(port > 65535 || port < 1024) {
+        LOG_ERROR("Port:%d error!", port);
+        return -1;
+    }
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+
+    // 优雅关闭：直到所剩数据发送完毕或超时
+    struct linger linger{};
+    if(optLinger) {
+        linger.l_onoff = 1;
+        linger.l_linger = 1;
+    }
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if(fd < 0) {
+        LOG_ERROR("Create socket error!");
+        return -1;
+    }
+
+    ret = setsockopt(fd, SOL_SOCKET, SO_LINGER, &linger, sizeof(linger));
+    if(ret < 0) {
+        LOG_ERROR("Init linger error!");
+        close(fd);
+        return -1;
+    }
+
+    int optval = 1;
+    // 端口复用：TIME_WAIT状态下也可以重新绑定
+    ret = setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, (const void*)&optval, sizeof(int));
+    if(ret == -1) {
+        LOG_ERROR("Set SO_REUSEADDR error!");
+        close(fd);
+        return -1;
+    }
+    if(reusePort) {
+        ret = setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, (const void*)&optval, sizeof(int));
+        if(ret == -1) {
+            LOG_ERROR("Set SO_REUSEPORT error!");
+            close(fd);
+            return -1;
+        }
+    }
+
+    ret = bind(fd, (struct sockaddr *)&addr, sizeof(addr));
+    if(ret < 0) {
+        LOG_ERROR("Bind Port:%d error!", port);
+        close(fd);
+        return -1;
+    }
+
+    ret = listen(fd, SOMAXCONN);
+    if(ret < 0) {
+        LOG_ERROR("Listen port:%d error!", port);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int SubReactor::SetFdNonblock(int fd) {
+    assert(fd > 0);
+    return fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+}
@@ -0,0 +1,241 @@
+#ifndef SUB_REACTOR_H
+#define SUB_REACTOR_H
+
+#include <unordered_map>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <fcntl.h>          // fcntl()
+#include <unistd.h>         // close()
+#include <errno.h>
+#include <sys/eventfd.h>    // eventfd()
+#include <poll.h>           // POLLIN(io_uring的poll请求)
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "epoller.h"
+#include "uring.h"
+#include "../log/log.h"
+#include "../timer/heaptimer.h"
+#include "../timer/timingwheel.h"
+#include "../pool/threadpool.h"
+#include "../pool/affinity.h"
+#include "../pool/slab.h"
+#include "../http/httpconn.h"
+#include "../coro/iocontext.h"
+
+/*
+SubReactor：one loop per thread 中的一个 loop
+1、每个SubReactor独占一个监听socket(SO_REUSEPORT)，由内核把新连接分摊到各个监听socket上；
+   也可以共享WebServer创建的一个监听socket(SetListenFd)，用EPOLLEXCLUSIVE注册，新连接只唤醒一个Reactor
+   连接注册到Epoller时token是连接在conns_中的句柄，就绪事件直接找回连接，不查连接表
+2、每个SubReactor独占自己的Epoller、定时器和连接Slab(conns_)，互相之间没有共享状态，因此不需要加锁
+   就绪事件、定时器回调、线程池任务都通过句柄找连接：连接关闭后句柄失效，fd被新连接复用也不会串
+3、threadpool_为空时，读、解析、写全部在本线程内完成；否则读写交给共享线程池(与单Reactor时的行为一致)
+   交给线程池的连接是busy的：工作线程不关闭连接、不重新注册事件，任务结束时把结果(继续读/写或关闭)
+   放进finished_并用eventfd唤醒Reactor，由Reactor线程处理；busy期间超时只做标记，任务结束后关闭。
+   因此连接只在Reactor线程关闭和归还，工作线程用着的连接不会被关闭或被新连接重用
+   一轮epoll_wait产生的读写任务先攒起来，处理完所有事件后用AddTasks一次提交：
+   写(发送已生成的响应)走HIGH通道，读和解析走NORMAL通道；
+   注册/登录要查数据库，解析完后单独提交到LOW通道，超过slowTimeoutMS还没开始执行就关闭连接
+4、Loop()所在线程命名为reactor-编号；SetCpu()指定CPU后绑核，连接槽位(Loop()开始时预分配connReserve个)
+   和缓冲区都在这个线程里首次分配，内存就落在这个CPU所在的NUMA节点上；WebServer给它分配同一节点的线程池
+5、协程模式(SetCoroutine，需要C++20编译)：每个连接一个协程按顺序读、解析、写，
+   部分读写时挂起等待Epoller的就绪事件，连接超时由定时器取消等待；连接在本线程内处理，
+   只有注册/登录的数据库验证交给线程池的LOW通道，协程挂起，任务结束后经resumed_回到本线程恢复
+6、io_uring模式(SetIoMode(1)，需要Linux 5.19+)：不再等就绪事件再readv/writev，而是把I/O本身交给内核：
+   监听socket一个多次完成的accept，每个连接一个多次完成的recv(数据放在提供缓冲区环里，拷进readBuff_后归还)，
+   响应用sendmsg发送，sendfile换成文件->管道->socket两个splice，和sendmsg链接(IOSQE_IO_LINK)成一条链；
+   一轮产生的所有请求在下一次io_uring_enter时一起提交，同时等待完成事件，每轮只有一次系统调用
+   关闭连接时先取消它未完成的请求，全部完成后才close(fd)，fd不会在请求完成前被新连接复用
+   连接在本线程内处理，只有注册/登录的数据库验证交给线程池的LOW通道，期间收到的数据先存在stash里，
+   任务结束经finished_交回本线程后再继续；不能和协程模式同时使用；内核不支持时打印警告并退回epoll
+*/
+class SubReactor {
+public:
+    // timerMode：0-小根堆(HeapTimer)  1-时间轮(TimingWheel)  2-惰性刷新的小根堆
+    SubReactor(int id, int port, int trigMode, int timeoutMS,
+               bool optLinger, ThreadPool* threadpool, int timerMode = 0);
+    ~SubReactor();
+
+    bool Init();        // 创建监听socket和唤醒fd，失败返回false
+    void Loop();        // 事件循环，直到Stop()被调用
+    void Stop();        // 可以在其他线程调用
+    void SetCpu(int cpu) {      // Loop()之前调用，-1表示不绑核
+        cpu_ = cpu;
+    }
+    void SetCoroutine(bool on) {    // Init()之前调用；不支持协程的编译器上Init()时打印警告并忽略
+        coroutine_ = on;
+    }
+    void SetIoMode(int mode) {      // Init()之前调用：0-epoll  1-io_uring
+        ioMode_ = mode;
+    }
+    // Init()之前调用：使用共享的监听socket(用EPOLLEXCLUSIVE注册)，不自己创建；fd由调用方关闭
+    void SetListenFd(int fd) {
+        sharedListenFd_ = fd;
+    }
+
+    // 创建监听socket，失败返回-1；reusePort为true时设置SO_REUSEPORT
+    static int OpenListen(int port, bool optLinger, bool reusePort);
+
+    int Id() const {
+        return id_;
+    }
+
+    static int slowTimeoutMS;   // LOW通道(注册/登录)任务的排队超时，<=0表示不超时
+    static size_t connReserve;  // 每个Reactor开始时预分配的连接槽位数，不够时按块增加
+
+private:
+    bool InitSocket_();
+    void InitEventMode_(int trigMode);
+    void AddClient_(int fd, sockaddr_in addr);
+
+    void DealListen_();
+    void DealWrite_(HttpConn* client);
+    void DealRead_(HttpConn* client);
+
+    void SendError_(int fd, const char* info);
+    void ExtentTime_(HttpConn* client);
+    void CloseConn_(HttpConn* client);
+
+    void OnRead_(HttpConn* client);
+    void OnWrite_(HttpConn* client);
+    void OnProcess_(HttpConn* client, bool allowSlow = false);
+    void SubmitSlow_(HttpConn* client);
+    void OnSlowExpired_(HttpConn* client);
+    // 读写处理结束：events为重新关注的事件(EPOLLIN/EPOLLOUT)，0表示关闭连接
+    // 线程池模式下在工作线程调用，交回Reactor线程处理
+    void Finish_(HttpConn* client, uint32_t events);
+    void DealFinished_();
+#ifdef CORO_ENABLED
+    Co<void> Serve_(HttpConn* client);     // 协程模式下一个连接的完整处理流程
+
+    // co_await SlowProcess_(client)：挂起协程，process(true)交给线程池的LOW通道，结束后在本线程恢复
+    // 返回1-有响应要发送  0-没有响应  -1-排队超时
+    struct SlowAwaiter {
+        SubReactor* reactor;
+        HttpConn* client;
+        int result;
+
+        bool await_ready() const noexcept {
+            return false;
+        }
+        void await_suspend(std::coroutine_handle<> h) {
+            reactor->OffloadSlow_(client, h, &result);
+        }
+        int await_resume() const noexcept {
+            return result;
+        }
+    };
+    SlowAwaiter SlowProcess_(HttpConn* client) {
+        return SlowAwaiter{this, client, 0};
+    }
+    void OffloadSlow_(HttpConn* client, std::coroutine_handle<> h, int* result);
+    // 工作线程调用：把结果交回Reactor线程，由DealFinished_恢复协程
+    void Resume_(std::coroutine_handle<> h, int* result, int value);
+#endif
+#ifdef URING_ENABLED
+    // io_uring请求的user_data：高32位是请求类型，低32位是fd
+    enum URING_OP {
+        URING_ACCEPT = 1,
+        URING_WAKE,
+        URING_RECV,
+        URING_SEND,         // sendmsg发送iov_
+        URING_SPLICE_IN,    // 文件 -> 管道
+        URING_SPLICE_OUT,   // 管道 -> socket
+        URING_CANCEL,
+    };
+
+    // 连接在io_uring模式下的状态
+    struct UringConn {
+        Slab<HttpConn>::Handle conn;
+        struct msghdr msg;      // sendmsg的参数，请求完成前不能变
+        int pipe[2];            // 发送文件时才创建
+        size_t pipeSize;
+        size_t pipeBytes;       // 已经从文件读进管道、还没发出去的字节数
+        int inflight;           // 未完成的请求数(多次完成的recv算一个)
+        int sending;            // 本轮发送链中未完成的请求数
+        bool recvArmed;
+        bool sendFailed;
+        bool peerClosed;        // 对端已经关闭写，处理完已收到的请求后关闭
+        bool closing;
+        std::string stash;      // 连接在线程池中验证时收到的数据，交回后再放进readBuff_
+    };
+
+    static uint64_t UringData_(int op, int fd) {
+        return (static_cast<uint64_t>(op) << 32) | static_cast<uint32_t>(fd);
+    }
+    void UringLoop_();
+    void HandleUring_(int cnt);
+    void OnUringAccept_(int res, uint32_t flags);
+    void OnUringRecv_(int fd, int res, uint32_t flags);
+    void OnUringSend_(int fd, int op, int res);
+    void UringProcess_(int fd, UringConn& uc);
+    void UringSend_(int fd, UringConn& uc);
+    void UringClose_(int fd);
+    void UringFinish_(int fd);
+    void UringResume_(HttpConn* client, uint32_t events);
+
+    static const unsigned URING_ENTRIES = 1024;
+    static const uint16_t URING_BGID = 0;
+    static const unsigned URING_BUF_COUNT = 512;    // 提供缓冲区块数(2的幂)
+    static const unsigned URING_BUF_SIZE = 4096;
+    static const int URING_PIPE_SIZE = 1 << 20;     // 管道容量，一次splice最多发这么多
+#endif
+
+    static int SetFdNonblock(int fd);
+
+    static const int MAX_FD = 65536;    // 全局最大连接数
+    // Epoller事件的token：连接是Slab句柄(HttpConn::Token()，至少1<<32)，不会和这两个值冲突
+    static const uint64_t LISTEN_TOKEN = 1;
+    static const uint64_t WAKEUP_TOKEN = 2;
+
+    int id_;            // Reactor编号，用于日志和线程名
+    int cpu_;           // 绑定的CPU，-1表示不绑定
+    bool coroutine_;    // 协程模式
+    int ioMode_;        // 0-epoll  1-io_uring
+    int port_;
+    int timeoutMS_;     // 连接超时时间，<=0表示不启用定时器
+    bool openLinger_;   // 优雅关闭
+    std::atomic<bool> isClose_;
+
+    int listenFd_;
+    int sharedListenFd_;    // WebServer创建的共享监听socket，-1表示自己创建
+    int wakeupFd_;      // eventfd，Stop()时用来唤醒阻塞在epoll_wait上的循环
+
+    uint32_t listenEvent_;
+    uint32_t connEvent_;
+
+    ThreadPool* threadpool_;                // 由WebServer持有，可能为nullptr
+    std::vector<Task> pendingRead_;         // 本轮待提交给线程池的任务
+    std::vector<Task> pendingWrite_;
+    // 工作线程处理完的连接，Reactor线程被eventfd唤醒后处理
+    struct Finished {
+        Slab<HttpConn>::Handle token;
+        uint32_t events;
+    };
+    std::mutex finishMtx_;
+    std::vector<Finished> finished_;
+#ifdef CORO_ENABLED
+    // 验证任务结束、等待恢复的协程，和finished_共用一把锁
+    struct Resumed {
+        std::coroutine_handle<> handle;
+        int* result;
+        int value;
+    };
+    std::vector<Resumed> resumed_;
+#endif
+    std::unique_ptr<Timer> timer_;
+    std::unique_ptr<Epoller> epoller_;
+    Slab<HttpConn> conns_;                      // 本Reactor的连接
+#ifdef CORO_ENABLED
+    std::unique_ptr<IoContext> io_;             // 协程模式下才创建，析构时先于定时器和Epoller
+#endif
+#ifdef URING_ENABLED
+    std::unordered_map<int, UringConn> uringConns_;
+    std::unique_ptr<Uring> uring_;              // io_uring模式下才创建；先于连接表析构，关环后内核不再访问它们
+#endif
+};
+
+#endif
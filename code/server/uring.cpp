@@ -0,0 +1,296 @@
+#include "uring.h"
+
+#ifdef URING_ENABLED
+#include <signal.h>     // _NSIG
+#include <algorithm>
+#include <stddef.h>     // offsetof
+
+static_assert(offsetof(struct io_uring_buf_ring, tail) == 14, "tail must overlay bufs[0].resv");
+
+/*
+int io_uring_setup(unsigned entries, struct io_uring_params *p);   // 返回环的fd，SQ/CQ用mmap映射
+int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags, void* arg, size_t argsz);
+int io_uring_register(int fd, unsigned opcode, void *arg, unsigned nr_args);
+
+SQ：用户态写尾指针，内核读头指针；CQ：内核写尾指针，用户态读头指针
+尾指针的写用release，读对方的指针用acquire，保证SQE/CQE的内容先于指针可见
+*/
+
+Uring::Uring(unsigned entries) :
+    ringFd_(-1), entries_(entries), enterCnt_(0),
+    sqRing_(MAP_FAILED), sqRingSize_(0), cqRing_(MAP_FAILED), cqRingSize_(0),
+    sqes_(static_cast<struct io_uring_sqe*>(MAP_FAILED)), sqesSize_(0),
+    sqHead_(nullptr), sqTail_(nullptr), sqMask_(0), sqLocalTail_(0), sqSubmitted_(0),
+    cqHead_(nullptr), cqTail_(nullptr), cqMask_(0), cqes_(nullptr),
+    bufRing_(static_cast<struct io_uring_buf_ring*>(MAP_FAILED)), bufRingSize_(0),
+    bufs_(static_cast<char*>(MAP_FAILED)), bufsSize_(0), bufSize_(0), bufMask_(0), bufTail_(0) {
+}
+
+// 先关环(内核取消所有未完成的请求)，再释放交给内核的内存
+Uring::~Uring() {
+    if(ringFd_ >= 0) {
+        close(ringFd_);
+    }
+    if(sqes_ != MAP_FAILED) {
+        munmap(sqes_, sqesSize_);
+    }
+    if(cqRing_ != MAP_FAILED && cqRing_ != sqRing_) {
+        munmap(cqRing_, cqRingSize_);
+    }
+    if(sqRing_ != MAP_FAILED) {
+        munmap(sqRing_, sqRingSize_);
+    }
+    if(bufRing_ != MAP_FAILED) {
+        munmap(bufRing_, bufRingSize_);
+    }
+    if(bufs_ != MAP_FAILED) {
+        munmap(bufs_, bufsSize_);
+    }
+}
+
+bool Uring::Init() {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    // COOP_TASKRUN：完成事件在下次进入内核时处理，不用IPI打断Reactor线程(5.19+，不支持时去掉)
+    p.flags = IORING_SETUP_COOP_TASKRUN;
+    ringFd_ = syscall(__NR_io_uring_setup, entries_, &p);
+    if(ringFd_ < 0 && errno == EINVAL) {
+        memset(&p, 0, sizeof(p));
+        ringFd_ = syscall(__NR_io_uring_setup, entries_, &p);
+    }
+    if(ringFd_ < 0) {
+        return false;
+    }
+    // 带超时等待需要EXT_ARG；NODROP保证CQ满时完成事件不会丢
+    if(!(p.features & IORING_FEAT_EXT_ARG) || !(p.features & IORING_FEAT_NODROP)) {
+        return false;
+    }
+
+    sqRingSize_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    cqRingSize_ = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if(p.features & IORING_FEAT_SINGLE_MMAP) {
+        sqRingSize_ = cqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+    }
+    sqRing_ = mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                   ringFd_, IORING_OFF_SQ_RING);
+    if(sqRing_ == MAP_FAILED) {
+        return false;
+    }
+    if(p.features & IORING_FEAT_SINGLE_MMAP) {
+        cqRing_ = sqRing_;
+    } else {
+        cqRing_ = mmap(nullptr, cqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                       ringFd_, IORING_OFF_CQ_RING);
+        if(cqRing_ == MAP_FAILED) {
+            return false;
+        }
+    }
+    sqesSize_ = p.sq_entries * sizeof(struct io_uring_sqe);
+    sqes_ = static_cast<struct io_uring_sqe*>(mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE,
+                                                   MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQES));
+    if(sqes_ == MAP_FAILED) {
+        return false;
+    }
+
+    char* sq = static_cast<char*>(sqRing_);
+    char* cq = static_cast<char*>(cqRing_);
+    sqHead_ = reinterpret_cast<unsigned*>(sq + p.sq_off.head);
+    sqTail_ = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+    sqMask_ = *reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+    entries_ = p.sq_entries;
+    // SQ数组固定为恒等映射：第i个位置就是第i个SQE
+    unsigned* array = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+    for(unsigned i = 0; i < p.sq_entries; i++) {
+        array[i] = i;
+    }
+    sqLocalTail_ = sqSubmitted_ = *sqTail_;
+
+    cqHead_ = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+    cqTail_ = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+    cqMask_ = *reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<struct io_uring_cqe*>(cq + p.cq_off.cqes);
+    events_.resize(p.cq_entries);
+    return true;
+}
+
+bool Uring::SetupBufRing(uint16_t bgid, unsigned count, unsigned size) {
+    assert(ringFd_ >= 0 && count > 0 && (count & (count - 1)) == 0 && count <= 32768);
+    // 环必须按页对齐；缓冲区也用mmap，按页对齐并且不和其他数据共享缓存行
+    bufRingSize_ = count * sizeof(struct io_uring_buf);
+    void* ring = mmap(nullptr, bufRingSize_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(ring == MAP_FAILED) {
+        return false;
+    }
+    bufRing_ = static_cast<struct io_uring_buf_ring*>(ring);
+    bufsSize_ = static_cast<size_t>(count) * size;
+    void* bufs = mmap(nullptr, bufsSize_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(bufs == MAP_FAILED) {
+        return false;
+    }
+    bufs_ = static_cast<char*>(bufs);
+    bufSize_ = size;
+    bufMask_ = count - 1;
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = reinterpret_cast<uint64_t>(bufRing_);
+    reg.ring_entries = count;
+    reg.bgid = bgid;
+    if(syscall(__NR_io_uring_register, ringFd_, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        return false;
+    }
+    bufTail_ = 0;
+    for(unsigned i = 0; i < count; i++) {
+        RecycleBuf(static_cast<uint16_t>(i));
+    }
+    __atomic_store_n(&bufRing_->tail, bufTail_, __ATOMIC_RELEASE);
+    return true;
+}
+
+void Uring::RecycleBuf(uint16_t bid) {
+    // 环就是io_uring_buf数组(tail和第0项的resv重叠)；C++中io_uring_buf_ring::bufs的偏移不是0，不能用它
+    struct io_uring_buf* buf = reinterpret_cast<struct io_uring_buf*>(bufRing_) + (bufTail_ & bufMask_);
+    buf->addr = reinterpret_cast<uint64_t>(BufAddr(bid));
+    buf->len = bufSize_;
+    buf->bid = bid;
+    bufTail_++;
+}
+
+int Uring::Enter_(unsigned toSubmit, unsigned minComplete, unsigned flags, void* arg, size_t argSize) {
+    enterCnt_++;
+    return syscall(__NR_io_uring_enter, ringFd_, toSubmit, minComplete, flags, arg, argSize);
+}
+
+struct io_uring_sqe* Uring::GetSqe_() {
+    unsigned head = __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+    if(sqLocalTail_ - head >= entries_) {
+        // SQ满：先把已经填好的提交给内核，腾出位置
+        __atomic_store_n(sqTail_, sqLocalTail_, __ATOMIC_RELEASE);
+        int ret = Enter_(sqLocalTail_ - sqSubmitted_, 0, 0, nullptr, 0);
+        if(ret > 0) {
+            sqSubmitted_ += ret;
+        }
+        head = __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+        assert(sqLocalTail_ - head < entries_);
+    }
+    struct io_uring_sqe* sqe = &sqes_[sqLocalTail_ & sqMask_];
+    memset(sqe, 0, sizeof(*sqe));
+    sqLocalTail_++;
+    return sqe;
+}
+
+void Uring::PrepAccept(int fd, uint64_t data) {
+    struct io_uring_sqe* sqe = GetSqe_();
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_CLOEXEC;
+    sqe->user_data = data;
+}
+
+void Uring::PrepRecv(int fd, uint16_t bgid, uint64_t data) {
+    struct io_uring_sqe* sqe = GetSqe_();
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = bgid;
+    sqe->user_data = data;
+}
+
+void Uring::PrepPoll(int fd, uint32_t events, uint64_t data) {
+    struct io_uring_sqe* sqe = GetSqe_();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = events;
+    sqe->user_data = data;
+}
+
+void Uring::PrepSendmsg(int fd, const struct msghdr* msg, unsigned flags, uint64_t data, bool link) {
+    struct io_uring_sqe* sqe = GetSqe_();
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(msg);
+    sqe->len = 1;
+    sqe->msg_flags = flags;
+    sqe->flags = link ? IOSQE_IO_LINK : 0;
+    sqe->user_data = data;
+}
+
+void Uring::PrepSplice(int fdIn, int64_t offIn, int fdOut, unsigned len, uint64_t data, bool link) {
+    struct io_uring_sqe* sqe = GetSqe_();
+    sqe->opcode = IORING_OP_SPLICE;
+    sqe->fd = fdOut;
+    sqe->off = static_cast<uint64_t>(-1);
+    sqe->splice_fd_in = fdIn;
+    sqe->splice_off_in = static_cast<uint64_t>(offIn);
+    sqe->len = len;
+    sqe->flags = link ? IOSQE_IO_LINK : 0;
+    sqe->user_data = data;
+}
+
+void Uring::PrepCancelFd(int fd, uint64_t data) {
+    struct io_uring_sqe* sqe = GetSqe_();
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = fd;
+    sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+    sqe->user_data = data;
+}
+
+/*
+一次io_uring_enter：提交本轮所有SQE，CQ为空时等待至少一个完成事件(timeoutMs为0不等待，<0一直等)
+归还的缓冲区在进入内核之前发布
+*/
+int Uring::Wait(int timeoutMs) {
+    if(bufRing_ != MAP_FAILED) {
+        __atomic_store_n(&bufRing_->tail, bufTail_, __ATOMIC_RELEASE);
+    }
+    __atomic_store_n(sqTail_, sqLocalTail_, __ATOMIC_RELEASE);
+    unsigned toSubmit = sqLocalTail_ - sqSubmitted_;
+    bool ready = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE) != *cqHead_;
+    if(toSubmit > 0 || (!ready && timeoutMs != 0)) {
+        struct __kernel_timespec ts;
+        struct io_uring_getevents_arg arg;
+        memset(&arg, 0, sizeof(arg));
+        arg.sigmask_sz = _NSIG / 8;
+        if(timeoutMs >= 0) {
+            ts.tv_sec = timeoutMs / 1000;
+            ts.tv_nsec = (timeoutMs % 1000) * 1000000LL;
+            arg.ts = reinterpret_cast<uint64_t>(&ts);
+        }
+        unsigned minComplete = (ready || timeoutMs == 0) ? 0 : 1;
+        int ret = Enter_(toSubmit, minComplete, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG,
+                         &arg, sizeof(arg));
+        if(ret >= 0) {
+            sqSubmitted_ += ret;
+        } else if(errno != ETIME && errno != EINTR && errno != EBUSY) {
+            return -1;
+        }
+    }
+
+    unsigned head = *cqHead_;
+    unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+    size_t n = 0;
+    while(head != tail && n < events_.size()) {
+        events_[n++] = cqes_[head & cqMask_];
+        head++;
+    }
+    __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+    return static_cast<int>(n);
+}
+
+uint64_t Uring::GetData(size_t i) const {
+    assert(i < events_.size());
+    return events_[i].user_data;
+}
+
+int Uring::GetRes(size_t i) const {
+    assert(i < events_.size());
+    return events_[i].res;
+}
+
+uint32_t Uring::GetFlags(size_t i) const {
+    assert(i < events_.size());
+    return events_[i].flags;
+}
+#endif
@@ -0,0 +1,105 @@
+#ifndef URING_H
+#define URING_H
+
+#include <sys/mman.h>       // mmap
+#include <sys/syscall.h>    // io_uring没有glibc封装，直接用系统调用
+#include <sys/socket.h>
+#include <unistd.h>
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+// 内核头文件要有多次完成的accept/recv和带超时的io_uring_enter(Linux 5.19+)，否则只能用Epoller
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#if defined(IORING_RECV_MULTISHOT) && defined(IORING_ACCEPT_MULTISHOT) && defined(IORING_ENTER_EXT_ARG)
+#define URING_ENABLED 1
+#endif
+#endif
+#endif
+
+#ifdef URING_ENABLED
+/*
+Uring：对io_uring系统调用的简单封装，和Epoller一样由一个SubReactor独占，不加锁
+1、Prep*只把请求写进提交队列(SQ)，Wait()时一次io_uring_enter提交本轮所有请求并等待完成事件
+2、Wait()把完成事件(CQE)拷出来，用GetData/GetRes/GetFlags按下标读取，和Epoller::Wait/GetEvents一样
+3、提供缓冲区环(SetupBufRing)：多次完成的recv由内核从环里挑一块空闲缓冲区放数据，
+   CQE的flags里带缓冲区编号；用完RecycleBuf归还，下次Wait()时一起对内核可见
+4、Init()失败(内核太旧、被seccomp或io_uring_disabled禁用)时返回false，调用方退回Epoller
+*/
+class Uring {
+public:
+    explicit Uring(unsigned entries = 1024);
+    ~Uring();
+
+    bool Init();
+    // 注册bgid号缓冲区环：count块(2的幂)，每块size字节
+    bool SetupBufRing(uint16_t bgid, unsigned count, unsigned size);
+
+    void PrepAccept(int fd, uint64_t data);                 // 多次完成的accept
+    void PrepRecv(int fd, uint16_t bgid, uint64_t data);    // 多次完成的recv，从bgid环取缓冲区
+    void PrepPoll(int fd, uint32_t events, uint64_t data);  // 一次性的poll，就绪后完成
+    // link为true时下一个请求等这个请求成功完成后才开始，失败则下一个以-ECANCELED完成
+    void PrepSendmsg(int fd, const struct msghdr* msg, unsigned flags, uint64_t data, bool link);
+    // offIn为-1表示不指定偏移(从管道读)；输出端是socket或管道，不指定偏移
+    void PrepSplice(int fdIn, int64_t offIn, int fdOut, unsigned len, uint64_t data, bool link);
+    void PrepCancelFd(int fd, uint64_t data);               // 取消fd上所有未完成的请求
+
+    int Wait(int timeoutMs = -1);       // 提交并等待，返回完成事件个数，超时返回0
+
+    uint64_t GetData(size_t i) const;   // 第i个完成事件的user_data
+    int GetRes(size_t i) const;         // 结果：>=0成功，<0为-errno
+    uint32_t GetFlags(size_t i) const;  // IORING_CQE_F_MORE、IORING_CQE_F_BUFFER等
+
+    char* BufAddr(uint16_t bid) const {
+        return bufs_ + static_cast<size_t>(bid) * bufSize_;
+    }
+    void RecycleBuf(uint16_t bid);
+
+    unsigned SubmitCount() const {      // 调用io_uring_enter的次数，用于统计
+        return enterCnt_;
+    }
+
+private:
+    struct io_uring_sqe* GetSqe_();     // SQ满时先提交一次
+    int Enter_(unsigned toSubmit, unsigned minComplete, unsigned flags, void* arg, size_t argSize);
+
+    int ringFd_;
+    unsigned entries_;
+    unsigned enterCnt_;
+
+    // SQ/CQ环和SQE数组的映射，SINGLE_MMAP时SQ和CQ共用一块
+    void* sqRing_;
+    size_t sqRingSize_;
+    void* cqRing_;
+    size_t cqRingSize_;
+    struct io_uring_sqe* sqes_;
+    size_t sqesSize_;
+
+    unsigned* sqHead_;
+    unsigned* sqTail_;
+    unsigned sqMask_;
+    unsigned sqLocalTail_;      // 已经填好但还没对内核可见的位置
+    unsigned sqSubmitted_;      // 已经交给内核的位置
+    unsigned* cqHead_;
+    unsigned* cqTail_;
+    unsigned cqMask_;
+    struct io_uring_cqe* cqes_;
+
+    std::vector<struct io_uring_cqe> events_;   // Wait()拷出来的完成事件
+
+    // 提供缓冲区环
+    struct io_uring_buf_ring* bufRing_;
+    size_t bufRingSize_;
+    char* bufs_;
+    size_t bufsSize_;
+    unsigned bufSize_;
+    unsigned bufMask_;
+    uint16_t bufTail_;          // 本地的尾指针，Wait()时发布给内核
+};
+#endif
+
+#endif
@@ -0,0 +1,141 @@
+#define LOG_MODULE Log::SERVER
+#include "webserver.h"
+
+WebServer::WebServer(const ServerOptions& opt) :
+            port_(opt.port), listenFd_(-1), isClose_(false) {
+    // 日志要先于Reactor初始化，否则Reactor的初始化日志会丢失
+    if(opt.openLog) {
+        Log::Instance()->init(opt.logLevel, "./log", ".log", opt.logQueSize, false, opt.logDeferred);
+    }
+
+    srcDir_ = getcwd(nullptr, 256);
+    assert(srcDir_);
+    strncat(srcDir_, "/resources/", 16);
+    HttpConn::userCount = 0;
+    HttpConn::srcDir = srcDir_;
+    HttpConn::pipelineDepth = opt.pipelineDepth;
+    SqlConnPool::Instance()->Init("localhost", opt.sqlPort, opt.sqlUser.c_str(), opt.sqlPwd.c_str(),
+                                  opt.dbName.c_str(), opt.connPoolNum);
+    if(opt.fileCacheMB > 0) {
+        FileCache::Instance()->Init(srcDir_, static_cast<size_t>(opt.fileCacheMB) * 1024 * 1024);
+    }
+
+    // 不绑核时把所有CPU当作一个节点，只用来决定线程池个数
+    const std::vector<std::vector<int>>& nodes = Affinity::Nodes();
+    size_t nodeCnt = opt.pinThreads ? nodes.size() : 1;
+    if(opt.threadNum > 0) {
+        for(size_t n = 0; n < nodeCnt; n++) {
+            size_t cnt = opt.threadNum / nodeCnt + (n < opt.threadNum % nodeCnt ? 1 : 0);
+            threadpools_.emplace_back(new ThreadPool(std::max<size_t>(cnt, 1),
+                opt.pinThreads ? "worker" + std::to_string(n) : "worker",
+                opt.pinThreads ? nodes[n] : std::vector<int>()));
+        }
+        FileCache::Instance()->SetTaskPool(threadpools_[0].get());
+    } else if(opt.fileCacheMB > 0) {
+        taskPool_.reset(new ThreadPool(1, "cache-task"));
+        FileCache::Instance()->SetTaskPool(taskPool_.get());
+    }
+    // reactorNum <= 0 时按CPU核数创建
+    int reactorNum = opt.reactorNum;
+    if(reactorNum <= 0) {
+        reactorNum = std::max(1u, std::thread::hardware_concurrency());
+    }
+    if(!opt.reusePort) {
+        listenFd_ = SubReactor::OpenListen(port_, opt.optLinger, false);
+        if(listenFd_ < 0) {
+            isClose_ = true;
+            reactorNum = 0;
+        }
+    }
+    for(int i = 0; i < reactorNum; i++) {
+        // 第i个Reactor在第i % nodeCnt个节点上，依次占用节点内的CPU
+        size_t node = i % nodeCnt;
+        ThreadPool* pool = threadpools_.empty() ? nullptr : threadpools_[node].get();
+        std::unique_ptr<SubReactor> reactor(
+            new SubReactor(i, port_, opt.trigMode, opt.timeoutMS, opt.optLinger, pool, opt.timerMode));
+        if(opt.pinThreads) {
+            reactor->SetCpu(nodes[node][(i / nodeCnt) % nodes[node].size()]);
+        }
+        reactor->SetCoroutine(opt.coroutine);
+        reactor->SetIoMode(opt.ioMode);
+        reactor->SetListenFd(listenFd_);
+        if(!reactor->Init()) {
+            isClose_ = true;
+            break;
+        }
+        reactors_.push_back(std::move(reactor));
+    }
+
+    if(isClose_) {
+        LOG_ERROR("========== Server init error!==========");
+    } else {
+        LOG_INFO("========== Server init ==========");
+        LOG_INFO("Port:%d, OpenLinger: %s, listen: %s", port_, opt.optLinger? "true":"false",
+                 opt.reusePort ? "SO_REUSEPORT" : "shared(EPOLLEXCLUSIVE)");
+        LOG_INFO("TrigMode: %d, Timeout: %dms, Timer: %s", opt.trigMode, opt.timeoutMS,
+                 opt.timerMode == 1 ? "TimingWheel" : (opt.timerMode == 2 ? "HeapTimer(lazy)" : "HeapTimer"));
+        LOG_INFO("LogSys level: %d, deferred format: %s", opt.logLevel,
+                 Log::Instance()->IsDeferred() ? "true" : "false");
+        LOG_INFO("srcDir: %s", HttpConn::srcDir);
+        LOG_INFO("SqlConnPool num: %d, ThreadPool num: %d, Reactor num: %d",
+                 opt.connPoolNum, opt.threadNum, reactorNum);
+        LOG_INFO("Pin threads: %s, NUMA nodes: %zu", opt.pinThreads ? "true" : "false", nodes.size());
+        LOG_INFO("Pipeline depth: %d, coroutine: %s, io: %s", opt.pipelineDepth, opt.coroutine ? "true" : "false",
+                 opt.ioMode == 1 ? "io_uring" : "epoll");
+    }
+}
+
+WebServer::~WebServer() {
+    Stop();
+    for(auto& t : threads_) {
+        if(t.joinable()) {
+            t.join();
+        }
+    }
+    static const char* LANE_NAME[ThreadPool::PRIORITY_COUNT] = {"high", "normal", "low"};
+    for(size_t n = 0; n < threadpools_.size(); n++) {
+        for(int pri = 0; pri < ThreadPool::PRIORITY_COUNT; pri++) {
+            ThreadPool::LaneStats st = threadpools_[n]->Stats(static_cast<ThreadPool::PRIORITY>(pri));
+            LOG_INFO("ThreadPool[%zu] %s: submitted:%lu, executed:%lu, expired:%lu, wait avg:%luus, max:%luus",
+                     n, LANE_NAME[pri], st.submitted, st.executed, st.expired, st.waitAvgUs, st.waitMaxUs);
+        }
+    }
+    // 线程池析构时会执行完剩余的读写任务，任务里用到Reactor和连接，所以先析构线程池
+    FileCache::Instance()->SetTaskPool(nullptr);
+    threadpools_.clear();
+    taskPool_.reset();
+    reactors_.clear();
+    if(listenFd_ >= 0) {
+        close(listenFd_);
+    }
+    SqlConnPool::Instance()->ClosePool();
+    LOG_INFO("FileCache hit:%zu, miss:%zu, evict:%zu", FileCache::Instance()->HitCount(),
+             FileCache::Instance()->MissCount(), FileCache::Instance()->EvictCount());
+    if(Log::Instance()->Dropped() > 0) {
+        LOG_WARN("Log queue full, dropped %lu lines", static_cast<unsigned long>(Log::Instance()->Dropped()));
+    }
+    free(srcDir_);
+}
+
+// 每个Reactor各起一个线程(线程名、绑核都不影响调用线程)，调用线程等待它们退出
+void WebServer::Start() {
+    if(isClose_) {
+        return;
+    }
+    LOG_INFO("========== Server start ==========");
+    for(size_t i = 0; i < reactors_.size(); i++) {
+        threads_.emplace_back(&SubReactor::Loop, reactors_[i].get());
+    }
+    for(auto& t : threads_) {
+        if(t.joinable()) {
+            t.join();
+        }
+    }
+}
+
+void WebServer::Stop() {
+    isClose_ = true;
+    for(auto& reactor : reactors_) {
+        reactor->Stop();
+    }
+}
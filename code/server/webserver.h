@@ -0,0 +1,89 @@
+#ifndef WEBSERVER_H
+#define WEBSERVER_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <unistd.h>     // getcwd()
+
+#include "subreactor.h"
+#include "../log/log.h"
+#include "../pool/threadpool.h"
+#include "../pool/sqlconnpool.h"
+#include "../http/httpconn.h"
+#include "../http/filecache.h"
+
+// 服务器配置，字段按名字赋值，没改的保持默认值；各字段的含义见下面WebServer的说明
+struct ServerOptions {
+    int port = 1316;
+    int trigMode = 3;               // 0-LT  1-连接ET  2-监听ET  3-都是ET
+    int timeoutMS = 60000;          // 连接超时，0为不超时
+    bool optLinger = false;         // 优雅退出(SO_LINGER)
+
+    // MySQL
+    int sqlPort = 3306;
+    std::string sqlUser = "root";
+    std::string sqlPwd = "root";
+    std::string dbName = "webserver";
+    int connPoolNum = 12;
+
+    int threadNum = 0;              // 线程池线程数，0表示读写在Reactor线程内处理
+    int reactorNum = 0;             // 0表示按CPU核数
+
+    // 日志
+    bool openLog = true;
+    int logLevel = 1;
+    int logQueSize = 1024;          // 异步队列容量，0为同步写
+    bool logDeferred = false;       // 延迟格式化
+
+    int fileCacheMB = 64;           // 静态文件缓存大小，0为关闭
+    int pipelineDepth = 8;
+    int timerMode = 0;              // 0-小根堆  1-时间轮  2-惰性小根堆
+    bool pinThreads = false;        // 按NUMA节点绑核
+    bool coroutine = false;         // 协程处理连接(需要C++20)
+    int ioMode = 0;                 // 0-epoll  1-io_uring
+    bool reusePort = true;          // 每个Reactor一个监听socket
+};
+
+/*
+WebServer：多Reactor(one loop per thread)服务器
+1、创建reactorNum个SubReactor，每个SubReactor在自己的线程中运行事件循环
+2、各SubReactor通过SO_REUSEPORT绑定同一端口，由内核完成accept的负载均衡
+3、threadNum > 0时创建线程池处理读写；threadNum = 0时读写都在Reactor线程内完成
+4、fileCacheMB > 0时开启静态文件缓存，0表示关闭；缓存的后台任务(压缩)使用线程池，threadNum = 0时单独创建一个
+5、pipelineDepth：每个连接一次最多处理的流水线请求数，1表示逐个处理
+6、timerMode：连接超时定时器，0-小根堆  1-时间轮(适合大量空闲长连接)  2-惰性刷新的小根堆(适合频繁收发的连接)
+7、logDeferred：异步日志使用二进制延迟格式化，业务线程只拷贝参数，由日志写线程格式化
+8、pinThreads：按NUMA节点绑核。Reactor轮流分到各节点并各绑一个核，每个节点一个线程池(threadNum平分)，
+   工作线程绑在本节点的CPU上；Reactor只把任务交给本节点的线程池，连接的Buffer不会被另一个节点的线程访问
+   不绑核时所有Reactor共享一个线程池。线程名：reactor-N、workerM-N、log-writer
+9、coroutine：每个连接一个C++20协程，在Reactor线程内按顺序读、解析、写(需要-std=c++20编译，否则忽略)
+   线程池只用于文件缓存的后台任务和注册/登录的数据库验证(LOW通道，协程挂起等待)
+10、ioMode：0-epoll  1-io_uring(多次完成的accept/recv、提供缓冲区环、sendmsg+splice链，每轮一次io_uring_enter)
+   内核不支持时退回epoll；io_uring模式下连接在Reactor线程内处理，只有数据库验证交给线程池的LOW通道，
+   不能和协程模式同时使用
+11、reusePort：true-每个Reactor一个SO_REUSEPORT监听socket，内核按四元组哈希分配新连接
+   false-只创建一个监听socket，各Reactor用EPOLLEXCLUSIVE注册，新连接交给先醒的空闲Reactor
+*/
+class WebServer {
+public:
+    explicit WebServer(const ServerOptions& opt);
+
+    ~WebServer();
+    void Start();       // 阻塞，直到Stop()被调用
+    void Stop();
+
+private:
+    int port_;
+    int listenFd_;      // reusePort为false时所有Reactor共享的监听socket
+    bool isClose_;
+    char* srcDir_;      // 资源目录
+
+    std::vector<std::unique_ptr<ThreadPool>> threadpools_;    // 不绑核时只有一个，否则每个NUMA节点一个
+    std::unique_ptr<ThreadPool> taskPool_;  // threadNum = 0时，文件缓存的后台任务使用的线程池
+    std::vector<std::unique_ptr<SubReactor>> reactors_;
+    std::vector<std::thread> threads_;      // 每个SubReactor一个线程(包括第0个)
+};
+
+#endif
@@ -4,14 +4,14 @@
 void HeapTimer::siftup_(size_t i) {
     assert(i >= 0 && i < heap_.size());
     /*小根堆：特殊的完全二叉树，父节点为i，左节点为2i+1， 右节点为2i+2*/
-    size_t j = (i - 1) / 2;      // j是i的父节点
-    while(j > 0) {
+    // i为0时已经是堆顶，不能再计算父节点(size_t下溢)
+    while(i > 0) {
+        size_t j = (i - 1) / 2;      // j是i的父节点
         if(heap_[j] < heap_[i]) {
             break;
         }
         SwapNode_(i, j);
         i = j;
-        j = (i - 1) / 2;
     }
 }
 
@@ -19,8 +19,9 @@ void HeapTimer::SwapNode_(size_t i, size_t j) {
     assert(i >= 0 && i < heap_.size());
     assert(j >= 0 && j < heap_.size());
     std::swap(heap_[i], heap_[j]);
-    ref_[heap_[i].id] = j;
-    ref_[heap_[j].id] = i;
+    // 交换之后heap_[i]的新位置就是i
+    ref_[heap_[i].id] = i;
+    ref_[heap_[j].id] = j;
 }
 
 bool HeapTimer::siftdown_(size_t index, size_t n) {
@@ -29,7 +30,7 @@ bool HeapTimer::siftdown_(size_t index, size_t n) {
     size_t i = index;
     size_t j = 2 * i + 1;
     while(j < n) {
-        if(heap_[j+1] < heap_[j]) j++;      // 父节点要跟较小的那个子节点对比
+        if(j + 1 < n && heap_[j+1] < heap_[j]) j++;      // 父节点要跟较小的那个子节点对比(右子节点可能不存在)
         if(heap_[j] < heap_[i]) {
             SwapNode_(i, j);
             i = j;
@@ -49,12 +50,12 @@ void HeapTimer::add(int id, int timeout, const TimeoutCallBack& cb) {
     if(ref_.count(id) == 0) {    
         i = heap_.size();
         ref_[id] = i;
-        heap_.push_back({id, Clock::now() + MS(timeout), cb});
+        heap_.push_back({id, now_ + MS(timeout), now_ + MS(timeout), cb});
         siftup_(i);
     /*已有节点，调整堆*/
     } else {
         i = ref_[id];
-        heap_[i].expires = Clock::now() + MS(timeout);
+        heap_[i].expires = heap_[i].deadline = now_ + MS(timeout);
         heap_[i].cb = cb;
         if(!(siftdown_(i, heap_.size()))) {
             siftup_(i);
@@ -80,6 +81,13 @@ void HeapTimer::del_(size_t index) {
     heap_.pop_back();
 }
 
+void HeapTimer::cancel(int id) {
+    auto it = ref_.find(id);
+    if(it != ref_.end()) {
+        del_(it->second);
+    }
+}
+
 // 执行回调并删除任务
 void HeapTimer::doWork(int id) {
     if(heap_.empty() || ref_.count(id) == 0) {
@@ -91,11 +99,23 @@ void HeapTimer::doWork(int id) {
     del_(i);
 }
 
-// 调整指定任务的超时时间 —— 延长时间
+// 调整指定任务的超时时间 —— 一般是延长时间；任务已经执行或取消时什么也不做(同TimingWheel)
 void HeapTimer::adjust(int id, int timeout) {
-    assert(!heap_.empty() && ref_.count(id) > 0);
-    heap_[ref_[id]].expires = Clock::now() + MS(timeout);
-    siftdown_(ref_[id], heap_.size());
+    auto it = ref_.find(id);
+    if(it == ref_.end()) {
+        return;
+    }
+    size_t i = it->second;
+    TimerNode& node = heap_[i];
+    node.deadline = now_ + MS(timeout);
+    // 惰性模式下延长时间不动堆，等到达堆顶时再处理
+    if(lazy_ && node.deadline >= node.expires) {
+        return;
+    }
+    node.expires = node.deadline;
+    if(!siftdown_(i, heap_.size())) {
+        siftup_(i);
+    }
 }
 
 // 检查并执行所有已超时任务
@@ -105,14 +125,21 @@ void HeapTimer::tick() {
     }
     // 堆顶时间最小，循环检查堆顶超时时间
     while(!heap_.empty()) {
-        TimerNode node = heap_.front();
-        // std::chrono::duration_cast<MS>()：将时间差转换为毫秒
-        // .count()：提取毫秒数
-        if(std::chrono::duration_cast<MS>(node.expires - Clock::now()).count() > 0) {
+        // 只有到期的节点才需要取出回调，用引用避免每次都拷贝std::function
+        TimerNode& top = heap_.front();
+        if(top.expires > now_) {
             break;
         }
-        node.cb();
+        // 惰性模式：期间有过活动，按真正的超时时间重新下沉
+        if(top.deadline > now_) {
+            top.expires = top.deadline;
+            siftdown_(0, heap_.size());
+            continue;
+        }
+        // 先出堆再执行回调，回调里可能会add/cancel
+        TimeoutCallBack cb = std::move(top.cb);
         pop();
+        cb();
     }
 }
 
@@ -128,9 +155,11 @@ void HeapTimer::clear() {
 
 int HeapTimer::GetNextTick() {
     tick();
-    size_t res = -1;
+    // 用有符号数，否则res < 0永远不成立，已超时的任务会变成一个巨大的超时时间
+    int res = -1;
     if(!heap_.empty()) {
-        res = std::chrono::duration_cast<MS>(heap_.front().expires - Clock::now()).count();
+        // std::chrono::duration_cast<MS>()：将时间差转换为毫秒，.count()：提取毫秒数
+        res = std::chrono::duration_cast<MS>(heap_.front().expires - now_).count();
         if(res < 0) {
             res = 0;
         }
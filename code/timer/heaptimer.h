@@ -9,50 +9,55 @@
 #include <functional>
 #include <assert.h>
 #include <chrono>
+#include "timer.h"
 #include "../log/log.h"
 
-// typedef：为现有数据类型创建别名
-typedef std::function<void()> TimeoutCallBack;     // 回调函数类型
-typedef std::chrono::high_resolution_clock Clock;  // 返回按秒为单位的时间戳
-typedef std::chrono::milliseconds MS;              // 毫秒时间单位
-typedef Clock::time_point TimeStamp;               // 时间点类型，表示任务的过期时间
-
 // 一个需要定时触发的任务
 struct TimerNode {
     int id;         // 任务的唯一标识符
-    TimeStamp expires;  
+    TimeStamp expires;      // 在堆中排序用的超时时间
+    TimeStamp deadline;     // 真正的超时时间，惰性模式下adjust只更新它
     TimeoutCallBack cb;   
     bool operator<(const TimerNode& t) {
         return expires < t.expires;
     }
 };
 
-class HeapTimer {
+/*
+lazy(惰性刷新)模式：
+连接有活动时adjust只把deadline往后推，不调整堆；
+节点到达堆顶且expires到期时，发现deadline更晚就按deadline重新下沉，否则才真正超时
+这样活跃连接不论收发多少次，每个超时周期最多调整一次堆，开销只和到期次数有关
+*/
+class HeapTimer : public Timer {
 public:
-    HeapTimer() {
+    explicit HeapTimer(bool lazy = false) : lazy_(lazy) {
         heap_.reserve(64);
     }
     ~HeapTimer() {
         clear();
     }
     // 调整指定任务的超时时间
-    void adjust(int id, int newExpires);
+    void adjust(int id, int newExpires) override;
     // 添加或更新定时任务
-    void add(int id, int timeOut, const TimeoutCallBack& cb);
+    void add(int id, int timeOut, const TimeoutCallBack& cb) override;
+    // 删除任务，不执行回调
+    void cancel(int id) override;
     // 立即执行指定任务的回调并删除任务
     void doWork(int id);
     // 清空所有定时任务
-    void clear();
+    void clear() override;
     // 检查并执行所有已超时的任务
-    void tick();
+    void tick() override;
     // 删除堆顶任务
     void pop();
     // 返回距离下一个任务超时的剩余时间(毫秒)
-    int GetNextTick();
+    int GetNextTick() override;
 
 private:
     std::vector<TimerNode> heap_;               // 存储定时任务的小根堆
     std::unordered_map<int, size_t> ref_;       // 记录任务id到索引的映射
+    bool lazy_;
 
     void del_(size_t i);                        // 删除指定节点
     void siftup_(size_t i);                     // 插入新节点时向上调整堆
@@ -0,0 +1,51 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <functional>
+#include <chrono>
+
+// typedef：为现有数据类型创建别名
+typedef std::function<void()> TimeoutCallBack;     // 回调函数类型
+typedef std::chrono::steady_clock Clock;           // 单调时钟，不受系统时间调整影响
+typedef std::chrono::milliseconds MS;              // 毫秒时间单位
+typedef Clock::time_point TimeStamp;               // 时间点类型，表示任务的过期时间
+
+/*
+Timer：定时器接口，id为连接的fd，超时时间单位为毫秒
+实现：HeapTimer(小根堆)、TimingWheel(分层时间轮)，由WebServer启动时选择
+定时器只在所属Reactor线程内使用，不加锁
+当前时间是缓存的：事件循环每次epoll_wait返回后UpdateNow()一次，
+同一轮里的add/adjust/tick都用这个时间，不再每个事件读一次时钟；GetNextTick()之前再刷新一次
+*/
+class Timer {
+public:
+    virtual ~Timer() = default;
+
+    // 添加定时任务；id已存在时更新超时时间和回调
+    virtual void add(int id, int timeout, const TimeoutCallBack& cb) = 0;
+    // 重新设置已有任务的超时时间(连接有活动时延长)
+    virtual void adjust(int id, int timeout) = 0;
+    // 删除任务，不执行回调；id不存在时什么也不做
+    virtual void cancel(int id) = 0;
+    // 执行所有已超时任务的回调
+    virtual void tick() = 0;
+    // 先tick()，再返回距离下一个任务超时的剩余时间(毫秒)，没有任务返回-1
+    virtual int GetNextTick() = 0;
+    // 清空所有定时任务
+    virtual void clear() = 0;
+
+    // 刷新缓存的当前时间
+    void UpdateNow() {
+        now_ = Clock::now();
+    }
+    TimeStamp Now() const {
+        return now_;
+    }
+
+protected:
+    Timer() : now_(Clock::now()) {}
+
+    TimeStamp now_;
+};
+
+#endif
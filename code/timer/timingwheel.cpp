@@ -0,0 +1,173 @@
+#include "timingwheel.h"
+
+TimingWheel::TimingWheel(int tickMS) :
+    tickMS_(tickMS > 0 ? tickMS : 1), start_(now_), current_(0), count_(0),
+    slots_(ROOT_SIZE + (LEVELS - 1) * LEVEL_SIZE, -1) {}
+
+int64_t TimingWheel::NowMS_() const {
+    return std::chrono::duration_cast<MS>(now_ - start_).count();
+}
+
+// 向上取整，保证不会提前超时
+uint64_t TimingWheel::ExpireTick_(int timeout) const {
+    if(timeout < 0) {
+        timeout = 0;
+    }
+    return NowMS_() / tickMS_ + (timeout + tickMS_ - 1) / tickMS_;
+}
+
+int TimingWheel::SlotOf_(int level, uint64_t tick) const {
+    if(level == 0) {
+        return tick & (ROOT_SIZE - 1);
+    }
+    int shift = ROOT_BITS + (level - 1) * LEVEL_BITS;
+    return ROOT_SIZE + (level - 1) * LEVEL_SIZE + ((tick >> shift) & (LEVEL_SIZE - 1));
+}
+
+/* 按到期时间与current_之差选层：
+差值 < 2^8 放第0层，< 2^14 放第1层，< 2^20 放第2层……
+已经过期的任务放到current_对应的槽，下一次tick就会执行
+*/
+void TimingWheel::Link_(int id) {
+    Node& node = nodes_[id];
+    if(node.expires < current_) {
+        node.expires = current_;
+    }
+    uint64_t delta = node.expires - current_;
+    int level = 0;
+    while(level < LEVELS - 1 && delta >= (1ULL << (ROOT_BITS + level * LEVEL_BITS))) {
+        level++;
+    }
+    int slot = SlotOf_(level, node.expires);
+    node.slot = slot;
+    node.prev = -1;
+    node.next = slots_[slot];
+    if(node.next != -1) {
+        nodes_[node.next].prev = id;
+    }
+    slots_[slot] = id;
+}
+
+void TimingWheel::Unlink_(int id) {
+    Node& node = nodes_[id];
+    assert(node.slot != -1);
+    if(node.prev != -1) {
+        nodes_[node.prev].next = node.next;
+    } else {
+        slots_[node.slot] = node.next;
+    }
+    if(node.next != -1) {
+        nodes_[node.next].prev = node.prev;
+    }
+    node.prev = node.next = node.slot = -1;
+}
+
+void TimingWheel::add(int id, int timeout, const TimeoutCallBack& cb) {
+    assert(id >= 0);
+    if(static_cast<size_t>(id) >= nodes_.size()) {
+        nodes_.resize(std::max(static_cast<size_t>(id) + 1, nodes_.size() * 2),
+                      Node{-1, -1, -1, 0, nullptr});
+    }
+    Node& node = nodes_[id];
+    if(node.slot != -1) {
+        Unlink_(id);
+    } else {
+        count_++;
+    }
+    node.expires = ExpireTick_(timeout);
+    node.cb = cb;
+    Link_(id);
+}
+
+// 只是把节点挪到另一个槽，不拷贝回调
+void TimingWheel::adjust(int id, int timeout) {
+    if(id < 0 || static_cast<size_t>(id) >= nodes_.size() || nodes_[id].slot == -1) {
+        return;
+    }
+    Unlink_(id);
+    nodes_[id].expires = ExpireTick_(timeout);
+    Link_(id);
+}
+
+void TimingWheel::cancel(int id) {
+    if(id < 0 || static_cast<size_t>(id) >= nodes_.size() || nodes_[id].slot == -1) {
+        return;
+    }
+    Unlink_(id);
+    nodes_[id].cb = nullptr;
+    count_--;
+}
+
+// 整个链表摘下来后逐个重新放入，这时它们离到期更近了，会落到更低的层
+void TimingWheel::Cascade_(int slot) {
+    int id = slots_[slot];
+    slots_[slot] = -1;
+    while(id != -1) {
+        int next = nodes_[id].next;
+        Link_(id);
+        id = next;
+    }
+}
+
+void TimingWheel::Advance_() {
+    int idx = SlotOf_(0, current_);
+    // 第0层转完一圈：上一层当前槽的任务分配下来；上一层也刚好转完一圈则继续向上
+    if(idx == 0) {
+        for(int level = 1; level < LEVELS; level++) {
+            int slot = SlotOf_(level, current_);
+            Cascade_(slot);
+            if(slot != ROOT_SIZE + (level - 1) * LEVEL_SIZE) {
+                break;
+            }
+        }
+    }
+    // 先摘下节点再执行回调，回调里可能会add/cancel
+    while(slots_[idx] != -1) {
+        int id = slots_[idx];
+        Unlink_(id);
+        count_--;
+        TimeoutCallBack cb;
+        cb.swap(nodes_[id].cb);
+        cb();
+    }
+    current_++;
+}
+
+void TimingWheel::tick() {
+    uint64_t now = NowMS_() / tickMS_;
+    while(current_ <= now) {
+        // 没有任务时不需要逐个tick空转
+        if(count_ == 0) {
+            current_ = now + 1;
+            break;
+        }
+        Advance_();
+    }
+}
+
+/* 只在第0层向后找最近的非空槽；第0层到这一圈结束都是空的，
+就在这一圈结束时醒来一次，把上层的任务分配下来
+*/
+int TimingWheel::GetNextTick() {
+    tick();
+    if(count_ == 0) {
+        return -1;
+    }
+    uint64_t next = current_;
+    for(int k = 0; k < ROOT_SIZE; k++, next++) {
+        if(k > 0 && SlotOf_(0, next) == 0) {
+            break;
+        }
+        if(slots_[SlotOf_(0, next)] != -1) {
+            break;
+        }
+    }
+    int64_t res = static_cast<int64_t>(next) * tickMS_ - NowMS_();
+    return res > 0 ? static_cast<int>(res) : 0;
+}
+
+void TimingWheel::clear() {
+    nodes_.clear();
+    std::fill(slots_.begin(), slots_.end(), -1);
+    count_ = 0;
+}
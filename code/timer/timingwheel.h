@@ -0,0 +1,66 @@
+#ifndef TIMING_WHEEL_H
+#define TIMING_WHEEL_H
+
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <assert.h>
+#include "timer.h"
+
+/*
+TimingWheel：分层时间轮(与Linux内核早期的定时器相同)
+1、第0层256个槽，每槽一个tick；第1~4层各64个槽，每槽对应下一层转一圈的时间
+   tickMS = 1时各层覆盖的范围：256ms、16s、17min、18h、49天
+2、任务按到期tick与当前tick之差放进对应层的槽里；第0层每转完一圈，把上一层当前槽的任务重新分配到下层
+3、节点按id(fd)直接存放在数组里，槽内是以数组下标串起来的双向链表：
+   add/adjust/cancel都是O(1)，不需要哈希查找，也不需要堆调整
+4、tick()的开销只与经过的tick数、到期的任务数有关，与连接数无关；没有任务时直接跳到当前时间
+*/
+class TimingWheel : public Timer {
+public:
+    explicit TimingWheel(int tickMS = 1);
+    ~TimingWheel() = default;
+
+    void add(int id, int timeout, const TimeoutCallBack& cb) override;
+    void adjust(int id, int timeout) override;
+    void cancel(int id) override;
+    void tick() override;
+    int GetNextTick() override;
+    void clear() override;
+
+    size_t size() const {
+        return count_;
+    }
+
+private:
+    struct Node {
+        int prev;           // 槽内链表的前后节点，-1表示没有
+        int next;
+        int slot;           // 所在的槽，-1表示不在时间轮上
+        uint64_t expires;   // 到期的tick
+        TimeoutCallBack cb;
+    };
+
+    static const int ROOT_BITS = 8;
+    static const int LEVEL_BITS = 6;
+    static const int LEVELS = 5;                    // 第0层 + 4个上层
+    static const int ROOT_SIZE = 1 << ROOT_BITS;
+    static const int LEVEL_SIZE = 1 << LEVEL_BITS;
+
+    int64_t NowMS_() const;             // 从start_到缓存的当前时间经过的毫秒数
+    uint64_t ExpireTick_(int timeout) const;
+    int SlotOf_(int level, uint64_t tick) const;    // 第level层中tick对应的槽(slots_下标)
+    void Link_(int id);                 // 按expires放入对应的槽
+    void Unlink_(int id);
+    void Cascade_(int slot);            // 把槽中的任务重新分配到下层
+    void Advance_();                    // 处理current_这个tick，执行到期任务
+
+    int tickMS_;
+    TimeStamp start_;
+    uint64_t current_;              // 下一个要处理的tick
+    size_t count_;                  // 时间轮上的任务数
+    std::vector<Node> nodes_;       // 按id下标存放
+    std::vector<int> slots_;        // 各槽链表头：第0层的ROOT_SIZE个在前，之后每层LEVEL_SIZE个
+};
+
+#endif
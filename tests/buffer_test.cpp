@@ -1,6 +1,10 @@
-#include "src/buffer.h"
+#include "../code/buffer/buffer.h"
+#include "../code/buffer/chainbuffer.h"
 #include <gtest/gtest.h>
+#include <fcntl.h>
+#include <set>
 #include <thread>
+#include <vector>
 
 // 基础功能测试
 TEST(BufferTest, BasicReadWrite) {
@@ -21,6 +25,176 @@ TEST(BufferTest, AutoExpand) {
     EXPECT_GE(buf.WritableBytes(), bigStr.size());
 }
 
+// 懒分配：容量为0时不占内存，第一次写入才分配；Release后回到0
+TEST(BufferTest, LazyAllocAndRelease) {
+    Buffer buf(0);
+    EXPECT_EQ(buf.WritableBytes(), 0u);
+    EXPECT_EQ(buf.ReadableBytes(), 0u);
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    ASSERT_EQ(write(fds[1], "GET / HTTP/1.1\r\n", 16), 16);
+    int err = 0;
+    EXPECT_EQ(buf.ReadFd(fds[0], &err), 16);
+    EXPECT_EQ(std::string(buf.Peek(), buf.ReadableBytes()), "GET / HTTP/1.1\r\n");
+    buf.RetrieveAll();
+    buf.Release();
+    EXPECT_EQ(buf.WritableBytes() + buf.PrependableBytes(), 0u);
+    buf.Append("again", 5);
+    EXPECT_EQ(std::string(buf.Peek(), buf.ReadableBytes()), "again");
+    buf.RetrieveAll();
+    buf.Release();
+
+    // 空Buffer读不到数据(EAGAIN)时，为读借的块马上还回去
+    size_t inUse = BufferPool::BytesInUse();
+    fcntl(fds[0], F_SETFL, O_NONBLOCK);
+    EXPECT_EQ(buf.ReadFd(fds[0], &err), -1);
+    EXPECT_EQ(err, EAGAIN);
+    EXPECT_EQ(buf.WritableBytes(), 0u);
+    EXPECT_EQ(BufferPool::BytesInUse(), inUse);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+// 分级：4K/16K/64K，超过64K按4K取整直接分配
+TEST(BufferPoolTest, SizeClasses) {
+    size_t before = BufferPool::BytesInUse();
+    size_t cap[4];
+    char* p[4];
+    p[0] = BufferPool::Allocate(1, &cap[0]);
+    p[1] = BufferPool::Allocate(5000, &cap[1]);
+    p[2] = BufferPool::Allocate(65536, &cap[2]);
+    p[3] = BufferPool::Allocate(70000, &cap[3]);
+    EXPECT_EQ(cap[0], 4096u);
+    EXPECT_EQ(cap[1], 16384u);
+    EXPECT_EQ(cap[2], 65536u);
+    EXPECT_EQ(cap[3], 73728u);
+    EXPECT_EQ(BufferPool::BytesInUse(), before + 4096 + 16384 + 65536 + 73728);
+    for(int i = 0; i < 4; i++) {
+        memset(p[i], 'x', cap[i]);
+        BufferPool::Free(p[i], cap[i]);
+    }
+    EXPECT_EQ(BufferPool::BytesInUse(), before);
+
+    // 本线程刚归还的块马上被重用
+    size_t c;
+    char* q = BufferPool::Allocate(100, &c);
+    EXPECT_EQ(q, p[0]);
+    BufferPool::Free(q, c);
+}
+
+// 线程退出时本地缓存交给全局仓库，别的线程可以取到
+TEST(BufferPoolTest, ThreadExitReturnsToDepot) {
+    const int N = 8;
+    std::vector<char*> blocks;
+    std::thread t([&blocks] {
+        size_t c;
+        for(int i = 0; i < N; i++) {
+            blocks.push_back(BufferPool::Allocate(16384, &c));
+        }
+        for(char* b : blocks) {
+            BufferPool::Free(b, c);
+        }
+    });
+    t.join();
+    std::set<char*> theirs(blocks.begin(), blocks.end());
+    // 先把本线程16K一级的本地缓存用完，之后分配的块来自仓库
+    std::vector<char*> mine;
+    int fromDepot = 0;
+    for(size_t i = 0; i < BufferPool::LOCAL_MAX_BYTES / 16384 + N; i++) {
+        size_t c;
+        mine.push_back(BufferPool::Allocate(16384, &c));
+        fromDepot += theirs.count(mine.back());
+    }
+    EXPECT_EQ(fromDepot, N);
+    for(char* b : mine) {
+        BufferPool::Free(b, 16384);
+    }
+}
+
+// 扩容换一块更大的：只搬可读部分，旧块还回池里
+TEST(BufferPoolTest, BufferGrowsAcrossClasses) {
+    size_t before = BufferPool::BytesInUse();
+    {
+        Buffer buf(0);
+        std::string data(3000, 'a');
+        buf.Append(data);
+        EXPECT_EQ(BufferPool::BytesInUse(), before + 4096);
+        buf.Retrieve(2000);
+        buf.Append(std::string(5000, 'b'));
+        EXPECT_EQ(BufferPool::BytesInUse(), before + 16384);
+        EXPECT_EQ(buf.ReadableBytes(), 6000u);
+        EXPECT_EQ(buf.Peek()[999], 'a');
+        EXPECT_EQ(buf.Peek()[1000], 'b');
+    }
+    EXPECT_EQ(BufferPool::BytesInUse(), before);
+}
+
+// 链式缓冲区：拷贝追加跨块不搬移，按引用追加不拷贝，导出的iovec按追加顺序排列
+TEST(ChainBufferTest, AppendAndPeekIov) {
+    const size_t BLOCK = ChainBuffer::BLOCK_BYTES;
+    size_t before = BufferPool::BytesInUse();
+    ChainBuffer buf;
+    EXPECT_EQ(buf.IovCount(), 0);
+    std::string head(BLOCK + 100, 'h');
+    buf.Append(head);
+    EXPECT_EQ(BufferPool::BytesInUse(), before + 2 * BLOCK);
+    std::string file(100000, 'f');
+    buf.AppendRef(file.data(), file.size());
+    buf.Append("\r\n", 2);
+
+    struct iovec iov[8];
+    ASSERT_EQ(buf.PeekIov(iov, 8), 4);
+    EXPECT_EQ(iov[0].iov_len, BLOCK);
+    EXPECT_EQ(iov[1].iov_len, 100u);
+    EXPECT_EQ(iov[2].iov_base, file.data());     // 没有拷贝
+    EXPECT_EQ(iov[2].iov_len, file.size());
+    EXPECT_EQ(iov[3].iov_len, 2u);
+    EXPECT_EQ(BufferPool::BytesInUse(), before + 3 * BLOCK);
+    EXPECT_EQ(buf.ReadableBytes(), head.size() + file.size() + 2);
+
+    // 跨段的部分发送：读完的块马上还回池里，剩下的从中间继续
+    buf.Retrieve(BLOCK + 150);
+    EXPECT_EQ(BufferPool::BytesInUse(), before + BLOCK);
+    ASSERT_EQ(buf.PeekIov(iov, 8), 2);
+    EXPECT_EQ(iov[0].iov_base, file.data() + 50);
+    EXPECT_EQ(buf.RetrieveAllToStr(), file.substr(50) + "\r\n");
+    EXPECT_EQ(BufferPool::BytesInUse(), before);
+}
+
+// 写满一块接新块，读完的块还回去；writev按导出的iovec发出
+TEST(ChainBufferTest, WriteFd) {
+    const size_t BLOCK = ChainBuffer::BLOCK_BYTES;
+    size_t before = BufferPool::BytesInUse();
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    std::string data(3 * BLOCK + 10, 'x');
+    for(size_t i = 0; i < data.size(); i++) {
+        data[i] = static_cast<char>('a' + i % 26);
+    }
+    ChainBuffer buf;
+    buf.Append(data);
+    EXPECT_EQ(buf.IovCount(), 4);
+    EXPECT_EQ(BufferPool::BytesInUse(), before + 4 * BLOCK);
+
+    // 尾块还有空间，先写进尾块
+    buf.Append("tail", 4);
+    EXPECT_EQ(buf.IovCount(), 4);
+
+    std::string ref = "-ref";
+    buf.AppendRef(ref.data(), ref.size());
+    int err = 0;
+    EXPECT_EQ(buf.WriteFd(fds[1], &err), static_cast<ssize_t>(data.size() + 8));
+    EXPECT_EQ(buf.ReadableBytes(), 0u);
+    EXPECT_EQ(buf.IovCount(), 0);
+    EXPECT_EQ(BufferPool::BytesInUse(), before);
+
+    std::string out(data.size() + 8, '\0');
+    ASSERT_EQ(read(fds[0], &out[0], out.size()), static_cast<ssize_t>(out.size()));
+    EXPECT_EQ(out, data + "tail-ref");
+    close(fds[0]);
+    close(fds[1]);
+}
+
 // 多线程测试
 TEST(BufferTest, ThreadSafety) {
     Buffer buf;
@@ -55,4 +229,42 @@ TEST(BufferTest, FileIO) {
     EXPECT_EQ(std::string(buf.Peek(), buf.ReadableBytes()), content);
     
     close(fd);
-}
\ No newline at end of file
+}
+
+// 分隔符查找测试：覆盖SIMD分组边界和尾部逐字节查找
+TEST(BufferTest, FindCRLF) {
+    for(size_t pos = 0; pos < 100; ++pos) {
+        Buffer buf;
+        std::string s(pos, 'a');
+        s += "\r\n";
+        s += std::string(50, 'b');
+        buf.Append(s);
+        EXPECT_EQ(buf.FindCRLF(), pos);
+        EXPECT_EQ(buf.FindCRLF(pos + 1), Buffer::npos);
+    }
+    // 单独的'\r'或'\n'不算
+    Buffer buf;
+    buf.Append(std::string(40, 'x') + "\r" + std::string(40, 'y') + "\n\n\r");
+    EXPECT_EQ(buf.FindCRLF(), Buffer::npos);
+}
+
+// 数据分两次到达时从上次的位置继续查找
+TEST(BufferTest, FindCRLFResume) {
+    Buffer buf;
+    buf.Append("GET / HTTP/1.1\r");
+    size_t scanned = buf.ReadableBytes();
+    EXPECT_EQ(buf.FindCRLF(), Buffer::npos);
+    buf.Append("\nHost: a\r\n\r\n");
+    EXPECT_EQ(buf.FindCRLF(scanned - 1), 14u);
+}
+
+TEST(BufferTest, FindCRLFCRLF) {
+    Buffer buf;
+    std::string head = "GET / HTTP/1.1\r\nHost: a\r\nCookie: " + std::string(200, 'c') + "\r\n";
+    buf.Append(head);
+    EXPECT_EQ(buf.FindCRLFCRLF(), Buffer::npos);
+    buf.Append("\r\nbody");
+    EXPECT_EQ(buf.FindCRLFCRLF(), head.size() - 2);
+    EXPECT_EQ(buf.Find(':'), 20u);
+    EXPECT_EQ(buf.Find('#'), Buffer::npos);
+}
@@ -0,0 +1,131 @@
+#include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "../code/coro/iocontext.h"
+#include "../code/timer/heaptimer.h"
+
+static Co<int> Add(int a, int b) {
+    co_return a + b;
+}
+
+static Co<int> Sum(int n) {
+    int s = 0;
+    for(int i = 0; i < n; i++) {
+        s = co_await Add(s, i);
+    }
+    co_return s;
+}
+
+TEST(CoroTest, NestedCoAwait) {
+    int result = -1;
+    Spawn([](int& out) -> Co<void> {
+        out = co_await Sum(100);
+    }(result));
+    EXPECT_EQ(result, 4950);
+}
+
+// 协程帧用完放回当前线程的空闲链表，下次直接复用
+static Co<void> RunSum() {
+    co_await Sum(10);
+}
+
+TEST(CoroTest, FramesAreReused) {
+    Spawn(RunSum());
+    size_t cached = FramePool::CachedBlocks();
+    EXPECT_GT(cached, 0u);
+    Spawn(RunSum());
+    EXPECT_EQ(FramePool::CachedBlocks(), cached);
+}
+
+class IoContextTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds_), 0);
+        epoller_.AddFd(fds_[0], EPOLLONESHOT);
+        io_.reset(new IoContext(&epoller_, &timer_, EPOLLONESHOT | EPOLLRDHUP));
+    }
+    void TearDown() override {
+        io_->CancelAll();
+        io_->RunReady();
+        io_.reset();
+        close(fds_[0]);
+        close(fds_[1]);
+    }
+
+    // 跑一轮事件循环：定时器 -> 就绪队列 -> epoll事件
+    void Poll(int timeoutMs) {
+        timer_.UpdateNow();
+        int next = timer_.GetNextTick();
+        io_->RunReady();
+        int n = epoller_.Wait(next >= 0 && next < timeoutMs ? next : timeoutMs);
+        timer_.UpdateNow();
+        for(int i = 0; i < n; i++) {
+            io_->Dispatch(epoller_.GetEventFd(i), epoller_.GetEvents(i));
+        }
+    }
+
+    int fds_[2];
+    Epoller epoller_;
+    HeapTimer timer_;
+    std::unique_ptr<IoContext> io_;
+};
+
+// 没有数据时挂起，对端写入后由Dispatch恢复，按顺序读完一行
+TEST_F(IoContextTest, ReadableResumesReader) {
+    std::string got;
+    bool done = false;
+    Spawn([](IoContext& io, int fd, std::string& out, bool& fin) -> Co<void> {
+        char buf[64];
+        while(out.find('\n') == std::string::npos) {
+            ssize_t n = read(fd, buf, sizeof(buf));
+            if(n > 0) {
+                out.append(buf, n);
+            } else if(co_await io.Readable(fd) == 0) {
+                break;
+            }
+        }
+        fin = true;
+    }(*io_, fds_[0], got, done));
+    EXPECT_FALSE(done);
+    EXPECT_TRUE(io_->HasWaiter(fds_[0]));
+
+    ASSERT_EQ(write(fds_[1], "hel", 3), 3);
+    Poll(100);
+    EXPECT_FALSE(done);
+    ASSERT_EQ(write(fds_[1], "lo\n", 3), 3);
+    Poll(100);
+    EXPECT_TRUE(done);
+    EXPECT_EQ(got, "hello\n");
+}
+
+TEST_F(IoContextTest, SleepAndCancel) {
+    std::vector<int> order;
+    uint32_t cancelled = 1;
+    Spawn([](IoContext& io, std::vector<int>& out) -> Co<void> {
+        co_await io.SleepFor(30);
+        out.push_back(30);
+    }(*io_, order));
+    Spawn([](IoContext& io, std::vector<int>& out) -> Co<void> {
+        co_await io.SleepFor(10);
+        out.push_back(10);
+    }(*io_, order));
+    Spawn([](IoContext& io, int fd, uint32_t& res) -> Co<void> {
+        res = co_await io.Readable(fd);
+    }(*io_, fds_[0], cancelled));
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    while(order.size() < 2 && std::chrono::steady_clock::now() < deadline) {
+        Poll(10);
+    }
+    EXPECT_EQ(order, (std::vector<int>{10, 30}));
+
+    // 连接超时时Reactor调用Cancel，等待以0返回
+    io_->Cancel(fds_[0]);
+    EXPECT_EQ(cancelled, 1u);
+    io_->RunReady();
+    EXPECT_EQ(cancelled, 0u);
+}
@@ -0,0 +1,147 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "../code/http/httpresponse.h"
+#include "../code/http/filecache.h"
+#include "../code/pool/threadpool.h"
+
+// 同一版本的文件key相同；mtime的纳秒部分、大小、inode、编码任意一个不同，key就不同
+TEST(FileCacheTest, VariantKey) {
+    struct stat st = {};
+    st.st_mtim.tv_sec = 1700000000;
+    st.st_mtim.tv_nsec = 100;
+    st.st_size = 4096;
+    st.st_ino = 42;
+    std::string key = FileCache::VariantKey("/a.txt", st, "gzip");
+    EXPECT_EQ(FileCache::VariantKey("/a.txt", st, "gzip"), key);
+    EXPECT_NE(FileCache::VariantKey("/a.txt", st, "deflate"), key);
+    EXPECT_NE(FileCache::VariantKey("/b.txt", st, "gzip"), key);
+    struct stat other = st;
+    other.st_mtim.tv_nsec = 200;
+    EXPECT_NE(FileCache::VariantKey("/a.txt", other, "gzip"), key);
+    other = st;
+    other.st_size = 4097;
+    EXPECT_NE(FileCache::VariantKey("/a.txt", other, "gzip"), key);
+    other = st;
+    other.st_ino = 43;
+    EXPECT_NE(FileCache::VariantKey("/a.txt", other, "gzip"), key);
+
+    FileCache::Entry entry;
+    entry.mtime = st.st_mtim.tv_sec;
+    entry.mtimeNsec = st.st_mtim.tv_nsec;
+    entry.size = st.st_size;
+    entry.ino = st.st_ino;
+    EXPECT_TRUE(FileCache::SameVersion(st, entry));
+    other = st;
+    other.st_mtim.tv_nsec = 200;
+    EXPECT_FALSE(FileCache::SameVersion(other, entry));
+}
+
+/*
+内容协商：缓存打开、有后台线程池时，第一次请求发送原文件并在后台压缩，之后命中压缩变体；
+文件在同一秒内被改写(大小不变，只有mtime的纳秒部分不同)，旧变体不能再被命中
+*/
+class NegotiationTest : public ::testing::Test {
+protected:
+    static void SetUpTestSuite() {
+        char tmpl[] = "/tmp/filecache_test_XXXXXX";
+        ASSERT_NE(mkdtemp(tmpl), nullptr);
+        dir_ = tmpl;
+        pool_ = new ThreadPool(2, "compress");
+        FileCache::Instance()->Init(dir_, 16 * 1024 * 1024);
+        FileCache::Instance()->SetTaskPool(pool_);
+    }
+
+    static void TearDownTestSuite() {
+        FileCache::Instance()->SetTaskPool(nullptr);
+        delete pool_;
+        unlink((dir_ + "/page.html").c_str());
+        rmdir(dir_.c_str());
+    }
+
+    // 写入文件，mtime设为一天前的固定秒数加上nsec纳秒
+    static void WriteFile_(const std::string& data, long nsec) {
+        std::string file = dir_ + "/page.html";
+        int fd = open(file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        ASSERT_GE(fd, 0);
+        ASSERT_EQ(write(fd, data.data(), data.size()), static_cast<ssize_t>(data.size()));
+        struct timespec ts[2];
+        ts[0].tv_sec = time(nullptr) / 86400 * 86400 - 86400;
+        ts[0].tv_nsec = nsec;
+        ts[1] = ts[0];
+        ASSERT_EQ(futimens(fd, ts), 0);
+        close(fd);
+    }
+
+    // 返回Content-Encoding，响应体放在body里
+    std::string Get_(bool gzip, bool deflate, std::string* body) {
+        std::string path = "/page.html";
+        HttpResponse response;
+        response.Init(dir_, path, true, 200);
+        response.SetAcceptEncoding(gzip, deflate);
+        ChainBuffer buff;
+        response.MakeResponse(buff);
+        std::string head = buff.RetrieveAllToStr();
+        EXPECT_EQ(response.Code(), 200);
+        body->assign(response.File(), response.FileLen());
+        size_t pos = head.find("\r\nContent-Encoding: ");
+        if(pos == std::string::npos) {
+            return "";
+        }
+        pos += 20;
+        return head.substr(pos, head.find("\r\n", pos) - pos);
+    }
+
+    // 等后台任务生成变体
+    std::string WaitVariant_(bool gzip, bool deflate, std::string* body) {
+        std::string encoding;
+        for(int i = 0; i < 200 && encoding.empty(); i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            encoding = Get_(gzip, deflate, body);
+        }
+        return encoding;
+    }
+
+    static std::string dir_;
+    static ThreadPool* pool_;
+};
+
+std::string NegotiationTest::dir_;
+ThreadPool* NegotiationTest::pool_;
+
+TEST_F(NegotiationTest, VariantHitAndMiss) {
+    std::string page(8192, 'a');
+    WriteFile_(page, 100);
+    std::string body;
+    // 第一次：没有变体，发送原文件
+    EXPECT_EQ(Get_(true, true, &body), "");
+    EXPECT_EQ(body, page);
+    // 之后命中gzip变体
+    ASSERT_EQ(WaitVariant_(true, true, &body), "gzip");
+    ASSERT_GE(body.size(), 2u);
+    EXPECT_LT(body.size(), page.size());
+    EXPECT_EQ(static_cast<unsigned char>(body[0]), 0x1f);
+    EXPECT_EQ(static_cast<unsigned char>(body[1]), 0x8b);
+    // 不接受压缩的客户端拿到原文件
+    EXPECT_EQ(Get_(false, false, &body), "");
+    EXPECT_EQ(body, page);
+    // 只接受deflate：gzip变体不能用，单独生成
+    ASSERT_EQ(WaitVariant_(false, true, &body), "deflate");
+
+    // 同一秒内改写，大小不变：等缓存发现文件变化(inotify，或者按mtime复查)
+    std::string changed(8192, 'b');
+    WriteFile_(changed, 200);
+    for(int i = 0; i < 300 && FileCache::Instance()->Get("/page.html"); i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_EQ(FileCache::Instance()->Get("/page.html"), nullptr);
+    // 旧变体的key对不上：发送新的原文件，而不是旧内容压缩的结果
+    EXPECT_EQ(Get_(true, true, &body), "");
+    EXPECT_EQ(body, changed);
+    ASSERT_EQ(WaitVariant_(true, true, &body), "gzip");
+    EXPECT_LT(body.size(), changed.size());
+}
@@ -0,0 +1,132 @@
+// 请求解析基准测试：状态机解析(HttpRequest::parse) vs 原来的std::regex逐行解析
+// 用法：./httprequest_bench [次数]
+#include "../code/http/httprequest.h"
+#include "../code/buffer/buffer.h"
+#include <chrono>
+#include <regex>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+// 统计堆分配次数，用来确认新解析器在常见情况下不分配内存
+static size_t g_allocs = 0;
+void* operator new(size_t n) {
+    g_allocs++;
+    if(void* p = malloc(n)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept {
+    free(p);
+}
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+static const char REQUEST[] =
+    "GET /css/bootstrap.min.css HTTP/1.1\r\n"
+    "Host: www.example.com\r\n"
+    "Connection: keep-alive\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/120.0 Safari/537.36\r\n"
+    "Accept: text/css,*/*;q=0.1\r\n"
+    "Accept-Encoding: gzip, deflate, br\r\n"
+    "Accept-Language: zh-CN,zh;q=0.9,en;q=0.8\r\n"
+    "Referer: http://www.example.com/index.html\r\n"
+    "Cookie: session=0123456789abcdef; theme=dark; tracking=abcdefabcdefabcdef\r\n"
+    "Cache-Control: no-cache\r\n"
+    "\r\n";
+
+// 原来的解析方式：每行拷贝成string，每行重新构造std::regex
+static bool LegacyParse(Buffer& buff, std::unordered_map<std::string, std::string>& header,
+                        std::string& method, std::string& path, std::string& version) {
+    const char CRLF[] = "\r\n";
+    bool requestLine = true;
+    while(buff.ReadableBytes()) {
+        const char* lineEnd = std::search(buff.Peek(), buff.BeginWriteConst(), CRLF, CRLF + 2);
+        if(lineEnd == buff.BeginWriteConst()) {
+            break;
+        }
+        std::string line(buff.Peek(), lineEnd);
+        if(requestLine) {
+            std::regex patten("^([^ ]*) ([^ ]*) HTTP/([^ ]*)$");
+            std::smatch subMatch;
+            if(!std::regex_match(line, subMatch, patten)) {
+                return false;
+            }
+            method = subMatch[1];
+            path = subMatch[2];
+            version = subMatch[3];
+            requestLine = false;
+        } else {
+            std::regex patten("^([^:]*): ?(.*)$");
+            std::smatch subMatch;
+            if(std::regex_match(line, subMatch, patten)) {
+                header[subMatch[1]] = subMatch[2];
+            } else {
+                buff.RetrieveUntil(lineEnd + 2);
+                break;
+            }
+        }
+        buff.RetrieveUntil(lineEnd + 2);
+    }
+    return true;
+}
+
+template<class F>
+static void Run(const char* name, int n, F&& f) {
+    size_t allocs = g_allocs;
+    auto start = std::chrono::steady_clock::now();
+    for(int i = 0; i < n; i++) {
+        f();
+    }
+    auto cost = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    printf("%-10s %10.1f ns/req %12.0f req/s %8.2f allocs/req\n", name,
+           (double)cost / n, n * 1e9 / cost, (double)(g_allocs - allocs) / n);
+}
+
+int main(int argc, char* argv[]) {
+    int n = argc > 1 ? atoi(argv[1]) : 200000;
+    const size_t len = sizeof(REQUEST) - 1;
+    Buffer buff(4096);
+
+    {
+        std::unordered_map<std::string, std::string> header;
+        std::string method, path, version;
+        Run("regex", n / 20 > 0 ? n / 20 : 1, [&] {
+            buff.Append(REQUEST, len);
+            header.clear();
+            LegacyParse(buff, header, method, path, version);
+        });
+    }
+    {
+        HttpRequest request;
+        // 先跑一次，让path_等string分配好容量
+        buff.Append(REQUEST, len);
+        request.parse(buff);
+        Run("state", n, [&] {
+            buff.Append(REQUEST, len);
+            if(request.parse(buff) != HttpRequest::GET_REQUSET) {
+                abort();
+            }
+        });
+    }
+    {
+        // 数据分两次到达，验证断点续解析的开销
+        HttpRequest request;
+        buff.Append(REQUEST, len);
+        request.parse(buff);
+        Run("state/2", n, [&] {
+            buff.Append(REQUEST, len / 2);
+            if(request.parse(buff) != HttpRequest::NO_REQUEST) {
+                abort();
+            }
+            buff.Append(REQUEST + len / 2, len - len / 2);
+            if(request.parse(buff) != HttpRequest::GET_REQUSET) {
+                abort();
+            }
+        });
+    }
+    return 0;
+}
@@ -0,0 +1,351 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <unistd.h>     // pread
+#include "../code/http/httprequest.h"
+#include "../code/buffer/buffer.h"
+
+// 用户验证用userverify_stub.cpp的桩实现：用户名为ok时验证通过
+
+static const std::string GET_REQUEST =
+    "GET /index HTTP/1.1\r\n"
+    "Host: www.example.com\r\n"
+    "Connection: keep-alive\r\n"
+    "Accept-Encoding:  gzip, deflate \r\n"
+    "\r\n";
+
+static void ExpectGet(const HttpRequest& req) {
+    EXPECT_EQ(req.method(), "GET");
+    EXPECT_EQ(req.path(), "/index.html");
+    EXPECT_EQ(req.version(), "1.1");
+    EXPECT_EQ(req.GetHeader("host"), "www.example.com");
+    EXPECT_EQ(req.GetHeader("Accept-Encoding"), "gzip, deflate");
+    EXPECT_EQ(req.GetHeader("Cookie"), "");
+    EXPECT_TRUE(req.IsKeepAlive());
+}
+
+// 每次只到达一个字节：最后一个字节之前都是NO_REQUEST，解析进度保留
+TEST(HttpRequestTest, ByteByByte) {
+    Buffer buff(0);
+    HttpRequest req;
+    for(size_t i = 0; i < GET_REQUEST.size(); i++) {
+        buff.Append(&GET_REQUEST[i], 1);
+        HttpRequest::HTTP_CODE ret = req.parse(buff);
+        if(i + 1 < GET_REQUEST.size()) {
+            ASSERT_EQ(ret, HttpRequest::NO_REQUEST) << "at byte " << i;
+        } else {
+            ASSERT_EQ(ret, HttpRequest::GET_REQUSET);
+        }
+    }
+    ExpectGet(req);
+    EXPECT_EQ(buff.ReadableBytes(), 0u);
+}
+
+// 在每个位置断开(包括"\r"和"\n"之间)，分两次到达
+TEST(HttpRequestTest, SplitAtEveryPoint) {
+    for(size_t cut = 1; cut < GET_REQUEST.size(); cut++) {
+        Buffer buff(0);
+        HttpRequest req;
+        buff.Append(GET_REQUEST.substr(0, cut));
+        ASSERT_EQ(req.parse(buff), HttpRequest::NO_REQUEST) << "cut " << cut;
+        buff.Append(GET_REQUEST.substr(cut));
+        ASSERT_EQ(req.parse(buff), HttpRequest::GET_REQUSET) << "cut " << cut;
+        ExpectGet(req);
+    }
+}
+
+// 流水线：一次到达两个请求，逐个解析
+TEST(HttpRequestTest, Pipelined) {
+    Buffer buff(0);
+    HttpRequest req;
+    buff.Append(GET_REQUEST + "GET /login HTTP/1.0\r\n\r\n");
+    ASSERT_EQ(req.parse(buff), HttpRequest::GET_REQUSET);
+    ExpectGet(req);
+    ASSERT_EQ(req.parse(buff), HttpRequest::GET_REQUSET);
+    EXPECT_EQ(req.path(), "/login.html");
+    EXPECT_EQ(req.version(), "1.0");
+    EXPECT_FALSE(req.IsKeepAlive());
+    EXPECT_EQ(req.parse(buff), HttpRequest::NO_REQUEST);
+}
+
+TEST(HttpRequestTest, MalformedRequestLine) {
+    const char* lines[] = {
+        "GET /index.html\r\n\r\n",          // 没有版本
+        "GET  HTTP/1.1\r\n\r\n",            // 路径为空
+        " / HTTP/1.1\r\n\r\n",              // 方法为空
+        "GET / HTTP/1.1 x\r\n\r\n",         // 多余的字段
+        "GET / FTP/1.1\r\n\r\n",
+        "GET / HTTP/\r\n\r\n",
+        "GET / HTTP/1.1\r\nNoColon\r\n\r\n",
+        "GET / HTTP/1.1\r\n: empty-key\r\n\r\n",
+    };
+    for(const char* line : lines) {
+        Buffer buff(0);
+        HttpRequest req;
+        buff.Append(line, strlen(line));
+        EXPECT_EQ(req.parse(buff), HttpRequest::BAD_REQUSET) << line;
+    }
+}
+
+// 请求头超过MAX_HEAD_SIZE：一直没有CRLF，或者每行都完整但总量超限
+TEST(HttpRequestTest, HeadTooLarge) {
+    {
+        Buffer buff(0);
+        HttpRequest req;
+        buff.Append("GET /" + std::string(HttpRequest::MAX_HEAD_SIZE, 'a'));
+        EXPECT_EQ(req.parse(buff), HttpRequest::BAD_REQUSET);
+    }
+    {
+        Buffer buff(0);
+        HttpRequest req;
+        std::string head = "GET / HTTP/1.1\r\n";
+        std::string value(HttpRequest::MAX_HEAD_SIZE / 8, 'v');
+        for(int i = 0; i < 10; i++) {
+            head += "X-Big-" + std::to_string(i) + ": " + value + "\r\n";
+        }
+        buff.Append(head + "\r\n");
+        EXPECT_EQ(req.parse(buff), HttpRequest::BAD_REQUSET);
+    }
+}
+
+TEST(HttpRequestTest, TooManyHeaders) {
+    for(size_t n : {HttpRequest::MAX_HEADERS, HttpRequest::MAX_HEADERS + 1}) {
+        Buffer buff(0);
+        HttpRequest req;
+        std::string head = "GET / HTTP/1.1\r\n";
+        for(size_t i = 0; i < n; i++) {
+            head += "X-H" + std::to_string(i) + ": " + std::to_string(i) + "\r\n";
+        }
+        buff.Append(head + "\r\n");
+        HttpRequest::HTTP_CODE ret = req.parse(buff);
+        if(n <= HttpRequest::MAX_HEADERS) {
+            EXPECT_EQ(ret, HttpRequest::GET_REQUSET);
+            EXPECT_EQ(req.GetHeader("x-h63"), "63");
+        } else {
+            EXPECT_EQ(ret, HttpRequest::BAD_REQUSET);
+        }
+    }
+}
+
+// 请求体分多次到达时请求头拷贝到head_，读缓冲区被取走、覆盖之后各字段依然有效
+TEST(HttpRequestTest, HeadersAfterBodyStreamsOut) {
+    std::string body = "a=1&b=hello+world&c=" + std::string(1000, 'x');
+    std::string head = "POST /submit HTTP/1.1\r\n"
+                       "Content-Type: application/x-www-form-urlencoded\r\n"
+                       "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                       "Connection: keep-alive\r\n\r\n";
+    Buffer buff(0);
+    HttpRequest req;
+    buff.Append(head + body.substr(0, 10));
+    ASSERT_EQ(req.parse(buff), HttpRequest::NO_REQUEST);
+    EXPECT_EQ(buff.ReadableBytes(), 0u);
+    for(size_t off = 10; off < body.size(); off += 300) {
+        buff.Append(body.substr(off, 300));
+        HttpRequest::HTTP_CODE ret = req.parse(buff);
+        ASSERT_EQ(ret, off + 300 < body.size() ? HttpRequest::NO_REQUEST : HttpRequest::GET_REQUSET);
+    }
+    // 读缓冲区已经写入了别的数据
+    buff.Append(std::string(4096, '#'));
+    EXPECT_EQ(req.method(), "POST");
+    EXPECT_EQ(req.version(), "1.1");
+    EXPECT_EQ(req.GetHeader("Content-Type"), "application/x-www-form-urlencoded");
+    EXPECT_TRUE(req.IsKeepAlive());
+    EXPECT_EQ(req.body().Size(), body.size());
+    EXPECT_EQ(req.GetPost("a"), "1");
+    EXPECT_EQ(req.GetPost("b"), "hello world");
+    EXPECT_FALSE(req.NeedsVerify());
+}
+
+// Accept-Encoding：q=0表示拒绝，*匹配没有列出的编码，列出的编码优先于*
+TEST(HttpRequestTest, AcceptEncoding) {
+    struct {
+        const char* header;
+        bool gzip;
+        bool deflate;
+    } cases[] = {
+        {"gzip, deflate", true, true},
+        {"GZIP;q=0.5", true, false},
+        {"gzip;q=0, deflate", false, true},
+        {"gzip;q=0.0, deflate;q=0.001", false, true},
+        {"*", true, true},
+        {"*;q=0", false, false},
+        {"*, gzip;q=0", false, true},
+        {"br;q=1, *;q=0.1", true, true},
+        {"identity", false, false},
+        {"", false, false},
+    };
+    for(const auto& c : cases) {
+        Buffer buff(0);
+        HttpRequest req;
+        buff.Append(std::string("GET / HTTP/1.1\r\nAccept-Encoding: ") + c.header + "\r\n\r\n");
+        ASSERT_EQ(req.parse(buff), HttpRequest::GET_REQUSET);
+        EXPECT_EQ(req.AcceptEncoding("gzip"), c.gzip) << c.header;
+        EXPECT_EQ(req.AcceptEncoding("deflate"), c.deflate) << c.header;
+    }
+}
+
+// 登录表单解析完只做标记，Verify()时才验证并改写路径
+TEST(HttpRequestTest, LoginNeedsVerify) {
+    const char* forms[] = {"username=ok&password=1", "username=bad&password=1"};
+    const char* paths[] = {"/welcome.html", "/error.html"};
+    for(int i = 0; i < 2; i++) {
+        std::string body = forms[i];
+        Buffer buff(0);
+        HttpRequest req;
+        buff.Append("POST /login HTTP/1.1\r\nContent-Type: application/x-www-form-urlencoded\r\n"
+                    "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body);
+        ASSERT_EQ(req.parse(buff), HttpRequest::GET_REQUSET);
+        EXPECT_TRUE(req.NeedsVerify());
+        EXPECT_EQ(req.path(), "/login.html");
+        req.Verify();
+        EXPECT_FALSE(req.NeedsVerify());
+        EXPECT_EQ(req.path(), paths[i]);
+    }
+}
+
+static std::string PostHead(const std::string& extra) {
+    return "POST /upload HTTP/1.1\r\nHost: a\r\n" + extra + "\r\n";
+}
+
+// chunked：扩展和trailer跳过，数据按块拼接；逐字节到达也一样
+TEST(HttpRequestBodyTest, Chunked) {
+    std::string req = PostHead("Transfer-Encoding: chunked\r\n") +
+                      "5;name=value\r\nhello\r\n"
+                      "6 \r\n world\r\n"
+                      "0\r\nX-Trailer: 1\r\nX-Other: 2\r\n\r\n";
+    for(size_t step : {req.size(), static_cast<size_t>(1)}) {
+        Buffer buff(0);
+        HttpRequest request;
+        HttpRequest::HTTP_CODE ret = HttpRequest::NO_REQUEST;
+        for(size_t off = 0; off < req.size(); off += step) {
+            ASSERT_EQ(ret, HttpRequest::NO_REQUEST);
+            buff.Append(req.substr(off, step));
+            ret = request.parse(buff);
+        }
+        ASSERT_EQ(ret, HttpRequest::GET_REQUSET);
+        EXPECT_EQ(request.body().Data(), "hello world");
+        EXPECT_EQ(request.GetHeader("Host"), "a");
+        EXPECT_EQ(buff.ReadableBytes(), 0u);
+    }
+}
+
+TEST(HttpRequestBodyTest, BadChunk) {
+    const std::string bodies[] = {
+        "zz\r\nhello\r\n0\r\n\r\n",                 // chunk-size不是16进制
+        "\r\n0\r\n\r\n",                            // chunk-size为空
+        "5x\r\nhello\r\n0\r\n\r\n",                 // chunk-size后面跟了别的字符
+        "1000000000000000\r\n",                     // 16位，可能溢出
+        "5\r\nhelloXX0\r\n\r\n",                    // chunk-data后面不是CRLF
+        std::string(HttpRequest::MAX_CHUNK_LINE + 1, '1'),  // chunk-size行过长
+    };
+    for(const std::string& body : bodies) {
+        Buffer buff(0);
+        HttpRequest req;
+        buff.Append(PostHead("Transfer-Encoding: chunked\r\n") + body);
+        EXPECT_EQ(req.parse(buff), HttpRequest::BAD_REQUSET) << body.substr(0, 20);
+    }
+}
+
+// 同时带Content-Length和Transfer-Encoding可能是请求走私，不支持的编码也拒绝
+TEST(HttpRequestBodyTest, RejectAmbiguousLength) {
+    const char* heads[] = {
+        "Content-Length: 5\r\nTransfer-Encoding: chunked\r\n",
+        "Transfer-Encoding: gzip\r\n",
+        "Content-Length: 12a\r\n",
+        "Content-Length: 1234567890123456789\r\n",
+    };
+    for(const char* head : heads) {
+        Buffer buff(0);
+        HttpRequest req;
+        buff.Append(PostHead(head) + "hello");
+        EXPECT_EQ(req.parse(buff), HttpRequest::BAD_REQUSET) << head;
+    }
+}
+
+// Content-Length的请求体分多次到达
+TEST(HttpRequestBodyTest, ContentLengthSplit) {
+    std::string body = "0123456789abcdef";
+    std::string req = PostHead("Content-Length: 16\r\n") + body + "GET / HTTP/1.1\r\n\r\n";
+    Buffer buff(0);
+    HttpRequest request;
+    size_t cut = req.size() - body.size() - 18 + 3;     // 请求体的前3个字节和请求头一起到达
+    buff.Append(req.substr(0, cut));
+    ASSERT_EQ(request.parse(buff), HttpRequest::NO_REQUEST);
+    buff.Append(req.substr(cut, 5));
+    ASSERT_EQ(request.parse(buff), HttpRequest::NO_REQUEST);
+    buff.Append(req.substr(cut + 5));
+    ASSERT_EQ(request.parse(buff), HttpRequest::GET_REQUSET);
+    EXPECT_EQ(request.body().Data(), body);
+    // 后面的请求不受影响
+    ASSERT_EQ(request.parse(buff), HttpRequest::GET_REQUSET);
+    EXPECT_EQ(request.method(), "GET");
+    EXPECT_EQ(request.body().Size(), 0u);
+}
+
+class BodyLimitTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        memLimit_ = BodySink::memLimit;
+        maxSize_ = BodySink::maxSize;
+    }
+    void TearDown() override {
+        BodySink::memLimit = memLimit_;
+        BodySink::maxSize = maxSize_;
+    }
+    size_t memLimit_, maxSize_;
+};
+
+TEST_F(BodyLimitTest, TooLarge) {
+    BodySink::maxSize = 100;
+    {
+        Buffer buff(0);
+        HttpRequest req;
+        buff.Append(PostHead("Content-Length: 101\r\n"));
+        EXPECT_EQ(req.parse(buff), HttpRequest::TOO_LARGE_REQUEST);
+    }
+    {
+        // chunked事先不知道总长度，累计超过上限时拒绝
+        Buffer buff(0);
+        HttpRequest req;
+        buff.Append(PostHead("Transfer-Encoding: chunked\r\n") + "40\r\n" + std::string(64, 'a') + "\r\n");
+        ASSERT_EQ(req.parse(buff), HttpRequest::NO_REQUEST);
+        buff.Append("40\r\n");
+        EXPECT_EQ(req.parse(buff), HttpRequest::TOO_LARGE_REQUEST);
+    }
+}
+
+// 超过memLimit的请求体写入临时文件，内容完整
+TEST_F(BodyLimitTest, SpillToFile) {
+    BodySink::memLimit = 1000;
+    std::string body;
+    for(int i = 0; body.size() < 5000; i++) {
+        body += std::to_string(i) + ",";
+    }
+    Buffer buff(0);
+    HttpRequest req;
+    buff.Append(PostHead("Content-Length: " + std::to_string(body.size()) + "\r\n"));
+    for(size_t off = 0; off < body.size(); off += 700) {
+        ASSERT_EQ(req.parse(buff), HttpRequest::NO_REQUEST);
+        buff.Append(body.substr(off, 700));
+    }
+    ASSERT_EQ(req.parse(buff), HttpRequest::GET_REQUSET);
+    ASSERT_FALSE(req.body().InMemory());
+    ASSERT_EQ(req.body().Size(), body.size());
+    std::string data(body.size(), '\0');
+    ASSERT_EQ(pread(req.body().Fd(), &data[0], data.size(), 0), static_cast<ssize_t>(data.size()));
+    EXPECT_EQ(data, body);
+    EXPECT_TRUE(req.body().Data().empty());
+}
+
+// Reset()后大请求体的内存还回去，小的保留
+TEST(BodySinkTest, ResetShrinks) {
+    BodySink sink;
+    std::string small(100, 's');
+    ASSERT_TRUE(sink.Append(small.data(), small.size()));
+    sink.Reset();
+    EXPECT_EQ(sink.Size(), 0u);
+    EXPECT_GE(sink.Data().capacity(), small.size());
+    std::string big(BodySink::KEEP_CAPACITY * 4, 'b');
+    ASSERT_TRUE(sink.Append(big.data(), big.size()));
+    sink.Reset();
+    EXPECT_LE(sink.Data().capacity(), BodySink::KEEP_CAPACITY);
+}
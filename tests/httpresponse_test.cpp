@@ -0,0 +1,267 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/time.h>    // utimes
+#include "../code/http/httpresponse.h"
+
+// 测试用的资源目录：一个小文本文件、一个走sendfile的大文件和500错误页面，mtime都设为一天前
+class HttpResponseTest : public ::testing::Test {
+protected:
+    static void SetUpTestSuite() {
+        char tmpl[] = "/tmp/httpresponse_test_XXXXXX";
+        ASSERT_NE(mkdtemp(tmpl), nullptr);
+        dir_ = tmpl;
+        for(int i = 0; small_.size() < 1000; i++) {
+            small_ += std::to_string(i) + ",";
+        }
+        small_.resize(1000);
+        big_.resize(5 * 1024 * 1024);
+        for(size_t i = 0; i < big_.size(); i++) {
+            big_[i] = static_cast<char>('a' + i % 26);
+        }
+        WriteFile_("/a.txt", small_);
+        WriteFile_("/big.bin", big_);
+        WriteFile_("/500.html", "<html>500</html>");
+    }
+
+    static void TearDownTestSuite() {
+        for(const char* name : {"/a.txt", "/big.bin", "/500.html"}) {
+            unlink((dir_ + name).c_str());
+        }
+        rmdir(dir_.c_str());
+    }
+
+    static void WriteFile_(const std::string& name, const std::string& data) {
+        std::string file = dir_ + name;
+        int fd = open(file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        ASSERT_GE(fd, 0);
+        ASSERT_EQ(write(fd, data.data(), data.size()), static_cast<ssize_t>(data.size()));
+        close(fd);
+        struct timeval tv[2];
+        gettimeofday(&tv[0], nullptr);
+        tv[0].tv_sec -= 86400;
+        tv[1] = tv[0];
+        ASSERT_EQ(utimes(file.c_str(), tv), 0);
+    }
+
+    // 生成响应，返回响应头(到空行为止)，响应体放在body里
+    std::string Respond(const std::string& path, const std::string& range, const std::string& ifRange,
+                        std::string* body) {
+        std::string p = path;
+        response_.Init(dir_, p, true, 200);
+        response_.SetRange(range, ifRange);
+        ChainBuffer buff;
+        response_.MakeResponse(buff);
+        std::string all = buff.RetrieveAllToStr();
+        size_t end = all.find("\r\n\r\n");
+        EXPECT_NE(end, std::string::npos);
+        body->assign(all, end + 4, std::string::npos);
+        if(response_.FileFd() >= 0) {
+            std::string data(response_.FileLen(), '\0');
+            EXPECT_EQ(pread(response_.FileFd(), &data[0], data.size(), response_.FileOffset()),
+                      static_cast<ssize_t>(data.size()));
+            *body += data;
+        } else if(response_.File()) {
+            body->append(response_.File(), response_.FileLen());
+        }
+        return all.substr(0, end + 2);
+    }
+
+    // 条件请求：返回状态码
+    int Conditional(const std::string& path, const std::string& ifNoneMatch, const std::string& ifModifiedSince) {
+        std::string p = path;
+        response_.Init(dir_, p, true, 200);
+        response_.SetConditional(ifNoneMatch, ifModifiedSince);
+        ChainBuffer buff;
+        response_.MakeResponse(buff);
+        return response_.Code();
+    }
+
+    static std::string Header(const std::string& head, const std::string& key) {
+        size_t pos = head.find("\r\n" + key + ": ");
+        if(pos == std::string::npos) {
+            return "";
+        }
+        pos += key.size() + 4;
+        return head.substr(pos, head.find("\r\n", pos) - pos);
+    }
+
+    static std::string dir_;
+    static std::string small_;
+    static std::string big_;
+    HttpResponse response_;
+};
+
+std::string HttpResponseTest::dir_;
+std::string HttpResponseTest::small_;
+std::string HttpResponseTest::big_;
+
+TEST_F(HttpResponseTest, SingleRange) {
+    std::string body;
+    std::string head = Respond("/a.txt", "bytes=10-19", "", &body);
+    EXPECT_EQ(response_.Code(), 206);
+    EXPECT_EQ(Header(head, "Content-Range"), "bytes 10-19/1000");
+    EXPECT_EQ(body, small_.substr(10, 10));
+
+    // a-：到文件末尾，结束位置超过文件大小时截到末尾
+    head = Respond("/a.txt", "bytes=990-", "", &body);
+    EXPECT_EQ(Header(head, "Content-Range"), "bytes 990-999/1000");
+    EXPECT_EQ(body, small_.substr(990));
+    head = Respond("/a.txt", "bytes=995-5000", "", &body);
+    EXPECT_EQ(body, small_.substr(995));
+
+    // -n：最后n个字节，n超过文件大小时为整个文件
+    head = Respond("/a.txt", "bytes=-7", "", &body);
+    EXPECT_EQ(Header(head, "Content-Range"), "bytes 993-999/1000");
+    EXPECT_EQ(body, small_.substr(993));
+    head = Respond("/a.txt", "bytes=-5000", "", &body);
+    EXPECT_EQ(Header(head, "Content-Range"), "bytes 0-999/1000");
+
+    // sendfile的大文件只发送区间内的部分
+    head = Respond("/big.bin", "bytes=1000000-1000099", "", &body);
+    EXPECT_EQ(response_.Code(), 206);
+    EXPECT_EQ(body, big_.substr(1000000, 100));
+}
+
+// 多段：multipart/byteranges，各段带自己的Content-Range；映射的文件和pread读出的大文件结果一致
+TEST_F(HttpResponseTest, MultipleRanges) {
+    struct {
+        const char* path;
+        const std::string* data;
+    } files[] = {{"/a.txt", &small_}, {"/big.bin", &big_}};
+    for(const auto& f : files) {
+        std::string body;
+        std::string head = Respond(f.path, "bytes=0-4, 20-29,-3", "", &body);
+        ASSERT_EQ(response_.Code(), 206) << f.path;
+        EXPECT_NE(Header(head, "Content-Type").find("multipart/byteranges; boundary="), std::string::npos);
+        EXPECT_EQ(Header(head, "Content-Length"), std::to_string(body.size()));
+        std::string boundary = Header(head, "Content-Type").substr(31);
+        std::string size = std::to_string(f.data->size());
+        std::string type = "text/plain";      // .txt和未知的.bin都是text/plain
+        std::string expect;
+        size_t ranges[][2] = {{0, 5}, {20, 30}, {f.data->size() - 3, f.data->size()}};
+        for(auto& r : ranges) {
+            expect += "\r\n--" + boundary + "\r\nContent-Type: " + type + "\r\nContent-Range: bytes " +
+                      std::to_string(r[0]) + "-" + std::to_string(r[1] - 1) + "/" + size + "\r\n\r\n" +
+                      f.data->substr(r[0], r[1] - r[0]);
+        }
+        expect += "\r\n--" + boundary + "--\r\n";
+        EXPECT_EQ(body, expect) << f.path;
+    }
+}
+
+// 语法正确但没有区间落在文件内：416，Content-Range: bytes */size
+TEST_F(HttpResponseTest, NotSatisfiable) {
+    for(const char* range : {"bytes=1000-", "bytes=2000-3000", "bytes=-0", "bytes=1000-1001,5000-"}) {
+        std::string body;
+        std::string head = Respond("/a.txt", range, "", &body);
+        EXPECT_EQ(response_.Code(), 416) << range;
+        EXPECT_EQ(Header(head, "Content-Range"), "bytes */1000") << range;
+        EXPECT_EQ(Header(head, "Content-Length"), "0") << range;
+        EXPECT_TRUE(body.empty());
+    }
+}
+
+// 语法错误、单位不是bytes时忽略Range，发送整个文件
+TEST_F(HttpResponseTest, InvalidRangeIgnored) {
+    for(const char* range : {"items=0-1", "bytes=5-1", "bytes=a-b", "bytes=10", "bytes=0-1,x"}) {
+        std::string body;
+        Respond("/a.txt", range, "", &body);
+        EXPECT_EQ(response_.Code(), 200) << range;
+        EXPECT_EQ(body, small_) << range;
+    }
+}
+
+// If-Range：ETag或日期与文件一致时才按Range响应，否则发送整个文件
+TEST_F(HttpResponseTest, IfRange) {
+    std::string body;
+    std::string head = Respond("/a.txt", "", "", &body);
+    std::string etag = Header(head, "ETag");
+    std::string lastModified = Header(head, "Last-Modified");
+    ASSERT_EQ(etag.substr(0, 1), "\"");     // 一天前修改的文件是强ETag
+
+    Respond("/a.txt", "bytes=0-9", etag, &body);
+    EXPECT_EQ(response_.Code(), 206);
+    Respond("/a.txt", "bytes=0-9", lastModified, &body);
+    EXPECT_EQ(response_.Code(), 206);
+
+    for(const std::string& ifRange : {std::string("\"0-0\""), "W/" + etag, std::string("Thu, 01 Jan 1970 00:00:00 GMT")}) {
+        Respond("/a.txt", "bytes=0-9", ifRange, &body);
+        EXPECT_EQ(response_.Code(), 200) << ifRange;
+        EXPECT_EQ(body, small_) << ifRange;
+    }
+}
+
+// 区间过多(超过MAX_RANGES=16)、多段总大小超过MAX_MULTIPART_SIZE(4MB)时发送整个文件
+TEST_F(HttpResponseTest, MultipartLimits) {
+    std::string range = "bytes=0-0";
+    for(int i = 1; i <= 16; i++) {
+        range += "," + std::to_string(i * 10) + "-" + std::to_string(i * 10);
+    }
+    std::string body;
+    Respond("/a.txt", range, "", &body);
+    EXPECT_EQ(response_.Code(), 200);
+    EXPECT_EQ(body, small_);
+
+    Respond("/a.txt", range.substr(0, range.rfind(',')), "", &body);
+    EXPECT_EQ(response_.Code(), 206);
+
+    Respond("/big.bin", "bytes=0-2999999,3000000-", "", &body);
+    EXPECT_EQ(response_.Code(), 200);
+    EXPECT_EQ(body.size(), big_.size());
+}
+
+// If-None-Match用弱比较：W/前缀不影响匹配；*匹配任何文件；逗号分隔的列表中任意一个匹配即可
+TEST_F(HttpResponseTest, IfNoneMatch) {
+    std::string body;
+    std::string etag = Header(Respond("/a.txt", "", "", &body), "ETag");
+    ASSERT_EQ(etag.substr(0, 1), "\"");
+    EXPECT_EQ(Conditional("/a.txt", etag, ""), 304);
+    EXPECT_EQ(Conditional("/a.txt", "W/" + etag, ""), 304);
+    EXPECT_EQ(Conditional("/a.txt", "*", ""), 304);
+    EXPECT_EQ(Conditional("/a.txt", "\"1-1\", " + etag + " ,\"2-2\"", ""), 304);
+    EXPECT_EQ(Conditional("/a.txt", "\"1-1\",W/\"2-2\"", ""), 200);
+    EXPECT_EQ(Conditional("/a.txt", "\"" + etag, ""), 200);
+    // 不存在的文件不会是304
+    EXPECT_EQ(Conditional("/none.txt", "*", ""), 404);
+}
+
+// 有If-None-Match时忽略If-Modified-Since
+TEST_F(HttpResponseTest, IfNoneMatchPrecedence) {
+    std::string body;
+    std::string head = Respond("/a.txt", "", "", &body);
+    std::string etag = Header(head, "ETag");
+    std::string lastModified = Header(head, "Last-Modified");
+    EXPECT_EQ(Conditional("/a.txt", etag, "Thu, 01 Jan 1970 00:00:00 GMT"), 304);
+    EXPECT_EQ(Conditional("/a.txt", "\"1-1\"", lastModified), 200);
+}
+
+TEST_F(HttpResponseTest, IfModifiedSince) {
+    std::string body;
+    std::string lastModified = Header(Respond("/a.txt", "", "", &body), "Last-Modified");
+    EXPECT_EQ(Conditional("/a.txt", "", lastModified), 304);
+    EXPECT_EQ(Conditional("/a.txt", "", "Fri, 01 Jan 2100 00:00:00 GMT"), 304);
+    EXPECT_EQ(Conditional("/a.txt", "", "Thu, 01 Jan 1970 00:00:00 GMT"), 200);
+    // 只接受IMF-fixdate，解析失败时忽略这个请求头
+    EXPECT_EQ(Conditional("/a.txt", "", "Friday, 01-Jan-00 00:00:00 GMT"), 200);
+    EXPECT_EQ(Conditional("/a.txt", "", "garbage"), 200);
+    EXPECT_EQ(Conditional("/a.txt", "", "Fri, 01 Jan 2100 00:00:00 GMT x"), 200);
+}
+
+// 一秒内刚修改过的文件只给弱ETag，弱ETag同样可以用于If-None-Match
+TEST_F(HttpResponseTest, WeakETagForFreshFile) {
+    std::string file = dir_ + "/fresh.txt";
+    int fd = open(file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(write(fd, "fresh", 5), 5);
+    close(fd);
+    std::string body;
+    std::string etag = Header(Respond("/fresh.txt", "", "", &body), "ETag");
+    EXPECT_EQ(etag.substr(0, 3), "W/\"");
+    EXPECT_EQ(body, "fresh");
+    EXPECT_EQ(Conditional("/fresh.txt", etag, ""), 304);
+    EXPECT_EQ(Conditional("/fresh.txt", etag.substr(2), ""), 304);
+    unlink(file.c_str());
+}
@@ -0,0 +1,119 @@
+// 编译期最低级别设为info：LOG_DEBUG整条语句被删掉
+#define LOG_MIN_LEVEL 1
+#define LOG_MODULE Log::HTTP
+#include "../code/log/log.h"
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+class LogTest : public ::testing::Test {
+protected:
+    static void SetUpTestSuite() {
+        char dir[] = "/tmp/log_test_XXXXXX";
+        ASSERT_NE(mkdtemp(dir), nullptr);
+        path_ = dir;
+        Log::Instance()->init(0, path_.c_str(), ".log", 0);
+    }
+
+    // 删除日志目录和其中的文件(包括轮转压缩出的.gz)；后台压缩可能还在写，目录删不掉时稍后重试
+    static void TearDownTestSuite() {
+        Log::Instance()->flush();
+        for(int wait = 0; wait < 200; wait++) {
+            if(DIR* dir = opendir(path_.c_str())) {
+                while(struct dirent* ent = readdir(dir)) {
+                    if(ent->d_name[0] != '.') {
+                        unlink((path_ + "/" + ent->d_name).c_str());
+                    }
+                }
+                closedir(dir);
+            }
+            if(rmdir(path_.c_str()) == 0) {
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+
+    void TearDown() override {
+        Log::Instance()->SetLevel(0);
+    }
+
+    // 参数被求值时计数，用来判断日志语句是否真的执行了
+    int Arg() {
+        return ++evaluated_;
+    }
+
+    static std::string path_;
+    int evaluated_ = 0;
+};
+
+std::string LogTest::path_;
+
+// 低于LOG_MIN_LEVEL的语句即使运行时级别允许，参数也不会被求值
+TEST_F(LogTest, CompileTimeFilter) {
+    EXPECT_TRUE(Log::Enabled(Log::HTTP, 0));
+    LOG_DEBUG("debug %d", Arg());
+    EXPECT_EQ(evaluated_, 0);
+    LOG_INFO("info %d", Arg());
+    EXPECT_EQ(evaluated_, 1);
+}
+
+// 模块级别互相独立；SetLevel覆盖所有模块
+TEST_F(LogTest, ModuleLevels) {
+    Log::Instance()->SetLevel(1);
+    Log::Instance()->SetModuleLevel(Log::HTTP, 3);
+    EXPECT_EQ(Log::Instance()->GetModuleLevel(Log::HTTP), 3);
+    EXPECT_FALSE(Log::Enabled(Log::HTTP, 2));
+    EXPECT_TRUE(Log::Enabled(Log::HTTP, 3));
+    EXPECT_TRUE(Log::Enabled(Log::POOL, 1));
+    EXPECT_FALSE(Log::Enabled(Log::POOL, 0));
+
+    // 本文件属于HTTP模块
+    LOG_WARN("warn %d", Arg());
+    EXPECT_EQ(evaluated_, 0);
+    LOG_ERROR("error %d", Arg());
+    EXPECT_EQ(evaluated_, 1);
+
+    Log::Instance()->SetLevel(2);
+    EXPECT_EQ(Log::Instance()->GetModuleLevel(Log::HTTP), 2);
+    EXPECT_EQ(Log::Instance()->GetLevel(), 2);
+}
+
+// 超过maxFileSize时轮转，旧文件在后台压缩为.gz；未压缩的文件都不超过上限
+TEST_F(LogTest, RotateBySize) {
+    size_t oldMax = Log::maxFileSize;
+    Log::maxFileSize = 4096;
+    for(int i = 0; i < 300; i++) {
+        LOG_INFO("rotate test line %d", i);
+    }
+    Log::maxFileSize = oldMax;
+
+    bool compressed = false;
+    std::vector<std::string> plain;
+    for(int wait = 0; wait < 200 && !compressed; wait++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        plain.clear();
+        DIR* dir = opendir(path_.c_str());
+        ASSERT_NE(dir, nullptr);
+        while(struct dirent* ent = readdir(dir)) {
+            std::string name = ent->d_name;
+            if(name.size() > 3 && name.compare(name.size() - 3, 3, ".gz") == 0) {
+                compressed = true;
+            } else if(name[0] != '.') {
+                plain.push_back(path_ + "/" + name);
+            }
+        }
+        closedir(dir);
+    }
+    EXPECT_TRUE(compressed);
+    for(auto& file : plain) {
+        struct stat st;
+        ASSERT_EQ(stat(file.c_str(), &st), 0);
+        EXPECT_LE(st.st_size, 4096) << file;
+    }
+}
@@ -0,0 +1,136 @@
+#include "../code/log/logring.h"
+#include "../code/log/logformat.h"
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+// 容量向上取整为2的幂，满了之后Acquire返回nullptr，归还后可以继续写
+TEST(LogRingTest, FullAndRelease) {
+    LogRing ring(5);
+    ASSERT_EQ(ring.Capacity(), 8u);
+    for(size_t i = 0; i < ring.Capacity(); i++) {
+        LogRing::Record* rec = ring.Acquire();
+        ASSERT_NE(rec, nullptr);
+        rec->len = snprintf(rec->data, LogRing::RECORD_SIZE, "%zu", i);
+        ring.Commit(rec);
+    }
+    EXPECT_EQ(ring.Acquire(), nullptr);
+
+    ASSERT_NE(ring.Peek(0), nullptr);
+    EXPECT_EQ(std::string(ring.Peek(0)->data, ring.Peek(0)->len), "0");
+    ring.Release(3);
+    EXPECT_EQ(std::string(ring.Peek(0)->data, ring.Peek(0)->len), "3");
+    EXPECT_NE(ring.Acquire(), nullptr);
+}
+
+// 占用了还没Commit的槽对消费者不可见，后面已Commit的也要等它
+TEST(LogRingTest, UncommittedBlocksConsumer) {
+    LogRing ring(4);
+    LogRing::Record* a = ring.Acquire();
+    LogRing::Record* b = ring.Acquire();
+    ring.Commit(b);
+    EXPECT_EQ(ring.Peek(0), nullptr);
+    ring.Commit(a);
+    EXPECT_EQ(ring.Peek(0), a);
+    EXPECT_EQ(ring.Peek(1), b);
+}
+
+// 多个生产者并发写入：每条记录恰好读出一次，同一生产者的记录保持顺序
+TEST(LogRingTest, MultiProducer) {
+    const int producers = 4;
+    const int perProducer = 20000;
+    LogRing ring(64);
+
+    std::vector<std::thread> threads;
+    for(int p = 0; p < producers; p++) {
+        threads.emplace_back([&ring, p] {
+            for(int i = 0; i < perProducer; i++) {
+                LogRing::Record* rec;
+                while(!(rec = ring.Acquire())) {
+                    std::this_thread::yield();
+                }
+                rec->len = snprintf(rec->data, LogRing::RECORD_SIZE, "%d %d", p, i);
+                ring.Commit(rec);
+            }
+        });
+    }
+
+    std::vector<int> next(producers, 0);
+    int total = 0;
+    while(total < producers * perProducer) {
+        size_t n = 0;
+        while(n < 16 && ring.Peek(n)) {
+            LogRing::Record* rec = ring.Peek(n);
+            std::string line(rec->data, rec->len);
+            int p = -1, i = -1;
+            ASSERT_EQ(sscanf(line.c_str(), "%d %d", &p, &i), 2);
+            ASSERT_EQ(i, next[p]);
+            next[p]++;
+            n++;
+        }
+        if(n == 0) {
+            ring.Wait(1);
+            continue;
+        }
+        ring.Release(n);
+        total += n;
+    }
+    for(auto& t : threads) {
+        t.join();
+    }
+    EXPECT_EQ(ring.Peek(0), nullptr);
+}
+
+static std::string Decode(const char* format, std::function<void(LogEncoder&)> put) {
+    char rec[LogRing::RECORD_SIZE];
+    LogEncoder enc(rec, sizeof(rec));
+    enc.Begin(123456789, format);
+    put(enc);
+    char out[1024];
+    size_t n = LogDecoder::Format(rec, enc.Size(), out, sizeof(out));
+    EXPECT_EQ(LogDecoder::Timestamp(rec), 123456789);
+    return std::string(out, n);
+}
+
+// 写线程格式化的结果与printf一致；长度修饰符按编码的类型处理
+TEST(LogFormatTest, MatchesPrintf) {
+    char name[] = "index.html";
+    std::string s = Decode("fd:%d size:%zu %s %-6s| %lu %x %c %.2f 100%%", [&](LogEncoder& e) {
+        e.Put(-5); e.Put(sizeof(name)); e.Put(name); e.Put("ab");
+        e.Put(7UL); e.Put(255u); e.Put('z'); e.Put(3.14159);
+    });
+    char expect[256];
+    snprintf(expect, sizeof(expect), "fd:%d size:%zu %s %-6s| %lu %x %c %.2f 100%%",
+             -5, sizeof(name), name, "ab", 7UL, 255u, 'z', 3.14159);
+    EXPECT_EQ(s, expect);
+}
+
+// 字符串被拷贝进记录；nullptr输出(null)；参数不够时输出占位符
+TEST(LogFormatTest, StringsAndMissingArgs) {
+    std::string path = "/tmp/abc";
+    std::string s = Decode("[%s] [%s] [%.3s] %d", [&](LogEncoder& e) {
+        e.Put(path.c_str()); e.Put(static_cast<const char*>(nullptr)); e.Put("abcdef");
+    });
+    EXPECT_EQ(s, "[/tmp/abc] [(null)] [abc] <?>");
+}
+
+// 超长字符串被截断在记录内，不会越界
+TEST(LogFormatTest, Truncate) {
+    std::string big(2000, 'x');
+    std::string s = Decode("%s|%d", [&](LogEncoder& e) {
+        e.Put(big.c_str()); e.Put(1);
+    });
+    EXPECT_LT(s.size(), LogRing::RECORD_SIZE);
+    EXPECT_EQ(s.substr(0, 10), std::string(10, 'x'));
+}
+
+// *宽度/精度的参数之间有依赖，回退为立即格式化
+TEST(LogFormatTest, Deferrable) {
+    EXPECT_TRUE(LogDecoder::Deferrable("%d %s %zu 100%%"));
+    EXPECT_FALSE(LogDecoder::Deferrable("[%.*s]"));
+    EXPECT_FALSE(LogDecoder::Deferrable("%*d"));
+}
@@ -0,0 +1,92 @@
+#include <gtest/gtest.h>
+#include <stdint.h>
+#include <atomic>
+#include <set>
+#include <thread>
+#include <vector>
+#include "../code/pool/slab.h"
+
+struct Item {
+    int value = 0;
+};
+
+// 归还后槽位被重用：旧句柄失效，新句柄可以找到同一个对象
+TEST(SlabTest, StaleHandleAfterReuse) {
+    Slab<Item> slab;
+    Slab<Item>::Handle h1;
+    Item* p1 = slab.Acquire(&h1);
+    ASSERT_NE(p1, nullptr);
+    EXPECT_EQ(slab.Get(h1), p1);
+    EXPECT_GE(h1, static_cast<uint64_t>(1) << 32);
+    EXPECT_TRUE(slab.Release(h1));
+    EXPECT_EQ(slab.Get(h1), nullptr);
+    EXPECT_FALSE(slab.Release(h1));     // 重复归还
+
+    Slab<Item>::Handle h2;
+    Item* p2 = slab.Acquire(&h2);
+    EXPECT_EQ(p2, p1);                  // LIFO，刚释放的先被重用
+    EXPECT_NE(h2, h1);
+    EXPECT_EQ(slab.Get(h1), nullptr);   // 旧句柄找不到新连接
+    EXPECT_EQ(slab.Get(h2), p2);
+    EXPECT_EQ(slab.Used(), 1u);
+
+    // 小常量(Epoller的LISTEN_TOKEN等)和越界下标都不是有效句柄
+    EXPECT_EQ(slab.Get(0), nullptr);
+    EXPECT_EQ(slab.Get(1), nullptr);
+    EXPECT_EQ(slab.Get((h2 & ~0xffffffffull) | 0xffff), nullptr);
+}
+
+// 不够时按块增加，已有对象地址不变；槽位按缓存行对齐
+TEST(SlabTest, GrowsByChunkAndAligned) {
+    const size_t CHUNK = Slab<Item>::CHUNK_SIZE;
+    Slab<Item> slab;
+    ASSERT_TRUE(slab.Reserve(1));
+    EXPECT_EQ(slab.Capacity(), CHUNK);
+    std::vector<Slab<Item>::Handle> handles(CHUNK + 1);
+    std::vector<Item*> items;
+    std::set<Item*> distinct;
+    for(size_t i = 0; i < handles.size(); i++) {
+        Item* p = slab.Acquire(&handles[i]);
+        ASSERT_NE(p, nullptr);
+        p->value = static_cast<int>(i);
+        items.push_back(p);
+        distinct.insert(p);
+    }
+    EXPECT_EQ(slab.Capacity(), 2 * CHUNK);
+    EXPECT_EQ(distinct.size(), handles.size());
+    for(size_t i = 0; i < handles.size(); i++) {
+        ASSERT_EQ(slab.Get(handles[i]), items[i]);
+        EXPECT_EQ(items[i]->value, static_cast<int>(i));
+    }
+    uintptr_t a = reinterpret_cast<uintptr_t>(items[0]);
+    uintptr_t b = reinterpret_cast<uintptr_t>(items[1]);
+    EXPECT_EQ((b - a) % 64, 0u);
+    EXPECT_EQ(a % 64, reinterpret_cast<uintptr_t>(items[CHUNK]) % 64);
+}
+
+// 其他线程用Get检查句柄的同时，本线程不断分配、归还
+TEST(SlabTest, ConcurrentGet) {
+    Slab<Item> slab;
+    Slab<Item>::Handle first;
+    ASSERT_NE(slab.Acquire(&first), nullptr);
+    ASSERT_TRUE(slab.Release(first));
+    std::atomic<bool> stop(false);
+    std::atomic<int> hits(0);
+    std::thread checker([&] {
+        // first早已归还，无论槽位被重用多少次都不能再找到
+        while(!stop) {
+            if(slab.Get(first) != nullptr) {
+                hits++;
+            }
+        }
+    });
+    for(int i = 0; i < 100000; i++) {
+        Slab<Item>::Handle h;
+        ASSERT_NE(slab.Acquire(&h), nullptr);
+        ASSERT_TRUE(slab.Release(h));
+    }
+    stop = true;
+    checker.join();
+    EXPECT_EQ(hits, 0);
+    EXPECT_EQ(slab.Used(), 0u);
+}
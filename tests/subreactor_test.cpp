@@ -0,0 +1,120 @@
+#include "../code/server/subreactor.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <sys/time.h>
+
+// 用户验证的桩实现：阻塞到测试放行，模拟很慢的数据库
+static std::atomic<bool> g_verifyEntered(false);
+static std::atomic<bool> g_verifyRelease(false);
+
+bool HttpRequest::UserVerify(const std::string& name, const std::string& pwd, bool isLogin) {
+    g_verifyEntered = true;
+    while(!g_verifyRelease) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return !name.empty() && !pwd.empty();
+}
+
+/*
+io_uring模式下连接在线程池中验证期间超时：定时任务已经执行并删除，连接只被标记为关闭；
+之后对端再发来数据，不能再刷新这个连接的定时任务(小根堆上会找不到它)，验证结束交回时关闭连接
+0-小根堆  1-时间轮  2-惰性刷新的小根堆
+*/
+class SubReactorUringTest : public ::testing::TestWithParam<int> {
+protected:
+    void SetUp() override {
+#ifndef URING_ENABLED
+        GTEST_SKIP() << "built without io_uring";
+#else
+        Uring probe(8);
+        if(!probe.Init() || !probe.SetupBufRing(1, 8, 64)) {
+            GTEST_SKIP() << "io_uring unavailable";
+        }
+#endif
+        HttpConn::srcDir = "/nonexistent/";
+        g_verifyEntered = false;
+        g_verifyRelease = false;
+        port_ = 20000 + (getpid() * 3 + GetParam()) % 20000;
+        pool_.reset(new ThreadPool(1, "verify"));
+        reactor_.reset(new SubReactor(0, port_, 3, TIMEOUT_MS, false, pool_.get(), GetParam()));
+        reactor_->SetIoMode(1);
+        ASSERT_TRUE(reactor_->Init());
+        loop_ = std::thread([this] { reactor_->Loop(); });
+    }
+
+    void TearDown() override {
+        Release_();
+        if(reactor_) {
+            reactor_->Stop();
+        }
+        if(loop_.joinable()) {
+            loop_.join();
+        }
+        // 同WebServer：先析构线程池，再析构Reactor
+        pool_.reset();
+        reactor_.reset();
+    }
+
+    int Connect_() {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        struct sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port_);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        EXPECT_EQ(connect(fd, (struct sockaddr*)&addr, sizeof(addr)), 0);
+        struct timeval tv = {2, 0};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        return fd;
+    }
+
+    bool WaitVerify_() {
+        for(int i = 0; i < 200 && !g_verifyEntered; i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        return g_verifyEntered;
+    }
+
+    void Release_() {
+        g_verifyRelease = true;
+    }
+
+    static const int TIMEOUT_MS = 100;
+    int port_ = 0;
+    std::unique_ptr<ThreadPool> pool_;
+    std::unique_ptr<SubReactor> reactor_;
+    std::thread loop_;
+};
+
+TEST_P(SubReactorUringTest, TimeoutWhileVerifying) {
+    int fd = Connect_();
+    std::string body = "username=a&password=b";
+    std::string login = "POST /login.html HTTP/1.1\r\nConnection: keep-alive\r\n"
+                        "Content-Type: application/x-www-form-urlencoded\r\n"
+                        "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+    ASSERT_EQ(send(fd, login.data(), login.size(), 0), static_cast<ssize_t>(login.size()));
+    ASSERT_TRUE(WaitVerify_());
+
+    // 超时时间过去，定时任务执行；验证还没结束，再发数据
+    std::this_thread::sleep_for(std::chrono::milliseconds(TIMEOUT_MS * 3));
+    std::string next = "GET /index.html HTTP/1.1\r\nConnection: keep-alive\r\n\r\n";
+    ASSERT_EQ(send(fd, next.data(), next.size(), 0), static_cast<ssize_t>(next.size()));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    // 验证结束，连接交回Reactor后关闭，不再发送响应
+    Release_();
+    std::string received;
+    char buf[4096];
+    ssize_t n;
+    while((n = recv(fd, buf, sizeof(buf), 0)) > 0) {
+        received.append(buf, n);
+    }
+    EXPECT_TRUE(n == 0 || errno == ECONNRESET) << "errno " << errno;
+    EXPECT_EQ(received, "");
+    close(fd);
+}
+
+INSTANTIATE_TEST_SUITE_P(AllTimers, SubReactorUringTest, ::testing::Values(0, 1, 2));
@@ -0,0 +1,137 @@
+// 线程池基准测试：工作窃取线程池 vs 原来的互斥锁+std::queue<std::function>线程池
+// 统计吞吐(tasks/s)和AddTask的p99耗时
+// 用法：./threadpool_bench [每个生产者提交的任务数] [工作线程数]
+#include "../code/pool/threadpool.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <queue>
+
+// 原来的线程池(补上了isClosed的初始化)
+class LegacyThreadPool {
+public:
+    explicit LegacyThreadPool(size_t threadCount = 8) : pool_(std::make_shared<Pool>()) {
+        for(size_t i = 0; i < threadCount; i++) {
+            std::thread([pool = pool_] {
+                std::unique_lock<std::mutex> locker(pool->mtx);
+                while(true) {
+                    if(!pool->tasks.empty()) {
+                        auto task = pool->tasks.front();
+                        pool->tasks.pop();
+                        locker.unlock();
+                        task();
+                        locker.lock();
+                    }
+                    else if(pool->isClosed) {
+                        break;
+                    }
+                    else pool->cond.wait(locker);
+                }
+            }).detach();
+        }
+    }
+
+    ~LegacyThreadPool() {
+        {
+            std::lock_guard<std::mutex> locker(pool_->mtx);
+            pool_->isClosed = true;
+        }
+        pool_->cond.notify_all();
+    }
+
+    template<class F>
+    void AddTask(F&& task) {
+        {
+            std::lock_guard<std::mutex> locker(pool_->mtx);
+            pool_->tasks.emplace(std::forward<F>(task));
+        }
+        pool_->cond.notify_one();
+    }
+
+private:
+    struct Pool {
+        bool isClosed = false;
+        std::mutex mtx;
+        std::condition_variable cond;
+        std::queue<std::function<void()>> tasks;
+    };
+    std::shared_ptr<Pool> pool_;
+};
+
+typedef std::chrono::steady_clock Clock;
+
+static long long Nanos(Clock::time_point a, Clock::time_point b) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(b - a).count();
+}
+
+/*
+producers个线程各提交n个任务，每个任务只做一次原子加(和Reactor提交的读写任务一样，任务本身很短)
+submit(i, cnt)提交第i个任务，返回后记录耗时；吞吐按所有任务执行完的时间计算
+*/
+template<class Submit>
+static void Run(const char* name, int producers, int n, Submit&& submit) {
+    std::atomic<int> done{0};
+    std::vector<std::vector<long long>> lat(producers);
+    auto start = Clock::now();
+    std::vector<std::thread> threads;
+    for(int p = 0; p < producers; p++) {
+        threads.emplace_back([&, p] {
+            lat[p].reserve(n);
+            for(int i = 0; i < n; i++) {
+                auto t0 = Clock::now();
+                submit(p, i, done);
+                lat[p].push_back(Nanos(t0, Clock::now()));
+            }
+        });
+    }
+    for(auto& t : threads) {
+        t.join();
+    }
+    const int total = producers * n;
+    while(done.load(std::memory_order_acquire) < total) {
+        std::this_thread::yield();
+    }
+    long long cost = Nanos(start, Clock::now());
+    std::vector<long long> all;
+    for(auto& v : lat) {
+        all.insert(all.end(), v.begin(), v.end());
+    }
+    std::sort(all.begin(), all.end());
+    printf("%-14s producers=%d %12.0f tasks/s  enqueue p50 %6lld ns  p99 %7lld ns\n", name,
+           producers, total * 1e9 / cost, all[all.size() / 2], all[all.size() * 99 / 100]);
+}
+
+int main(int argc, char* argv[]) {
+    int n = argc > 1 ? atoi(argv[1]) : 200000;
+    int workers = argc > 2 ? atoi(argv[2]) : 4;
+    const size_t BATCH = 32;
+
+    for(int producers : {1, 4}) {
+        {
+            LegacyThreadPool pool(workers);
+            Run("legacy", producers, n, [&](int, int, std::atomic<int>& done) {
+                pool.AddTask([&done] { done.fetch_add(1, std::memory_order_release); });
+            });
+        }
+        {
+            ThreadPool pool(workers);
+            Run("steal", producers, n, [&](int, int, std::atomic<int>& done) {
+                pool.AddTask([&done] { done.fetch_add(1, std::memory_order_release); });
+            });
+        }
+        {
+            // 攒满BATCH个再AddTasks，耗时摊到每个任务上的是提交那一次
+            ThreadPool pool(workers);
+            std::vector<std::vector<Task>> batches(producers);
+            Run("steal/batch", producers, n, [&](int p, int i, std::atomic<int>& done) {
+                batches[p].emplace_back([&done] { done.fetch_add(1, std::memory_order_release); });
+                if(batches[p].size() == BATCH || i == n - 1) {
+                    pool.AddTasks(batches[p]);
+                }
+            });
+        }
+    }
+    return 0;
+}
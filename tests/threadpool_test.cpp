@@ -0,0 +1,303 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <set>
+#include <string>
+#include <vector>
+#include "../code/pool/threadpool.h"
+
+// 只捕获指针的Lambda放在Task内部；捕获了string的Lambda放在堆上，执行和析构都不能出错
+TEST(TaskTest, InlineAndHeap) {
+    int hit = 0;
+    Task small([&hit] { hit++; });
+    ASSERT_TRUE(static_cast<bool>(small));
+    small();
+    EXPECT_EQ(hit, 1);
+
+    std::string s(100, 'x');
+    size_t len = 0;
+    Task big([s, &len] { len = s.size(); });
+    Task moved(std::move(big));
+    EXPECT_FALSE(static_cast<bool>(big));
+    moved();
+    EXPECT_EQ(len, 100u);
+}
+
+TEST(TaskDequeTest, PopIsLifoStealIsFifo) {
+    TaskDeque dq;
+    std::vector<int> order;
+    for(int i = 0; i < 3; i++) {
+        Task t([&order, i] { order.push_back(i); });
+        ASSERT_TRUE(dq.Push(t));
+    }
+    Task t;
+    ASSERT_TRUE(dq.Steal(t));
+    t();
+    ASSERT_TRUE(dq.Pop(t));
+    t();
+    ASSERT_TRUE(dq.Pop(t));
+    t();
+    EXPECT_FALSE(dq.Pop(t));
+    EXPECT_EQ(order, (std::vector<int>{0, 2, 1}));
+}
+
+TEST(TaskDequeTest, FullReturnsFalse) {
+    TaskDeque dq;
+    int hit = 0;
+    for(int64_t i = 0; i < TaskDeque::CAPACITY; i++) {
+        Task t([&hit] { hit++; });
+        ASSERT_TRUE(dq.Push(t));
+    }
+    Task extra([&hit] { hit++; });
+    EXPECT_FALSE(dq.Push(extra));
+    EXPECT_TRUE(static_cast<bool>(extra));
+}
+
+// 所属线程Pop与多个线程Steal并发，每个任务恰好执行一次
+TEST(TaskDequeTest, ConcurrentSteal) {
+    const int N = 100000;
+    TaskDeque dq;
+    std::atomic<int> sum{0};
+    std::atomic<bool> done{false};
+    std::vector<std::thread> thieves;
+    for(int i = 0; i < 3; i++) {
+        thieves.emplace_back([&] {
+            Task t;
+            while(!done.load() || dq.Size() > 0) {
+                if(dq.Steal(t)) {
+                    t();
+                }
+            }
+        });
+    }
+    Task t;
+    for(int i = 0; i < N; i++) {
+        Task task([&sum] { sum.fetch_add(1); });
+        while(!dq.Push(task)) {
+            if(dq.Pop(t)) {
+                t();
+            }
+        }
+        if(i % 3 == 0 && dq.Pop(t)) {
+            t();
+        }
+    }
+    while(dq.Pop(t)) {
+        t();
+    }
+    done = true;
+    for(auto& th : thieves) {
+        th.join();
+    }
+    EXPECT_EQ(sum.load(), N);
+}
+
+TEST(ThreadPoolTest, RunsAllTasks) {
+    std::atomic<int> cnt{0};
+    {
+        ThreadPool pool(4);
+        for(int i = 0; i < 10000; i++) {
+            pool.AddTask([&cnt] { cnt.fetch_add(1); });
+        }
+    }
+    EXPECT_EQ(cnt.load(), 10000);
+}
+
+// 析构时等待队列中剩余的任务执行完
+TEST(ThreadPoolTest, DestructorDrains) {
+    std::atomic<int> cnt{0};
+    {
+        ThreadPool pool(2);
+        for(int i = 0; i < 100; i++) {
+            pool.AddTask([&cnt] {
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+                cnt.fetch_add(1);
+            });
+        }
+    }
+    EXPECT_EQ(cnt.load(), 100);
+}
+
+TEST(ThreadPoolTest, AddTasksBatch) {
+    std::atomic<int> cnt{0};
+    {
+        ThreadPool pool(4);
+        std::vector<Task> batch;
+        for(int round = 0; round < 100; round++) {
+            for(int i = 0; i < 50; i++) {
+                batch.emplace_back([&cnt] { cnt.fetch_add(1); });
+            }
+            pool.AddTasks(batch);
+            EXPECT_TRUE(batch.empty());
+        }
+    }
+    EXPECT_EQ(cnt.load(), 5000);
+}
+
+// 工作线程内提交的任务进入自己的队列，其他空闲线程需要窃取才能分担
+TEST(ThreadPoolTest, NestedSubmitIsStolen) {
+    const int FANOUT = 2000;
+    std::atomic<int> cnt{0};
+    std::mutex mtx;
+    std::set<std::thread::id> runners;
+    {
+        ThreadPool pool(4);
+        pool.AddTask([&] {
+            for(int i = 0; i < FANOUT; i++) {
+                pool.AddTask([&] {
+                    {
+                        std::lock_guard<std::mutex> locker(mtx);
+                        runners.insert(std::this_thread::get_id());
+                    }
+                    std::this_thread::sleep_for(std::chrono::microseconds(20));
+                    cnt.fetch_add(1);
+                });
+            }
+        });
+    }
+    EXPECT_EQ(cnt.load(), FANOUT);
+    EXPECT_GT(runners.size(), 1u);
+}
+
+// 休眠后重新提交，工作线程需要被唤醒
+TEST(ThreadPoolTest, WakesParkedWorkers) {
+    std::atomic<int> cnt{0};
+    ThreadPool pool(3);
+    for(int round = 0; round < 5; round++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        pool.AddTask([&cnt] { cnt.fetch_add(1); });
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+        while(cnt.load() < round + 1 && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::yield();
+        }
+        ASSERT_EQ(cnt.load(), round + 1);
+    }
+}
+
+// 占住一个工作线程，直到release为true
+static void Block(ThreadPool& pool, std::atomic<bool>& started, std::atomic<bool>& release,
+                  ThreadPool::PRIORITY pri = ThreadPool::NORMAL) {
+    pool.AddTask([&] {
+        started = true;
+        while(!release.load()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }, pri);
+}
+
+static void WaitFor(std::atomic<bool>& flag) {
+    while(!flag.load()) {
+        std::this_thread::yield();
+    }
+}
+
+// 唯一的工作线程被占住时提交各通道的任务，放开后按优先级执行，同一通道内保持提交顺序
+TEST(ThreadPoolTest, PriorityOrder) {
+    std::vector<int> order;
+    {
+        ThreadPool pool(1);
+        std::atomic<bool> started{false}, release{false};
+        Block(pool, started, release);
+        WaitFor(started);
+        const ThreadPool::PRIORITY pris[] = {ThreadPool::LOW, ThreadPool::NORMAL, ThreadPool::HIGH};
+        for(int i = 0; i < 9; i++) {
+            ThreadPool::PRIORITY pri = pris[i % 3];
+            pool.AddTask([&order, pri, i] { order.push_back(pri * 100 + i); }, pri);
+        }
+        release = true;
+    }
+    EXPECT_EQ(order, (std::vector<int>{2, 5, 8, 101, 104, 107, 200, 203, 206}));
+}
+
+// LOW通道最多占一半线程：LOW任务全部阻塞时NORMAL任务照样执行
+TEST(ThreadPoolTest, LowLaneIsLimited) {
+    std::atomic<bool> release{false};
+    std::atomic<int> running{0}, maxRunning{0};
+    std::atomic<bool> normalDone{false};
+    {
+        ThreadPool pool(4);
+        for(int i = 0; i < 8; i++) {
+            pool.AddTask([&] {
+                int cur = ++running;
+                int max = maxRunning.load();
+                while(cur > max && !maxRunning.compare_exchange_weak(max, cur)) {
+                }
+                while(!release.load()) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+                running--;
+            }, ThreadPool::LOW);
+        }
+        pool.AddTask([&] { normalDone = true; });
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+        while(!normalDone.load() && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        EXPECT_TRUE(normalDone.load());
+        EXPECT_EQ(pool.Stats(ThreadPool::LOW).depth, 6u);
+        release = true;
+    }
+    EXPECT_EQ(maxRunning.load(), 2);
+}
+
+// 排队超过超时时间的任务不执行，改为执行onExpire
+TEST(ThreadPoolTest, ExpiredTaskIsDropped) {
+    std::atomic<int> ran{0}, expired{0}, ok{0};
+    ThreadPool pool(1);
+    std::atomic<bool> started{false}, release{false};
+    Block(pool, started, release);
+    WaitFor(started);
+    pool.AddTask([&] { ran++; }, ThreadPool::NORMAL, 10, [&] { expired++; });
+    pool.AddTask([&] { ok++; }, ThreadPool::NORMAL, 10000, [&] { expired++; });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    release = true;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while(ok.load() + expired.load() < 2 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_EQ(ran.load(), 0);
+    EXPECT_EQ(expired.load(), 1);
+    EXPECT_EQ(ok.load(), 1);
+
+    ThreadPool::LaneStats st = pool.Stats(ThreadPool::NORMAL);
+    EXPECT_EQ(st.submitted, 3u);
+    EXPECT_EQ(st.executed, 2u);
+    EXPECT_EQ(st.expired, 1u);
+    EXPECT_EQ(st.depth, 0u);
+    EXPECT_GE(st.waitMaxUs, 40000u);
+}
+
+TEST(AffinityTest, ParseCpuList) {
+    EXPECT_EQ(Affinity::ParseCpuList("0-3,8,10-11\n"), (std::vector<int>{0, 1, 2, 3, 8, 10, 11}));
+    EXPECT_EQ(Affinity::ParseCpuList("5"), (std::vector<int>{5}));
+    EXPECT_TRUE(Affinity::ParseCpuList("").empty());
+}
+
+// 工作线程带上线程名，并且只在指定的CPU上运行
+TEST(AffinityTest, PoolNamesAndBindsWorkers) {
+    const std::vector<std::vector<int>>& nodes = Affinity::Nodes();
+    ASSERT_FALSE(nodes.empty());
+    ASSERT_FALSE(nodes[0].empty());
+    int cpu = nodes[0][0];
+    std::mutex mtx;
+    std::set<std::string> names;
+    std::atomic<int> wrongCpu{0};
+    {
+        ThreadPool pool(2, "tpool", {cpu});
+        for(int i = 0; i < 100; i++) {
+            pool.AddTask([&] {
+                char name[16] = {0};
+                pthread_getname_np(pthread_self(), name, sizeof(name));
+                if(sched_getcpu() != cpu) {
+                    wrongCpu++;
+                }
+                std::lock_guard<std::mutex> locker(mtx);
+                names.insert(name);
+            });
+        }
+    }
+    EXPECT_EQ(wrongCpu.load(), 0);
+    for(auto& name : names) {
+        EXPECT_EQ(name.compare(0, 6, "tpool-"), 0) << name;
+    }
+}
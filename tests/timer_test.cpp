@@ -0,0 +1,125 @@
+#include "../code/timer/heaptimer.h"
+#include "../code/timer/timingwheel.h"
+#include <gtest/gtest.h>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// 同一组用例分别跑在小根堆和时间轮上：0-HeapTimer  1-TimingWheel  2-惰性刷新的HeapTimer
+class TimerTest : public ::testing::TestWithParam<int> {
+protected:
+    void SetUp() override {
+        if(GetParam() == 1) {
+            timer_.reset(new TimingWheel());
+        } else {
+            timer_.reset(new HeapTimer(GetParam() == 2));
+        }
+    }
+
+    // 像事件循环一样驱动定时器ms毫秒：按GetNextTick()的结果睡眠，醒来后刷新缓存的时间
+    void RunFor(int ms) {
+        auto end = std::chrono::steady_clock::now() + MS(ms);
+        while(true) {
+            auto now = std::chrono::steady_clock::now();
+            if(now >= end) {
+                break;
+            }
+            int left = std::chrono::duration_cast<MS>(end - now).count();
+            int next = timer_->GetNextTick();
+            std::this_thread::sleep_for(MS(next < 0 ? left : std::min(std::max(next, 1), left)));
+            timer_->UpdateNow();
+        }
+        timer_->UpdateNow();
+        timer_->tick();
+    }
+
+    std::unique_ptr<Timer> timer_;
+};
+
+// 按超时时间先后执行回调
+TEST_P(TimerTest, ExpireInOrder) {
+    std::vector<int> fired;
+    timer_->add(1, 60, [&] { fired.push_back(1); });
+    timer_->add(2, 20, [&] { fired.push_back(2); });
+    timer_->add(3, 40, [&] { fired.push_back(3); });
+    RunFor(100);
+    EXPECT_EQ(fired, std::vector<int>({2, 3, 1}));
+    EXPECT_EQ(timer_->GetNextTick(), -1);
+}
+
+// adjust延长超时时间
+TEST_P(TimerTest, AdjustDelays) {
+    int fired = 0;
+    timer_->add(5, 30, [&] { fired++; });
+    RunFor(15);
+    timer_->adjust(5, 60);
+    RunFor(30);
+    EXPECT_EQ(fired, 0);
+    RunFor(50);
+    EXPECT_EQ(fired, 1);
+}
+
+// adjust缩短超时时间：惰性模式下也要立即生效
+TEST_P(TimerTest, AdjustShortens) {
+    int fired = 0;
+    timer_->add(6, 200, [&] { fired++; });
+    timer_->adjust(6, 10);
+    RunFor(40);
+    EXPECT_EQ(fired, 1);
+}
+
+// 重复add同一个id只保留最后一次
+TEST_P(TimerTest, AddReplaces) {
+    int first = 0, second = 0;
+    timer_->add(7, 10, [&] { first++; });
+    timer_->add(7, 20, [&] { second++; });
+    RunFor(50);
+    EXPECT_EQ(first, 0);
+    EXPECT_EQ(second, 1);
+}
+
+// cancel之后回调不执行；回调里cancel/add其他任务也是安全的
+TEST_P(TimerTest, Cancel) {
+    int fired = 0;
+    timer_->add(1, 10, [&] { fired++; });
+    timer_->add(2, 20, [&] { fired++; });
+    timer_->cancel(1);
+    timer_->cancel(100);    // 不存在的id
+    RunFor(40);
+    EXPECT_EQ(fired, 1);
+
+    timer_->add(3, 10, [&] { timer_->cancel(4); timer_->add(5, 10, [&] { fired++; }); });
+    timer_->add(4, 30, [&] { fired += 100; });
+    RunFor(60);
+    EXPECT_EQ(fired, 2);
+    EXPECT_EQ(timer_->GetNextTick(), -1);
+}
+
+// 已经执行过的任务再adjust什么也不做，不影响其他任务
+TEST_P(TimerTest, AdjustAfterExpire) {
+    int first = 0, second = 0;
+    timer_->add(1, 10, [&] { first++; });
+    timer_->add(2, 200, [&] { second++; });
+    RunFor(40);
+    EXPECT_EQ(first, 1);
+    timer_->adjust(1, 10);
+    timer_->adjust(100, 10);    // 从来没有的id
+    RunFor(60);
+    EXPECT_EQ(first, 1);
+    EXPECT_EQ(second, 0);
+    RunFor(200);
+    EXPECT_EQ(second, 1);
+    EXPECT_EQ(timer_->GetNextTick(), -1);
+}
+
+// 超过时间轮第0层(256ms)的任务需要从上层分配下来
+TEST_P(TimerTest, LongTimeout) {
+    int fired = 0;
+    timer_->add(9, 300, [&] { fired++; });
+    RunFor(250);
+    EXPECT_EQ(fired, 0);
+    RunFor(100);
+    EXPECT_EQ(fired, 1);
+}
+
+INSTANTIATE_TEST_SUITE_P(AllTimers, TimerTest, ::testing::Values(0, 1, 2));
@@ -0,0 +1,136 @@
+#include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string>
+#include "../code/server/uring.h"
+
+#ifdef URING_ENABLED
+class UringTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        // 内核不支持或被禁用(容器、seccomp)时跳过，服务器此时退回epoll
+        if(!ring_.Init() || !ring_.SetupBufRing(BGID, 8, 64)) {
+            GTEST_SKIP() << "io_uring unavailable";
+        }
+        ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds_), 0);
+    }
+    void TearDown() override {
+        if(fds_[0] >= 0) {
+            close(fds_[0]);
+            close(fds_[1]);
+        }
+    }
+
+    // 从对端读出n字节
+    std::string ReadPeer(size_t n) {
+        std::string out;
+        char buf[4096];
+        while(out.size() < n) {
+            ssize_t len = read(fds_[1], buf, sizeof(buf));
+            if(len <= 0) {
+                break;
+            }
+            out.append(buf, len);
+        }
+        return out;
+    }
+
+    static const uint16_t BGID = 1;
+    Uring ring_{64};
+    int fds_[2] = {-1, -1};
+};
+
+// 一次提交，多次完成：每次数据到达都有一个完成事件，数据在提供缓冲区里，归还后可以继续使用
+TEST_F(UringTest, MultishotRecvUsesProvidedBuffers) {
+    ring_.PrepRecv(fds_[0], BGID, 7);
+    std::string got;
+    for(int round = 0; round < 20; round++) {
+        std::string msg = "msg" + std::to_string(round);
+        ASSERT_EQ(write(fds_[1], msg.data(), msg.size()), static_cast<ssize_t>(msg.size()));
+        int n = ring_.Wait(1000);
+        ASSERT_EQ(n, 1);
+        EXPECT_EQ(ring_.GetData(0), 7u);
+        ASSERT_EQ(ring_.GetRes(0), static_cast<int>(msg.size()));
+        uint32_t flags = ring_.GetFlags(0);
+        ASSERT_TRUE(flags & IORING_CQE_F_BUFFER);
+        EXPECT_TRUE(flags & IORING_CQE_F_MORE);
+        uint16_t bid = flags >> IORING_CQE_BUFFER_SHIFT;
+        got.append(ring_.BufAddr(bid), ring_.GetRes(0));
+        ring_.RecycleBuf(bid);      // 只有8块缓冲区，不归还的话第9轮就会ENOBUFS
+    }
+    EXPECT_EQ(got.substr(0, 10), "msg0msg1ms");
+
+    // 对端关闭：res为0，recv结束
+    close(fds_[1]);
+    ASSERT_EQ(ring_.Wait(1000), 1);
+    EXPECT_EQ(ring_.GetRes(0), 0);
+    EXPECT_FALSE(ring_.GetFlags(0) & IORING_CQE_F_MORE);
+    close(fds_[0]);
+    fds_[0] = -1;
+}
+
+// sendmsg -> 文件到管道的splice -> 管道到socket的splice 链在一起，一次提交按顺序发出
+TEST_F(UringTest, LinkedSendmsgAndSplice) {
+    char path[] = "/tmp/uring_test_XXXXXX";
+    int file = mkstemp(path);
+    ASSERT_GE(file, 0);
+    unlink(path);
+    std::string body(10000, 'b');
+    ASSERT_EQ(write(file, body.data(), body.size()), static_cast<ssize_t>(body.size()));
+    int pipefd[2];
+    ASSERT_EQ(pipe(pipefd), 0);
+
+    std::string head = "HEADER\r\n";
+    struct iovec iov = {const_cast<char*>(head.data()), head.size()};
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    // 从偏移100开始发5000字节
+    ring_.PrepSendmsg(fds_[0], &msg, MSG_NOSIGNAL | MSG_WAITALL, 1, true);
+    ring_.PrepSplice(file, 100, pipefd[1], 5000, 2, true);
+    ring_.PrepSplice(pipefd[0], -1, fds_[0], 5000, 3, false);
+
+    int res[4] = {0, 0, 0, 0};
+    int done = 0;
+    while(done < 3) {
+        int n = ring_.Wait(1000);
+        ASSERT_GT(n, 0);
+        for(int i = 0; i < n; i++) {
+            res[ring_.GetData(i)] = ring_.GetRes(i);
+            done++;
+        }
+    }
+    EXPECT_EQ(res[1], static_cast<int>(head.size()));
+    EXPECT_EQ(res[2], 5000);
+    EXPECT_EQ(res[3], 5000);
+    EXPECT_EQ(ReadPeer(head.size() + 5000), head + body.substr(100, 5000));
+    close(pipefd[0]);
+    close(pipefd[1]);
+    close(file);
+}
+
+// 关闭连接时按fd取消：多次完成的recv以-ECANCELED结束
+TEST_F(UringTest, CancelFdStopsRecv) {
+    ring_.PrepRecv(fds_[0], BGID, 5);
+    EXPECT_EQ(ring_.Wait(0), 0);
+    ring_.PrepCancelFd(fds_[0], 6);
+    int recvRes = 1;
+    int got = 0;
+    while(got < 2) {
+        int n = ring_.Wait(1000);
+        ASSERT_GT(n, 0);
+        for(int i = 0; i < n; i++, got++) {
+            if(ring_.GetData(i) == 5) {
+                recvRes = ring_.GetRes(i);
+                EXPECT_FALSE(ring_.GetFlags(i) & IORING_CQE_F_MORE);
+            } else {
+                EXPECT_EQ(ring_.GetRes(i), 1);     // 取消了1个请求
+            }
+        }
+    }
+    EXPECT_EQ(recvRes, -ECANCELED);
+}
+#endif
@@ -0,0 +1,7 @@
+#include "../code/http/httprequest.h"
+
+// 用户验证的桩实现(真正的实现在userverify.cpp，依赖MySQL)：用户名为ok时验证通过
+// 解析的单元测试和基准测试都链接它，不需要MySQL客户端库
+bool HttpRequest::UserVerify(const std::string& name, const std::string& pwd, bool isLogin) {
+    return name == "ok" && !pwd.empty();
+}